@@ -0,0 +1,426 @@
+// Author: Kristi Dodaj
+// alerts.c: Responsible for compiling the --alert rules at startup and evaluating them against every sample
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <limits.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <math.h>
+#include <signal.h>
+#include <time.h>
+#include <sys/wait.h>
+#include "alerts.h"
+
+struct alertRule
+{
+    char text[128];                                                   // the rule as it was given (used in messages)
+    float (*metric)(struct alertRule *, const struct alertSnapshot *); // evaluator returning the value being watched (NAN = no value yet)
+    float (*base)(const struct alertSnapshot *);                      // raw value used by the rate evaluator
+    int source;                                                       // the collector of the metric (ALERT_CPU or ALERT_MEMORY)
+    bool above;                                                       // true for '>' and false for '<'
+    float threshold;                                                  // value that starts the rule firing
+    float clear;                                                      // value that must be crossed back over before it resolves
+    int forSamples;                                                   // consecutive samples needed to fire or resolve
+    int count;                                                        // consecutive samples seen so far in the current direction
+    bool firing;                                                      // whether the rule is currently firing
+
+    // state kept for the rate-of-change evaluator
+    float previousValue;
+    double previousTime;
+    bool havePrevious;
+
+    // what to do when the rule changes state
+    const char *command; // shell command to run (points into text)
+    const char *fifo;    // fifo/file to write a line to (points into text)
+    int fd;
+};
+
+// the compiled rules are kept in a flat array so evaluating them never allocates
+static struct alertRule rules[MAX_ALERTS];
+static int ruleCount = 0;
+
+// running totals used to report the evaluation cost
+static double evaluationNanoseconds = 0;
+static long evaluatedRules = 0;
+
+static float cpuMetric(const struct alertSnapshot *snapshot)
+{
+    return snapshot->cpuUsage;
+}
+
+static float memMetric(const struct alertSnapshot *snapshot)
+{
+    return snapshot->memoryUsed;
+}
+
+static float memAvailableMetric(const struct alertSnapshot *snapshot)
+{
+    return snapshot->memoryAvailable;
+}
+
+static float virtMetric(const struct alertSnapshot *snapshot)
+{
+    return snapshot->virtualUsed;
+}
+
+static float directValue(struct alertRule *rule, const struct alertSnapshot *snapshot)
+{
+    return rule->base(snapshot);
+}
+
+static float ratePerMinute(struct alertRule *rule, const struct alertSnapshot *snapshot)
+{
+    // change of the base value per minute since the previous sample, NAN on the first sample
+    float value = rule->base(snapshot);
+    float rate = NAN;
+
+    if (rule->havePrevious && snapshot->timestamp > rule->previousTime)
+    {
+        rate = (value - rule->previousValue) / (float)((snapshot->timestamp - rule->previousTime) / 60.0);
+    }
+
+    rule->previousValue = value;
+    rule->previousTime = snapshot->timestamp;
+    rule->havePrevious = true;
+
+    return rate;
+}
+
+static const struct
+{
+    const char *name;
+    float (*function)(const struct alertSnapshot *);
+    int source;
+} metrics[] = {
+    {"cpu", cpuMetric, ALERT_CPU},
+    {"mem", memMetric, ALERT_MEMORY},
+    {"memavail", memAvailableMetric, ALERT_MEMORY},
+    {"virt", virtMetric, ALERT_MEMORY},
+};
+
+bool alertsCompile(const char *rule)
+{
+    // This function takes the text of one --alert rule and compiles it into the next free slot of the rule array. It returns false
+    // and prints the reason if the rule is malformed.
+    // The syntax of a rule is METRIC(>|<)VALUE[:for=N][:clear=VALUE](:exec=COMMAND|:fifo=PATH) where METRIC is one of cpu (%),
+    // mem, memavail or virt (GB). Adding _rate to a metric watches how fast it changes in units per minute instead.
+    // NOTE: exec= and fifo= must come last so the command or path may itself contain ':'
+    // Example Output:
+    // alertsCompile("cpu>90:for=5:clear=80:exec=logger cpu is hot") returns true
+    // alertsCompile("memavail_rate<-1:fifo=/tmp/alerts") returns true
+    // alertsCompile("disk>90:exec=true") returns false and prints: UNKNOWN ALERT METRIC: disk
+
+    if (ruleCount == MAX_ALERTS)
+    {
+        printf("TOO MANY ALERT RULES (MAX %d). TRY AGAIN!\n", MAX_ALERTS);
+        return false;
+    }
+
+    struct alertRule *compiled = &rules[ruleCount];
+    memset(compiled, 0, sizeof(*compiled));
+    compiled->fd = -1;
+    compiled->forSamples = 1;
+
+    if (strlen(rule) >= sizeof(compiled->text))
+    {
+        printf("ALERT RULE IS TOO LONG: %s\n", rule);
+        return false;
+    }
+    strcpy(compiled->text, rule);
+
+    // split the metric name from the comparison
+    size_t nameLength = strcspn(rule, "<>");
+    if (rule[nameLength] == '\0')
+    {
+        printf("ALERT RULE IS MISSING A < OR > COMPARISON: %s\n", rule);
+        return false;
+    }
+
+    char name[32];
+    if (nameLength >= sizeof(name))
+    {
+        nameLength = sizeof(name) - 1;
+    }
+    memcpy(name, rule, nameLength);
+    name[nameLength] = '\0';
+
+    // rate metrics are the base metric with a _rate suffix
+    compiled->metric = directValue;
+    char *suffix = strstr(name, "_rate");
+    if (suffix != NULL && suffix[5] == '\0')
+    {
+        *suffix = '\0';
+        compiled->metric = ratePerMinute;
+    }
+
+    for (size_t i = 0; i < sizeof(metrics) / sizeof(metrics[0]); i++)
+    {
+        if (strcmp(name, metrics[i].name) == 0)
+        {
+            compiled->base = metrics[i].function;
+            compiled->source = metrics[i].source;
+        }
+    }
+
+    if (compiled->base == NULL)
+    {
+        printf("UNKNOWN ALERT METRIC: %s\n", name);
+        return false;
+    }
+
+    compiled->above = rule[nameLength] == '>';
+
+    char *end;
+    compiled->threshold = strtof(rule + nameLength + 1, &end);
+    if (end == rule + nameLength + 1)
+    {
+        printf("ALERT RULE IS MISSING A THRESHOLD: %s\n", rule);
+        return false;
+    }
+    compiled->clear = compiled->threshold;
+
+    // parse the options that follow the threshold
+    char *option = compiled->text + (end - rule);
+    while (*option == ':')
+    {
+        option++;
+
+        if (strncmp(option, "exec=", 5) == 0)
+        {
+            compiled->command = option + 5;
+            break;
+        }
+        else if (strncmp(option, "fifo=", 5) == 0)
+        {
+            compiled->fifo = option + 5;
+            break;
+        }
+        else if (strncmp(option, "for=", 4) == 0)
+        {
+            // a whole number of samples, nothing else before the next option
+            long samples = strtol(option + 4, &end, 10);
+            if (end == option + 4 || (*end != ':' && *end != '\0') || samples <= 0 || samples > INT_MAX)
+            {
+                printf("INVALID ALERT OPTION (for=N WITH N > 0) IN: %s\n", rule);
+                return false;
+            }
+            compiled->forSamples = samples;
+            option = end;
+        }
+        else if (strncmp(option, "clear=", 6) == 0)
+        {
+            compiled->clear = strtof(option + 6, &end);
+            if (end == option + 6 || (*end != ':' && *end != '\0'))
+            {
+                printf("INVALID ALERT OPTION (clear=VALUE) IN: %s\n", rule);
+                return false;
+            }
+            option = end;
+        }
+        else
+        {
+            printf("UNKNOWN ALERT OPTION IN: %s\n", rule);
+            return false;
+        }
+    }
+
+    if (*option != '\0' && compiled->command == NULL && compiled->fifo == NULL)
+    {
+        printf("UNEXPECTED TEXT IN ALERT RULE: %s\n", rule);
+        return false;
+    }
+
+    if ((compiled->command == NULL || *compiled->command == '\0') && (compiled->fifo == NULL || *compiled->fifo == '\0'))
+    {
+        printf("ALERT RULE NEEDS AN exec= OR fifo= ACTION: %s\n", rule);
+        return false;
+    }
+
+    // the clear value has to sit on the safe side of the threshold
+    if ((compiled->above && compiled->clear > compiled->threshold) || (!compiled->above && compiled->clear < compiled->threshold))
+    {
+        printf("ALERT CLEAR VALUE IS ON THE WRONG SIDE OF THE THRESHOLD: %s\n", rule);
+        return false;
+    }
+
+    // a reader going away must not kill the monitor
+    if (compiled->fifo != NULL)
+    {
+        signal(SIGPIPE, SIG_IGN);
+    }
+
+    ruleCount++;
+    return true;
+}
+
+int alertsCount()
+{
+    // This function returns the number of compiled alert rules
+    // Example Output:
+    // alertsCount() returns 2
+
+    return ruleCount;
+}
+
+int alertsSources()
+{
+    // This function returns the collectors the compiled rules need samples of (ALERT_CPU and ALERT_MEMORY combined with |)
+    // Example Output:
+    // alertsSources() returns ALERT_CPU | ALERT_MEMORY for the rules cpu>90:exec=... and memavail<1:exec=...
+
+    int sources = 0;
+    for (int i = 0; i < ruleCount; i++)
+    {
+        sources |= rules[i].source;
+    }
+    return sources;
+}
+
+static void fireAlert(struct alertRule *rule, float value)
+{
+    // This function runs the action of the given rule once it has changed state (firing or resolved)
+
+    char message[256];
+    int length = snprintf(message, sizeof(message), "%s %s value=%.2f\n", rule->firing ? "FIRING" : "RESOLVED", rule->text, value);
+
+    if (rule->fifo != NULL)
+    {
+        // open lazily since a fifo cannot be opened for writing until somebody reads it
+        if (rule->fd == -1)
+        {
+            rule->fd = open(rule->fifo, O_WRONLY | O_NONBLOCK | O_APPEND | O_CLOEXEC);
+        }
+
+        if (rule->fd != -1 && write(rule->fd, message, length) == -1 && errno != EAGAIN)
+        {
+            // the reader went away, so try again on the next state change
+            close(rule->fd);
+            rule->fd = -1;
+        }
+    }
+
+    if (rule->command != NULL)
+    {
+        // fork twice so the command is reparented to init and never has to be waited for
+        pid_t pid = fork();
+        if (pid < 0)
+        {
+            perror("fork: Failed to run alert command");
+        }
+        else if (pid == 0)
+        {
+            if (fork() == 0)
+            {
+                // the monitor blocks ctrl c, SIGTERM and SIGHUP to read them from a signalfd and ignores ctrl z and SIGPIPE, the
+                // command gets the defaults back so it can be stopped like any other
+                sigset_t empty;
+                sigemptyset(&empty);
+                sigprocmask(SIG_SETMASK, &empty, NULL);
+                signal(SIGTSTP, SIG_DFL);
+                signal(SIGPIPE, SIG_DFL);
+
+                char valueText[32];
+                snprintf(valueText, sizeof(valueText), "%.2f", value);
+                setenv("ALERT_RULE", rule->text, 1);
+                setenv("ALERT_STATE", rule->firing ? "firing" : "resolved", 1);
+                setenv("ALERT_VALUE", valueText, 1);
+                execl("/bin/sh", "sh", "-c", rule->command, (char *)NULL);
+                _exit(127);
+            }
+            _exit(0);
+        }
+        else
+        {
+            waitpid(pid, NULL, 0);
+        }
+    }
+}
+
+void alertsEvaluate(const struct alertSnapshot *snapshot, int sources)
+{
+    // This function evaluates the compiled rules whose metric comes from one of sources (the collectors that just sent a sample)
+    // against the given snapshot, so for=N and the rates count the samples of the rule's own collector. A rule fires once its
+    // condition held for forSamples consecutive samples and only resolves after the value stayed on the safe side of the clear
+    // value for forSamples consecutive samples, so a value hovering around the threshold does not flap.
+    // Example Output:
+    // with the rule cpu>90:for=2:exec=... and cpu usages of 95, 96
+    // alertsEvaluate(snapshot, ALERT_CPU) runs the command on the second call with ALERT_STATE=firing
+
+    if (ruleCount == 0)
+    {
+        return;
+    }
+
+    // the rules that changed state, their actions run once the evaluation is timed so a fork is not counted as its cost
+    struct alertRule *changed[MAX_ALERTS];
+    float changedValues[MAX_ALERTS];
+    int changedCount = 0;
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    int evaluated = 0;
+    for (int i = 0; i < ruleCount; i++)
+    {
+        struct alertRule *rule = &rules[i];
+        if (!(rule->source & sources))
+        {
+            continue;
+        }
+        evaluated++;
+        float value = rule->metric(rule, snapshot);
+
+        if (isnan(value))
+        {
+            continue;
+        }
+
+        // while firing the rule is compared against the clear value instead of the threshold
+        float limit = rule->firing ? rule->clear : rule->threshold;
+        bool breached = rule->above ? value > limit : value < limit;
+
+        if (breached != rule->firing)
+        {
+            rule->count++;
+        }
+        else
+        {
+            rule->count = 0;
+        }
+
+        if (rule->count >= rule->forSamples)
+        {
+            rule->firing = !rule->firing;
+            rule->count = 0;
+            changed[changedCount] = rule;
+            changedValues[changedCount++] = value;
+        }
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    evaluationNanoseconds += (end.tv_sec - start.tv_sec) * 1e9 + (end.tv_nsec - start.tv_nsec);
+    evaluatedRules += evaluated;
+
+    for (int i = 0; i < changedCount; i++)
+    {
+        fireAlert(changed[i], changedValues[i]);
+    }
+}
+
+double alertsCostPerRule()
+{
+    // This function returns the average time in microseconds that evaluating one rule took so far (the actions of the rules that
+    // changed state are run after the evaluation and not counted)
+    // Example Output:
+    // alertsCostPerRule() returns 0.08
+
+    if (evaluatedRules == 0)
+    {
+        return 0;
+    }
+
+    return evaluationNanoseconds / evaluatedRules / 1000.0;
+}
@@ -0,0 +1,35 @@
+// Author: Kristi Dodaj
+// alerts.h: Responsible for defining the alert rule engine that is evaluated against every sample (see alerts.c)
+
+#include <stdbool.h>
+
+#ifndef ALERTS
+#define ALERTS
+
+// the maximum number of --alert rules that can be given
+#define MAX_ALERTS 32
+
+// the collectors a rule's metric comes from, a rule is only evaluated on the samples of its own collector
+#define ALERT_CPU 1
+#define ALERT_MEMORY 2
+
+// one sample of every value an alert rule can be written against
+struct alertSnapshot
+{
+    double timestamp;      // seconds on CLOCK_MONOTONIC when the sample was taken
+    float cpuUsage;        // total cpu use in %
+    float memoryUsed;      // used physical RAM in GB
+    float memoryTotal;     // total physical RAM in GB
+    float memoryAvailable; // physical RAM still available in GB
+    float virtualUsed;     // used virtual RAM in GB
+};
+
+// define the function signatures
+
+bool alertsCompile(const char *rule);
+int alertsCount();
+int alertsSources();
+void alertsEvaluate(const struct alertSnapshot *snapshot, int sources);
+double alertsCostPerRule();
+
+#endif /* ALERTS */
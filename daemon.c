@@ -0,0 +1,305 @@
+// Author: Kristi Dodaj
+// daemon.c: Responsible for the --daemon mode that runs the collectors once and serves their latest messages to any number of
+// local viewers over a Unix domain socket, and for the connection a viewer (--connect) uses in place of a forked collector
+
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include "daemon.h"
+
+// the longest collector name a viewer can subscribe to
+#define DAEMON_NAME_LENGTH 32
+
+// one connected viewer, subscribed to one collector of the daemon
+struct client
+{
+    int fd;
+    char name[DAEMON_NAME_LENGTH]; // the collector name sent by the viewer, until the newline ends it
+    int nameLength;
+    bool subscribed;
+    struct collector *collector;   // NULL when the daemon does not run that collector
+};
+
+static struct collector **served = NULL;
+static int servedCount = 0;
+static int listenFd = -1;
+static const char *socketPath = NULL;
+
+static bool privateDirectory(const char *path)
+{
+    // This function returns true if path is a directory (not a symbolic link) that belongs to the user and that nobody else can
+    // open, so no other user can have put a socket of their own in it
+
+    struct stat status;
+    return lstat(path, &status) == 0 && S_ISDIR(status.st_mode) && status.st_uid == getuid() && (status.st_mode & 077) == 0;
+}
+
+const char *daemonDefaultSocket()
+{
+    // This function returns the socket the daemon listens on when no path is given: in $XDG_RUNTIME_DIR, which only its user can
+    // open, or else in /tmp/system-monitor-UID, created with mode 0700 if it does not exist yet. The program exits if that
+    // directory belongs to someone else or can be opened by others, since a socket in it could then be another user's.
+    // Example Output:
+    // daemonDefaultSocket() returns "/run/user/1000/system-monitor.sock"
+
+    static char path[108];
+    const char *runtime = getenv("XDG_RUNTIME_DIR");
+    if (runtime != NULL && *runtime == '/' && privateDirectory(runtime))
+    {
+        snprintf(path, sizeof(path), "%s/%s", runtime, DAEMON_SOCKET_NAME);
+        return path;
+    }
+
+    char directory[64];
+    snprintf(directory, sizeof(directory), "/tmp/system-monitor-%d", (int)getuid());
+    if (mkdir(directory, 0700) == -1 && errno != EEXIST)
+    {
+        perror("mkdir: Failed to create the daemon socket directory");
+        exit(EXIT_FAILURE);
+    }
+    if (!privateDirectory(directory))
+    {
+        printf("%s IS NOT A PRIVATE DIRECTORY OF THIS USER, GIVE THE DAEMON SOCKET PATH (--daemon=PATH). TRY AGAIN!\n", directory);
+        exit(EXIT_FAILURE);
+    }
+    snprintf(path, sizeof(path), "%s/%s", directory, DAEMON_SOCKET_NAME);
+    return path;
+}
+
+static void clientClose(struct client *client)
+{
+    // This function drops a viewer that went away or misbehaved
+    eventLoopUnwatch(client->fd);
+    close(client->fd);
+    free(client);
+}
+
+static bool clientReply(struct client *client)
+{
+    // This function answers one request of a viewer with the latest message of its collector, in the same length-prefixed format a
+    // collector process uses (see sendMessage() in event_loop.c), and returns false if the viewer cannot be written to
+    // NOTE: send() is used with MSG_NOSIGNAL so a viewer that disconnects does not kill the daemon with SIGPIPE
+
+    static const char missing[] = "(not collected by the daemon)\n";
+    const char *message = client->collector != NULL ? client->collector->latest : missing;
+    int length = client->collector != NULL ? client->collector->latestLength : (int)sizeof(missing) - 1;
+
+    char buf[sizeof(int) + COLLECTOR_BUFFER];
+    memcpy(buf, &length, sizeof(int));
+    memcpy(buf + sizeof(int), message, length);
+
+    ssize_t sent = send(client->fd, buf, sizeof(int) + length, MSG_NOSIGNAL);
+    if (sent == -1 && errno == EAGAIN)
+    {
+        // the viewer is not reading, skip this answer and let it show its collector as late
+        return true;
+    }
+    return sent == (ssize_t)(sizeof(int) + length);
+}
+
+static void clientReady(int fd, void *context)
+{
+    // This function reads what a viewer sent: first the name of the collector it wants followed by a newline, then one byte per
+    // sample it asks for, each answered with the latest message of that collector
+
+    struct client *client = context;
+    char input[256];
+    ssize_t count = read(fd, input, sizeof(input));
+
+    if (count == 0 || (count < 0 && errno != EAGAIN && errno != EINTR))
+    {
+        clientClose(client);
+        return;
+    }
+
+    for (ssize_t i = 0; i < count; i++)
+    {
+        if (client->subscribed)
+        {
+            if (!clientReply(client))
+            {
+                clientClose(client);
+                return;
+            }
+        }
+        else if (input[i] == '\n')
+        {
+            client->name[client->nameLength] = '\0';
+            client->subscribed = true;
+            for (int j = 0; j < servedCount; j++)
+            {
+                if (strcmp(served[j]->name, client->name) == 0)
+                {
+                    client->collector = served[j];
+                }
+            }
+        }
+        else if (client->nameLength < DAEMON_NAME_LENGTH - 1)
+        {
+            client->name[client->nameLength++] = input[i];
+        }
+    }
+}
+
+static void acceptClients(int fd, void *context)
+{
+    // This function accepts every viewer that is waiting to connect and starts watching it
+
+    int clientFd;
+    while ((clientFd = accept4(fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC)) != -1)
+    {
+        struct client *client = calloc(1, sizeof(struct client));
+        if (!client)
+        {
+            perror("Error allocating memory");
+            exit(EXIT_FAILURE);
+        }
+        client->fd = clientFd;
+        eventLoopWatch(clientFd, clientReady, client);
+    }
+}
+
+void daemonServe(const char *path, struct collector **collectors, int count)
+{
+    // This function listens on the Unix domain socket at path and serves the latest message of the given (already started)
+    // collectors to every viewer that connects, until the process is stopped. The collectors are sampled on their own intervals
+    // by the event loop whether there are no viewers or a hundred, so the cost of collecting does not grow with the viewers; each
+    // request of a viewer is answered from the message already in memory.
+    // NOTE: The socket gets the permissions of the umask. Viewers only trust a daemon of their own user or root (see
+    // collectorConnect()), so on a shared host it is run as root with a path the viewers can reach.
+    // Example Output:
+    // daemonServe("/run/user/1000/system-monitor.sock", collectors, 3) prints
+    //
+    // Serving memory, cpu, users on /run/user/1000/system-monitor.sock
+
+    served = collectors;
+    servedCount = count;
+    socketPath = path;
+
+    struct sockaddr_un address = {.sun_family = AF_UNIX};
+    if (strlen(path) >= sizeof(address.sun_path))
+    {
+        printf("THE DAEMON SOCKET PATH IS TOO LONG. TRY AGAIN!\n");
+        exit(EXIT_FAILURE);
+    }
+    strcpy(address.sun_path, path);
+
+    listenFd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (listenFd == -1)
+    {
+        perror("socket: Failed to create the daemon socket");
+        exit(EXIT_FAILURE);
+    }
+
+    // a socket file left behind by a daemon of this user that was killed would make bind fail, anything else at path is left alone
+    struct stat status;
+    if (lstat(path, &status) == 0 && S_ISSOCK(status.st_mode) && status.st_uid == getuid())
+    {
+        unlink(path);
+    }
+    if (bind(listenFd, (struct sockaddr *)&address, sizeof(address)) == -1 || listen(listenFd, SOMAXCONN) == -1)
+    {
+        perror("bind: Failed to listen on the daemon socket");
+        exit(EXIT_FAILURE);
+    }
+
+    printf("Serving");
+    for (int i = 0; i < count; i++)
+    {
+        printf("%s %s", i == 0 ? "" : ",", collectors[i]->name);
+    }
+    printf(" on %s\n", path);
+    fflush(stdout);
+
+    eventLoopWatch(listenFd, acceptClients, NULL);
+}
+
+void daemonStop()
+{
+    // This function stops listening and removes the socket file once the daemon is stopped (SIGTERM, SIGHUP or ctrl c), so the
+    // viewers that connect afterwards are told there is no daemon instead of waiting on a socket nobody accepts
+
+    if (listenFd == -1)
+    {
+        return;
+    }
+    eventLoopUnwatch(listenFd);
+    close(listenFd);
+    unlink(socketPath);
+    listenFd = -1;
+}
+
+void collectorConnect(struct collector *collector, const char *name, const char *path, int interval)
+{
+    // This function sets up a collector that is a connection to the daemon instead of a forked process. It subscribes to the
+    // daemon's collector with the same name, and from then on the event loop uses it like any other collector: every request byte
+    // is answered with one length-prefixed message.
+    // Example Output:
+    // collectorConnect(&memory, "memory", "/run/user/1000/system-monitor.sock", 1000) connects and subscribes to the daemon's memory usage
+
+    memset(collector, 0, sizeof(*collector));
+    collector->name = name;
+    collector->interval = interval;
+    collector->pid = -1;
+
+    struct sockaddr_un address = {.sun_family = AF_UNIX};
+    snprintf(address.sun_path, sizeof(address.sun_path), "%s", path);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd == -1 || connect(fd, (struct sockaddr *)&address, sizeof(address)) == -1)
+    {
+        perror("connect: Failed to connect to the daemon (is ./monitor --daemon running?)");
+        exit(EXIT_FAILURE);
+    }
+
+    // the frames are only trusted from a daemon of this user or root, not from whoever created a socket at path
+    struct ucred peer;
+    socklen_t peerLength = sizeof(peer);
+    if (getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &peer, &peerLength) == -1 || (peer.uid != getuid() && peer.uid != 0))
+    {
+        printf("THE DAEMON SOCKET %s IS NOT SERVED BY THIS USER OR ROOT. TRY AGAIN!\n", path);
+        exit(EXIT_FAILURE);
+    }
+
+    // subscribe while the socket is still blocking, then read and write it like the collector pipes
+    char subscription[DAEMON_NAME_LENGTH + 1];
+    int length = snprintf(subscription, sizeof(subscription), "%s\n", name);
+    if (write(fd, subscription, length) != length)
+    {
+        perror("write: Failed to subscribe to the daemon");
+        exit(EXIT_FAILURE);
+    }
+
+    // a daemon that goes away is shown as a closed collector rather than killing the viewer on its next request
+    signal(SIGPIPE, SIG_IGN);
+
+    int flags = fcntl(fd, F_GETFL);
+    if (flags == -1 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) == -1)
+    {
+        perror("fcntl: Failed to make the daemon socket non-blocking");
+    }
+
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    collector->fd = collector->requestFd = fd;
+    collector->lastUpdate = now.tv_sec * 1000000000LL + now.tv_nsec;
+
+    // the buffers are allocated once here so reading the socket never allocates
+    collector->latest = malloc(COLLECTOR_BUFFER + 1);
+    collector->pending = malloc(COLLECTOR_BUFFER + sizeof(int));
+    if (!collector->latest || !collector->pending)
+    {
+        perror("Error allocating memory");
+        exit(EXIT_FAILURE);
+    }
+    collector->latest[0] = '\0';
+}
@@ -0,0 +1,21 @@
+// Author: Kristi Dodaj
+// daemon.h: Responsible for defining the local fan-out daemon and the connections its viewers use (see daemon.c)
+
+#include "event_loop.h"
+
+#ifndef DAEMON
+#define DAEMON
+
+// the socket the daemon listens on when --daemon and --connect are given without a path, in $XDG_RUNTIME_DIR or else in a
+// directory of the user's own under /tmp (see daemonDefaultSocket())
+#define DAEMON_SOCKET_NAME "system-monitor.sock"
+
+// define the function signatures
+
+const char *daemonDefaultSocket();
+
+void daemonServe(const char *path, struct collector **collectors, int count);
+void daemonStop();
+void collectorConnect(struct collector *collector, const char *name, const char *path, int interval);
+
+#endif /* DAEMON */
@@ -0,0 +1,652 @@
+// Author: Kristi Dodaj
+// event_loop.c: Responsible for forking the collector processes and running the epoll loop that schedules each of them on its own
+// interval, reads them independently and draws the display on its own timer with whatever values have arrived
+
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <signal.h>
+#include <time.h>
+#include <sys/epoll.h>
+#include <sys/signalfd.h>
+#include <sys/timerfd.h>
+#include <sys/uio.h>
+#include <sys/wait.h>
+#include "event_loop.h"
+#include "overhead.h"
+#include "isolation.h"
+
+// time given to the collectors after each tdelay before the frame is drawn, so values that are only just due are not flagged late
+#define FRAME_GRACE_NANOSECONDS 100000000
+
+// one entry of the deadline heap, either a collector that is due for a sample or the next frame (collector == NULL)
+struct deadline
+{
+    long long when; // CLOCK_MONOTONIC nanoseconds
+    struct collector *collector;
+};
+
+// a file descriptor other than the collectors that the event loop watches (see eventLoopWatch())
+struct watch
+{
+    int fd;          // -1 when the slot is free
+    uint32_t events; // EPOLLIN, or EPOLLOUT for an output waiting to be written (see eventLoopWatchWritable())
+    void (*ready)(int fd, void *context);
+    void *context;
+};
+
+static struct watch watches[MAX_WATCHES];
+static int watchCount = 0;
+static int runningEpollFd = -1; // the epoll of the loop that is running, so watches can be added from its callbacks
+
+// the state of the running loop that its callbacks can change (see eventLoopPause(), eventLoopResume() and eventLoopStop())
+static bool paused = false;
+static bool stopping = false;
+static long long pausedAt = 0;
+
+// called with the signals the loop receives (see eventLoopOnSignal()), NULL to stop the loop on any of them
+static void (*signalHandler)(int signal, void *context) = NULL;
+static void *signalContext = NULL;
+
+// called with every collector that sent a new message (see eventLoopOnUpdate()), NULL when nobody needs to know
+static void (*updateHandler)(struct collector *collector, void *context) = NULL;
+static void *updateContext = NULL;
+
+// tells the signalfd apart from the timer (NULL) and the collectors in the epoll events
+static int signalMarker;
+
+static long long nowNanoseconds()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
+void collectorStart(struct collector *collector, const char *name, void (*sample)(int write_pipe), int interval)
+{
+    // This function creates the pipes of a collector and forks the process that runs it. The child blocks until the main process
+    // asks for a sample (one byte on the request pipe), calls sample(write_pipe) which sends exactly one message with sendMessage(),
+    // and goes back to waiting, so it costs nothing between samples. The main process keeps the non-blocking ends of both pipes.
+    // Example Output:
+    // collectorStart(&memory, "memory", getMemoryUsage, 500) forks a child that sends the memory usage whenever it is asked (every 500 ms)
+
+    memset(collector, 0, sizeof(*collector));
+    collector->name = name;
+    collector->interval = interval;
+    collector->lastUpdate = nowNanoseconds();
+
+    int fds[2], requestFds[2];
+    if (pipe2(fds, O_CLOEXEC) < 0 || pipe2(requestFds, O_CLOEXEC) < 0)
+    {
+        perror("Error creating pipes");
+        exit(EXIT_FAILURE);
+    }
+
+    collector->pid = fork();
+    overheadTrackChild(collector->pid);
+    if (collector->pid < 0)
+    {
+        perror("fork");
+        exit(1);
+    }
+    else if (collector->pid == 0)
+    {
+        signal(SIGINT, SIG_IGN); // ctrl c is handled by the main process only
+        close(fds[0]);           // close unused read end
+        close(requestFds[1]);    // close unused write end
+        isolationChild();        // memory locks are not inherited
+
+        // take one sample per request until the main process closes the request pipe
+        char request;
+        while (read(requestFds[0], &request, 1) == 1)
+        {
+            sample(fds[1]);
+        }
+
+        exit(0); // exit child process
+    }
+
+    // close unused ends of the pipes
+    close(fds[1]);
+    close(requestFds[0]);
+    collector->fd = fds[0];
+    collector->requestFd = requestFds[1];
+
+    if (fcntl(collector->fd, F_SETFL, O_NONBLOCK) == -1 || fcntl(collector->requestFd, F_SETFL, O_NONBLOCK) == -1)
+    {
+        perror("fcntl: Failed to make the collector pipes non-blocking");
+    }
+
+    // the buffers are allocated once here so reading the pipe never allocates
+    collector->latest = malloc(COLLECTOR_BUFFER + 1);
+    collector->pending = malloc(COLLECTOR_BUFFER + sizeof(int));
+    if (!collector->latest || !collector->pending)
+    {
+        perror("Error allocating memory");
+        exit(EXIT_FAILURE);
+    }
+    collector->latest[0] = '\0';
+}
+
+void collectorStop(struct collector *collector)
+{
+    // This function stops the collector process, waits for it so there are no orphan or zombie cases and frees its buffers.
+    // A collector that is a connection to the daemon (see collectorConnect() in daemon.c) has no process and is only closed.
+
+    if (collector->pid > 0)
+    {
+        kill(collector->pid, SIGKILL); // collectors keep no state worth cleaning up, and this also ends a stopped or stuck one
+        waitpid(collector->pid, NULL, 0);
+    }
+    close(collector->fd);
+    if (collector->requestFd != collector->fd)
+    {
+        close(collector->requestFd);
+    }
+
+    free(collector->latest);
+    free(collector->pending);
+    collector->latest = NULL;
+    collector->pending = NULL;
+}
+
+bool collectorHasData(const struct collector *collector)
+{
+    // This function returns whether the collector has sent at least one message
+    return collector->updates > 0;
+}
+
+bool collectorIsLate(const struct collector *collector)
+{
+    // This function returns whether the collector missed its own interval, i.e. nothing arrived for longer than one interval
+    // (plus the grace period). A collector with a long interval is therefore not flagged just because frames are drawn more often.
+
+    return nowNanoseconds() - collector->lastUpdate > collector->interval * 1000000LL + FRAME_GRACE_NANOSECONDS;
+}
+
+void sendMessage(int write_pipe, const char *message, int length)
+{
+    // This function sends one message from a collector to the main process. Messages are prefixed with their length so the
+    // main process can read the pipe without blocking and still know where each message ends.
+    // NOTE: Messages longer than COLLECTOR_BUFFER are cut short
+    // Example Output:
+    // sendMessage(write_pipe, "1.17", 4) writes 4 (as an int) followed by 1.17
+
+    if (length > COLLECTOR_BUFFER)
+    {
+        length = COLLECTOR_BUFFER;
+    }
+
+    // a single writev keeps the length and the message together (atomic for messages up to PIPE_BUF)
+    struct iovec parts[2] = {{&length, sizeof(length)}, {(void *)message, length}};
+    if (writev(write_pipe, parts, 2) == -1)
+    {
+        // the main process went away, so there is nobody left to collect for
+        exit(0);
+    }
+}
+
+static void collectorRequest(struct collector *collector)
+{
+    // This function asks the collector for a sample unless it has not answered the previous request yet, so a stuck collector
+    // does not pile up requests
+
+    if (collector->closed || collector->requests > collector->updates)
+    {
+        return;
+    }
+
+    char request = 1;
+    if (write(collector->requestFd, &request, 1) == 1)
+    {
+        collector->requests++;
+    }
+}
+
+static void collectorRead(struct collector *collector)
+{
+    // This function drains everything the collector has written so far and keeps the newest complete message
+    // NOTE: A daemon connection (see collectorConnect() in daemon.c) is read here as well, so a length prefix that cannot be a
+    // message closes the collector instead of being trusted
+
+    long long stage = overheadBegin();
+
+    while (1)
+    {
+        ssize_t count = read(collector->fd, collector->pending + collector->pendingLength, COLLECTOR_BUFFER + sizeof(int) - collector->pendingLength);
+
+        if (count == 0)
+        {
+            collector->closed = true;
+            break;
+        }
+        else if (count < 0)
+        {
+            if (errno != EAGAIN && errno != EINTR)
+            {
+                perror("read: Failed to read from a collector");
+                collector->closed = true;
+            }
+            break;
+        }
+
+        collector->pendingLength += count;
+
+        // take every complete message out of the pending bytes
+        int length;
+        while (collector->pendingLength >= (int)sizeof(int))
+        {
+            memcpy(&length, collector->pending, sizeof(int));
+            if (length < 0 || length > COLLECTOR_BUFFER)
+            {
+                fprintf(stderr, "INVALID MESSAGE LENGTH FROM A COLLECTOR, CLOSING IT\n");
+                collector->closed = true;
+                collector->pendingLength = 0;
+                break;
+            }
+            if (collector->pendingLength < (int)sizeof(int) + length)
+            {
+                break;
+            }
+
+            memcpy(collector->latest, collector->pending + sizeof(int), length);
+            collector->latest[length] = '\0';
+            collector->latestLength = length;
+            collector->updates++;
+            collector->lastUpdate = nowNanoseconds();
+
+            collector->pendingLength -= sizeof(int) + length;
+            memmove(collector->pending, collector->pending + sizeof(int) + length, collector->pendingLength);
+        }
+
+        if (collector->closed)
+        {
+            break;
+        }
+    }
+
+    overheadEnd(STAGE_READ, stage);
+}
+
+static void heapPush(struct deadline *heap, int *size, struct deadline entry)
+{
+    // This function adds an entry to the min-heap of deadlines (earliest deadline at heap[0])
+
+    int i = (*size)++;
+    while (i > 0 && heap[(i - 1) / 2].when > entry.when)
+    {
+        heap[i] = heap[(i - 1) / 2];
+        i = (i - 1) / 2;
+    }
+    heap[i] = entry;
+}
+
+static struct deadline heapPop(struct deadline *heap, int *size)
+{
+    // This function removes and returns the earliest entry of the min-heap of deadlines
+
+    struct deadline top = heap[0];
+    struct deadline last = heap[--(*size)];
+
+    int i = 0;
+    while (2 * i + 1 < *size)
+    {
+        int child = 2 * i + 1;
+        if (child + 1 < *size && heap[child + 1].when < heap[child].when)
+        {
+            child++;
+        }
+        if (heap[child].when >= last.when)
+        {
+            break;
+        }
+        heap[i] = heap[child];
+        i = child;
+    }
+    heap[i] = last;
+
+    return top;
+}
+
+static void watchAdd(int fd, uint32_t events, void (*ready)(int fd, void *context), void *context)
+{
+    // This function puts fd into a free slot of the watches, and into the running epoll if there is one
+
+    int slot = 0;
+    while (slot < watchCount && watches[slot].fd != -1)
+    {
+        slot++;
+    }
+    if (slot == MAX_WATCHES)
+    {
+        fprintf(stderr, "TOO MANY WATCHED FILE DESCRIPTORS, IGNORING ONE\n");
+        close(fd);
+        return;
+    }
+    if (slot == watchCount)
+    {
+        watchCount++;
+    }
+
+    watches[slot] = (struct watch){fd, events, ready, context};
+
+    if (runningEpollFd != -1)
+    {
+        struct epoll_event event = {.events = events, .data.ptr = &watches[slot]};
+        if (epoll_ctl(runningEpollFd, EPOLL_CTL_ADD, fd, &event) == -1)
+        {
+            perror("epoll_ctl: Failed to watch a file descriptor");
+        }
+    }
+}
+
+void eventLoopWatch(int fd, void (*ready)(int fd, void *context), void *context)
+{
+    // This function makes the event loop call ready(fd, context) whenever fd can be read (ex. a listening socket or a client of
+    // the daemon). It can be called before eventLoopRun() or from inside one of its callbacks.
+    // Example Output:
+    // eventLoopWatch(listenFd, acceptClient, NULL) calls acceptClient(listenFd, NULL) for every new connection
+
+    watchAdd(fd, EPOLLIN, ready, context);
+}
+
+void eventLoopWatchWritable(int fd, void (*ready)(int fd, void *context), void *context)
+{
+    // This function makes the event loop call ready(fd, context) whenever fd can be written without blocking (ex. stdout while
+    // frames are waiting to be written, see output.c). Call eventLoopUnwatch() once there is nothing left to write.
+    // Example Output:
+    // eventLoopWatchWritable(STDOUT_FILENO, outputReady, NULL) calls outputReady(STDOUT_FILENO, NULL) once the terminal catches up
+
+    watchAdd(fd, EPOLLOUT, ready, context);
+}
+
+void eventLoopUnwatch(int fd)
+{
+    // This function stops watching fd (it does not close it)
+
+    for (int i = 0; i < watchCount; i++)
+    {
+        if (watches[i].fd == fd)
+        {
+            if (runningEpollFd != -1)
+            {
+                epoll_ctl(runningEpollFd, EPOLL_CTL_DEL, fd, NULL);
+            }
+            watches[i].fd = -1;
+        }
+    }
+}
+
+void eventLoopOnSignal(void (*handler)(int signal, void *context), void *context)
+{
+    // This function makes the event loop call handler(signal, context) when the monitor receives SIGINT (ctrl c), SIGTERM or
+    // SIGHUP. The signals are read from a signalfd by the loop like any other event, so the handler is an ordinary function that
+    // can print, read stdin and pause or stop the loop; nothing runs in signal context. Without a handler the loop stops.
+    // Example Output:
+    // eventLoopOnSignal(handleInterrupt, &display) calls handleInterrupt(SIGINT, &display) when ctrl c is pressed
+
+    signalHandler = handler;
+    signalContext = context;
+}
+
+void eventLoopOnUpdate(void (*handler)(struct collector *collector, void *context), void *context)
+{
+    // This function makes the event loop call handler(collector, context) as soon as a collector sent a new message, between the
+    // frames, so a value can be acted on once per sample of its collector instead of once per frame. A collector that sent more than
+    // one message since it was last read is reported once, with its newest message in collector->latest.
+    // Example Output:
+    // eventLoopOnUpdate(handleUpdate, &display) calls handleUpdate(&cpu, &display) every time the cpu collector answers
+
+    updateHandler = handler;
+    updateContext = context;
+}
+
+void eventLoopPause()
+{
+    // This function pauses the running loop: the timer is disarmed, so no collector is asked for a sample and no frame is drawn
+    // until eventLoopResume(). The collectors only sample when asked, so they are blocked in read() for the whole pause.
+
+    if (!paused)
+    {
+        paused = true;
+        pausedAt = nowNanoseconds();
+    }
+}
+
+void eventLoopResume()
+{
+    // This function resumes the loop after eventLoopPause(). Every deadline is moved back by the length of the pause, so the
+    // collectors and the display carry on where they were instead of catching up or being flagged late.
+    paused = false;
+}
+
+void eventLoopStop()
+{
+    // This function makes the running loop return once the current callback is done, so the caller can shut down cleanly
+    stopping = true;
+}
+
+static bool isWatch(void *pointer)
+{
+    // This function tells the watches apart from the collectors in the epoll events
+    return pointer >= (void *)watches && pointer < (void *)(watches + MAX_WATCHES);
+}
+
+void eventLoopRun(struct collector **collectors, int count, int frames, int tdelay, void (*render)(int frame, void *context), void *context)
+{
+    // This function runs the main loop of the monitor. Every collector and the display have their own interval, and their next
+    // deadlines are kept in a min-heap: one timer is always armed for the earliest deadline, and when it expires every entry that
+    // is due is handled (a collector is asked for a sample, or render(frame, context) draws a frame) and put back with its next
+    // deadline. The collector pipes are watched with the same epoll so each one is read as soon as it answers, without waiting for
+    // the others. A collector that is slow or stuck therefore never holds the display back; render() can use collectorIsLate() to
+    // flag it instead. The function returns once frames frames were drawn (never if frames is negative) or eventLoopStop() was
+    // called. The file descriptors given to eventLoopWatch() and the signals (see eventLoopOnSignal()) are watched by the same epoll.
+    // Example Output:
+    // with cpu every 100 ms, memory every 500 ms and tdelay = 1
+    // eventLoopRun(collectors, 2, 10, 1, renderFrame, &display) asks for 10 cpu and 2 memory samples per frame and draws 10 frames
+
+    int epollFd = epoll_create1(EPOLL_CLOEXEC);
+    if (epollFd == -1)
+    {
+        perror("epoll_create1: Failed to create the event loop");
+        exit(EXIT_FAILURE);
+    }
+
+    for (int i = 0; i < count; i++)
+    {
+        struct epoll_event event = {.events = EPOLLIN, .data.ptr = collectors[i]};
+        if (epoll_ctl(epollFd, EPOLL_CTL_ADD, collectors[i]->fd, &event) == -1)
+        {
+            perror("epoll_ctl: Failed to watch a collector");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    // the single timer that is always armed for the earliest deadline
+    int timerFd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
+    if (timerFd == -1)
+    {
+        perror("timerfd_create: Failed to create the scheduling timer");
+        exit(EXIT_FAILURE);
+    }
+
+    struct epoll_event timerEvent = {.events = EPOLLIN, .data.ptr = NULL};
+    epoll_ctl(epollFd, EPOLL_CTL_ADD, timerFd, &timerEvent);
+
+    // ctrl c, SIGTERM and SIGHUP are blocked and read from a signalfd instead of interrupting the loop
+    sigset_t signals, previousSignals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    sigaddset(&signals, SIGHUP);
+    sigprocmask(SIG_BLOCK, &signals, &previousSignals);
+
+    int signalFd = signalfd(-1, &signals, SFD_NONBLOCK | SFD_CLOEXEC);
+    if (signalFd == -1)
+    {
+        perror("signalfd: Failed to watch the signals");
+        exit(EXIT_FAILURE);
+    }
+
+    struct epoll_event signalEvent = {.events = EPOLLIN, .data.ptr = &signalMarker};
+    epoll_ctl(epollFd, EPOLL_CTL_ADD, signalFd, &signalEvent);
+
+    for (int i = 0; i < watchCount; i++)
+    {
+        struct epoll_event event = {.events = watches[i].events, .data.ptr = &watches[i]};
+        if (watches[i].fd != -1 && epoll_ctl(epollFd, EPOLL_CTL_ADD, watches[i].fd, &event) == -1)
+        {
+            perror("epoll_ctl: Failed to watch a file descriptor");
+        }
+    }
+    runningEpollFd = epollFd;
+
+    // every collector is due straight away, the first frame after one tdelay so a full cpu interval is in it
+    struct deadline heap[MAX_COLLECTORS + 1];
+    int heapSize = 0;
+    long long start = nowNanoseconds();
+    long long frameInterval = tdelay * 1000000000LL;
+
+    for (int i = 0; i < count; i++)
+    {
+        heapPush(heap, &heapSize, (struct deadline){start, collectors[i]});
+    }
+    heapPush(heap, &heapSize, (struct deadline){start + frameInterval + FRAME_GRACE_NANOSECONDS, NULL});
+
+    int frame = 0;
+    struct epoll_event events[MAX_COLLECTORS + 2 + MAX_WATCHES];
+    paused = false;
+    stopping = false;
+
+    while ((frames < 0 || frame < frames) && !stopping)
+    {
+        // arm the timer for the earliest deadline (a zero time disarms it while paused)
+        struct itimerspec next = {.it_value = {heap[0].when / 1000000000LL, heap[0].when % 1000000000LL}};
+        if (paused)
+        {
+            next.it_value = (struct timespec){0, 0};
+        }
+        timerfd_settime(timerFd, TFD_TIMER_ABSTIME, &next, NULL);
+
+        int ready = epoll_wait(epollFd, events, MAX_COLLECTORS + 2 + MAX_WATCHES, -1);
+        if (ready == -1)
+        {
+            // interrupted by a signal that is not read from the signalfd (ex. a terminal resize), just wait again
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            perror("epoll_wait: Event loop failed");
+            break;
+        }
+
+        // read the collectors first so a frame that is due at the same time sees their values
+        bool timerExpired = false;
+        bool wasPaused = paused;
+        for (int i = 0; i < ready; i++)
+        {
+            struct collector *collector = events[i].data.ptr;
+
+            if (events[i].data.ptr == &signalMarker)
+            {
+                struct signalfd_siginfo info;
+                while (read(signalFd, &info, sizeof(info)) == sizeof(info))
+                {
+                    if (signalHandler != NULL)
+                    {
+                        signalHandler(info.ssi_signo, signalContext);
+                    }
+                    else
+                    {
+                        stopping = true;
+                    }
+                }
+            }
+            else if (isWatch(events[i].data.ptr))
+            {
+                struct watch *watch = events[i].data.ptr;
+                if (watch->fd != -1)
+                {
+                    watch->ready(watch->fd, watch->context);
+                }
+            }
+            else if (collector == NULL)
+            {
+                uint64_t expirations;
+                read(timerFd, &expirations, sizeof(expirations));
+                timerExpired = true;
+            }
+            else
+            {
+                long updates = collector->updates;
+                collectorRead(collector);
+                if (updateHandler != NULL && collector->updates != updates)
+                {
+                    updateHandler(collector, updateContext);
+                }
+                if (collector->closed)
+                {
+                    epoll_ctl(epollFd, EPOLL_CTL_DEL, collector->fd, NULL);
+                }
+            }
+        }
+
+        if (wasPaused && !paused)
+        {
+            // move everything back by the length of the pause
+            long long pause = nowNanoseconds() - pausedAt;
+            for (int i = 0; i < heapSize; i++)
+            {
+                heap[i].when += pause;
+            }
+            for (int i = 0; i < count; i++)
+            {
+                collectors[i]->lastUpdate += pause;
+            }
+        }
+
+        if (!timerExpired || paused || stopping)
+        {
+            continue;
+        }
+
+        // handle everything that is due
+        long long now = nowNanoseconds();
+        while (heapSize > 0 && heap[0].when <= now && (frames < 0 || frame < frames) && !paused && !stopping)
+        {
+            struct deadline due = heapPop(heap, &heapSize);
+            long long interval;
+
+            if (due.collector == NULL)
+            {
+                render(frame, context);
+                frame++;
+                interval = frameInterval;
+            }
+            else
+            {
+                collectorRequest(due.collector);
+                interval = due.collector->interval * 1000000LL;
+            }
+
+            // schedule the next deadline, skipping the ones that were missed (ex. while the terminal was suspended)
+            due.when += interval;
+            if (due.when <= now)
+            {
+                due.when = now + interval;
+            }
+            heapPush(heap, &heapSize, due);
+        }
+    }
+
+    runningEpollFd = -1;
+    close(signalFd);
+    close(timerFd);
+    close(epollFd);
+    sigprocmask(SIG_SETMASK, &previousSignals, NULL);
+}
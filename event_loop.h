@@ -0,0 +1,54 @@
+// Author: Kristi Dodaj
+// event_loop.h: Responsible for defining the collector processes and the epoll loop that reads them (see event_loop.c)
+
+#include <stdbool.h>
+#include <sys/types.h>
+
+#ifndef EVENT_LOOP
+#define EVENT_LOOP
+
+// the largest message a collector can send to the main process
+#define COLLECTOR_BUFFER 65536
+
+// the most collectors one event loop can watch
+#define MAX_COLLECTORS 16
+
+// the most other file descriptors (ex. daemon clients) one event loop can watch
+#define MAX_WATCHES 256
+
+// one forked collector and the latest message it sent through its pipe
+struct collector
+{
+    const char *name;
+    pid_t pid;               // the collector process (-1 for a connection to the daemon)
+    int fd;                  // non-blocking read end of the collector's pipe (or the daemon socket)
+    int requestFd;           // write end of the pipe used to ask the collector for a sample (or the daemon socket)
+    int interval;            // milliseconds between two samples of this collector
+    char *latest;            // the last complete message (always null terminated)
+    int latestLength;        // length of latest without the null terminator
+    char *pending;           // bytes of a message that has not fully arrived yet
+    int pendingLength;       // number of bytes in pending
+    long requests;           // number of samples asked for so far
+    long updates;            // number of messages received so far
+    long long lastUpdate;    // CLOCK_MONOTONIC nanoseconds of the last message (or of the start)
+    bool closed;             // the collector exited or closed its pipe
+};
+
+// define the function signatures
+
+void collectorStart(struct collector *collector, const char *name, void (*sample)(int write_pipe), int interval);
+void collectorStop(struct collector *collector);
+bool collectorHasData(const struct collector *collector);
+bool collectorIsLate(const struct collector *collector);
+void sendMessage(int write_pipe, const char *message, int length);
+void eventLoopWatch(int fd, void (*ready)(int fd, void *context), void *context);
+void eventLoopWatchWritable(int fd, void (*ready)(int fd, void *context), void *context);
+void eventLoopUnwatch(int fd);
+void eventLoopOnSignal(void (*handler)(int signal, void *context), void *context);
+void eventLoopOnUpdate(void (*handler)(struct collector *collector, void *context), void *context);
+void eventLoopPause();
+void eventLoopResume();
+void eventLoopStop();
+void eventLoopRun(struct collector **collectors, int count, int frames, int tdelay, void (*render)(int frame, void *context), void *context);
+
+#endif /* EVENT_LOOP */
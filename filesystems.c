@@ -0,0 +1,296 @@
+// Author: Kristi Dodaj
+// filesystems.c: Responsible for the optional collector of the space and inodes used on every mounted filesystem and how fast it fills
+// up. The mount table (/proc/self/mountinfo) is parsed once and kept open; the kernel flags it with POLLPRI whenever a filesystem is
+// mounted or unmounted, so a sample only checks it with poll() and parses it again when it changed. Each sample is then one statvfs()
+// per filesystem.
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <time.h>
+#include <poll.h>
+#include <sys/statvfs.h>
+#include "filesystems.h"
+#include "procfile.h"
+#include "event_loop.h"
+#include "overhead.h"
+#include "stats_functions.h"
+
+// a mounted filesystem and its fill rate, kept across changes of the mount table by its mount id
+struct mount
+{
+    int id;                 // the first field of mountinfo
+    unsigned int major;     // the device, a filesystem mounted more than once (ex. bind mounts) is shown once
+    unsigned int minor;
+    char point[256];
+    char type[32];
+    bool rated;             // fillRate is set (the filesystem was sampled twice)
+    long long previousFree; // bytes available at the previous sample, -1 before the first
+    long long previousTime;
+    double fillRate;        // bytes per second that are used up (smoothed), negative while space is freed
+};
+
+// the filesystem types that have no space of their own to run out of
+static const char *pseudoTypes[] = {"proc", "sysfs", "devtmpfs", "devpts", "cgroup", "cgroup2", "securityfs", "pstore", "bpf", "debugfs", "tracefs", "mqueue", "hugetlbfs", "configfs", "fusectl", "autofs", "binfmt_misc", "efivarfs", "rpc_pipefs", "nsfs", "selinuxfs", "ramfs", "squashfs"};
+
+#define PSEUDO_TYPE_COUNT (int)(sizeof(pseudoTypes) / sizeof(pseudoTypes[0]))
+
+static struct procFile mountinfo;
+static bool opened = false;
+static struct mount *mounts = NULL;
+static int mountCount = 0;
+static int parses = 0;
+
+static bool pseudoType(const char *type)
+{
+    for (int i = 0; i < PSEUDO_TYPE_COUNT; i++)
+    {
+        if (strcmp(pseudoTypes[i], type) == 0)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+static void unescape(char *path)
+{
+    // This function decodes the octal escapes of mountinfo in place (a space in a mount point is written as \040)
+
+    char *out = path;
+    for (char *in = path; *in != '\0'; in++)
+    {
+        if (in[0] == '\\' && in[1] >= '0' && in[1] <= '3' && in[2] >= '0' && in[2] <= '7' && in[3] >= '0' && in[3] <= '7')
+        {
+            *out++ = (in[1] - '0') * 64 + (in[2] - '0') * 8 + (in[3] - '0');
+            in += 3;
+        }
+        else
+        {
+            *out++ = *in;
+        }
+    }
+    *out = '\0';
+}
+
+static void parseMounts()
+{
+    // This function reads the mount table again and keeps the filesystems that can fill up, each device once. A filesystem that
+    // was already mounted keeps its fill rate.
+
+    const char *text = procFileRead(&mountinfo);
+    parses++;
+
+    struct mount *previous = mounts;
+    int previousCount = mountCount;
+    mounts = NULL;
+    mountCount = 0;
+    int capacity = 0;
+
+    // mountinfo: id parent major:minor root point options [optional fields] - type source super options
+    // NOTE: A last line without a newline was cut short, so it is skipped rather than parsed as a mount point
+    const char *line = text;
+    while (line != NULL && *line != '\0')
+    {
+        struct mount mount = {.previousFree = -1};
+        const char *separator = strstr(line, " - ");
+        const char *end = strchr(line, '\n');
+        if (separator != NULL && end != NULL && separator < end && sscanf(line, "%d %*d %u:%u %*s %255s", &mount.id, &mount.major, &mount.minor, mount.point) == 4 && sscanf(separator + 3, "%31s", mount.type) == 1 && !pseudoType(mount.type))
+        {
+            unescape(mount.point);
+
+            for (int i = 0; i < previousCount; i++)
+            {
+                if (previous[i].id == mount.id)
+                {
+                    mount = previous[i];
+                    break;
+                }
+            }
+
+            // a filesystem mounted over another hides it (statvfs() sees the one on top), a device mounted twice is shown once
+            int seen = -1;
+            for (int i = 0; i < mountCount && seen == -1; i++)
+            {
+                if (strcmp(mounts[i].point, mount.point) == 0)
+                {
+                    mounts[i] = mount;
+                    seen = i;
+                }
+                else if (mounts[i].major == mount.major && mounts[i].minor == mount.minor)
+                {
+                    seen = i;
+                }
+            }
+
+            if (seen == -1)
+            {
+                if (mountCount == capacity)
+                {
+                    capacity = capacity == 0 ? 16 : capacity * 2;
+                    mounts = realloc(mounts, capacity * sizeof(struct mount));
+                    if (!mounts)
+                    {
+                        perror("Error allocating memory");
+                        exit(EXIT_FAILURE);
+                    }
+                }
+                mounts[mountCount++] = mount;
+            }
+        }
+
+        line = end;
+        if (line != NULL)
+        {
+            line++;
+        }
+    }
+
+    free(previous);
+}
+
+static int formatTime(char *buf, int size, double seconds)
+{
+    // This function writes a time to full in the largest unit that keeps it readable
+    // Example Output:
+    // formatTime(buf, size, 280000) writes "3.2 days"
+
+    if (seconds < 120)
+    {
+        return snprintf(buf, size, "%.0f s", seconds);
+    }
+    if (seconds < 7200)
+    {
+        return snprintf(buf, size, "%.1f min", seconds / 60);
+    }
+    if (seconds < 172800)
+    {
+        return snprintf(buf, size, "%.1f h", seconds / 3600);
+    }
+    return snprintf(buf, size, "%.1f days", seconds / 86400);
+}
+
+void getFilesystemUsage(int write_pipe)
+{
+    // This function writes the size, the space used and the inodes used of every mounted filesystem to the write_pipe, with the
+    // time until it is full at the rate it filled up over the last samples (a moving average, see FILESYSTEMS_RATE_WEIGHT). The
+    // space used is of the space a regular user can use, like df, so the blocks reserved for root do not hide a full disk. In
+    // graphics mode each line ends with a bar of the space used, one # per 5 %.
+    // NOTE: A network filesystem whose server hangs blocks statvfs(), the panel is then shown as late
+    // Example Output:
+    // getFilesystemUsage(write_pipe) writes
+    //
+    // MOUNT                     TYPE            SIZE     USED   INODES  TIME TO FULL
+    // /                         ext4         98.2 GB   62.0 %   12.0 %  3.2 days
+    // /var/lib/postgresql       xfs         512.0 GB   91.4 %    0.8 %  5.5 h
+    // 6 filesystems -- mount table parsed 2 times (only when it changed)
+
+    long long stage = overheadBegin();
+    if (!opened)
+    {
+        procFileOpen(&mountinfo, "/proc/self/mountinfo");
+        opened = true;
+        parseMounts();
+    }
+    else
+    {
+        // the kernel raises POLLPRI (and POLLERR) on mountinfo once the mount table changed since it was last polled
+        struct pollfd watch = {.fd = mountinfo.fd, .events = POLLPRI};
+        if (mountinfo.fd != -1 && poll(&watch, 1, 0) > 0 && (watch.revents & (POLLPRI | POLLERR)))
+        {
+            parseMounts();
+        }
+    }
+    overheadEnd(STAGE_PARSE, stage);
+
+    char buf[COLLECTOR_BUFFER];
+    int offset = 0;
+
+    if (mountCount == 0)
+    {
+        offset = snprintf(buf, sizeof(buf), "(no filesystems found in /proc/self/mountinfo)\n");
+        sendMessage(write_pipe, buf, offset);
+        return;
+    }
+
+    offset += snprintf(buf + offset, sizeof(buf) - offset, "MOUNT                     TYPE            SIZE     USED   INODES  TIME TO FULL\n");
+    for (int i = 0; i < mountCount; i++)
+    {
+        struct mount *mount = &mounts[i];
+        if (offset > (int)sizeof(buf) - 512)
+        {
+            offset += snprintf(buf + offset, sizeof(buf) - offset, "... and %d more\n", mountCount - i);
+            break;
+        }
+
+        stage = overheadBegin();
+        struct statvfs space;
+        int result = statvfs(mount->point, &space);
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        overheadEnd(STAGE_READ, stage);
+
+        stage = overheadBegin();
+        if (result != 0 || space.f_blocks == 0)
+        {
+            offset += snprintf(buf + offset, sizeof(buf) - offset, "%-25s %-8s (unavailable)\n", mount->point, mount->type);
+            overheadEnd(STAGE_FORMAT, stage);
+            continue;
+        }
+
+        long long size = (long long)space.f_blocks * space.f_frsize;
+        long long available = (long long)space.f_bavail * space.f_frsize;
+        long long used = (long long)(space.f_blocks - space.f_bfree) * space.f_frsize;
+        float usedShare = used + available > 0 ? (float)used / (used + available) * 100 : 0;
+
+        // the rate the available space went down since the previous sample, averaged with the earlier ones
+        long long time = now.tv_sec * 1000000000LL + now.tv_nsec;
+        if (mount->previousFree >= 0 && time > mount->previousTime)
+        {
+            double rate = (mount->previousFree - available) / ((time - mount->previousTime) / 1e9);
+            mount->fillRate = mount->rated ? FILESYSTEMS_RATE_WEIGHT * rate + (1 - FILESYSTEMS_RATE_WEIGHT) * mount->fillRate : rate;
+            mount->rated = true;
+        }
+        mount->previousFree = available;
+        mount->previousTime = time;
+        overheadEnd(STAGE_COMPUTE, stage);
+
+        stage = overheadBegin();
+        offset += snprintf(buf + offset, sizeof(buf) - offset, "%-25s %-8s %8.1f GB  %5.1f %%  ", mount->point, mount->type, size / 1073741824.0, usedShare);
+        if (space.f_files > 0)
+        {
+            offset += snprintf(buf + offset, sizeof(buf) - offset, "%5.1f %%  ", (float)(space.f_files - space.f_ffree) / space.f_files * 100);
+        }
+        else
+        {
+            // btrfs and some others allocate inodes as they go and report none
+            offset += snprintf(buf + offset, sizeof(buf) - offset, "    -    ");
+        }
+
+        char timeToFull[32] = "-";
+        if (mount->rated && mount->fillRate > 0)
+        {
+            formatTime(timeToFull, sizeof(timeToFull), available / mount->fillRate);
+        }
+        offset += snprintf(buf + offset, sizeof(buf) - offset, graphicOutput() ? "%-12s" : "%s", timeToFull);
+
+        if (graphicOutput())
+        {
+            int bars = (int)(usedShare / 5 + 0.5);
+            offset += snprintf(buf + offset, sizeof(buf) - offset, "  [");
+            for (int bar = 0; bar < 20; bar++)
+            {
+                buf[offset++] = bar < bars ? '#' : '.';
+            }
+            buf[offset++] = ']';
+        }
+        buf[offset++] = '\n';
+        overheadEnd(STAGE_FORMAT, stage);
+    }
+    offset += snprintf(buf + offset, sizeof(buf) - offset, "%d filesystems -- mount table parsed %d times (only when it changed)\n", mountCount, parses);
+
+    stage = overheadBegin();
+    sendMessage(write_pipe, buf, offset);
+    overheadEnd(STAGE_WRITE, stage);
+}
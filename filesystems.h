@@ -0,0 +1,14 @@
+// Author: Kristi Dodaj
+// filesystems.h: Responsible for defining the collector of the space and inodes used on every mounted filesystem (see filesystems.c)
+
+#ifndef FILESYSTEMS
+#define FILESYSTEMS
+
+// how much each new fill rate counts against the earlier ones (an exponential moving average, so one burst does not set the time to full)
+#define FILESYSTEMS_RATE_WEIGHT 0.3
+
+// define the function signatures
+
+void getFilesystemUsage(int write_pipe);
+
+#endif /* FILESYSTEMS */
@@ -0,0 +1,272 @@
+// Author: Kristi Dodaj
+// hugepages.c: Responsible for the optional collector of the huge pages (HugePages_* and AnonHugePages of /proc/meminfo), how often
+// transparent huge pages could be allocated (the thp_* counters of /proc/vmstat) and how fragmented the free memory of every zone
+// is (/proc/buddyinfo). A huge page needs a free block of its own order, so free memory that is only left in small blocks cannot
+// back one however much of it there is. Every file is kept open and read again with one pread() per sample.
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <time.h>
+#include "hugepages.h"
+#include "procfile.h"
+#include "vmstat.h"
+#include "event_loop.h"
+#include "overhead.h"
+#include "stats_functions.h"
+
+// the characters of the fragmentation graphic from no free memory in an order to all of it
+static const char heat[] = " .:-=+*#%@";
+
+enum thpCounter
+{
+    THP_FAULT_ALLOC,
+    THP_FAULT_FALLBACK,
+    THP_COLLAPSE_ALLOC,
+    THP_COLLAPSE_FAILED,
+    THP_SPLIT_PAGE,
+    THP_COUNTER_COUNT
+};
+
+static const char *thpNames[THP_COUNTER_COUNT] = {
+    [THP_FAULT_ALLOC] = "thp_fault_alloc",
+    [THP_FAULT_FALLBACK] = "thp_fault_fallback",
+    [THP_COLLAPSE_ALLOC] = "thp_collapse_alloc",
+    [THP_COLLAPSE_FAILED] = "thp_collapse_alloc_failed",
+    [THP_SPLIT_PAGE] = "thp_split_page",
+};
+
+// the free blocks of one zone of /proc/buddyinfo
+struct zone
+{
+    int node;
+    char name[16];
+    int orders;
+    long long blocks[BUDDY_MAX_ORDERS]; // the free blocks of 2^order pages
+};
+
+// the huge page lines of /proc/meminfo
+struct hugeMemory
+{
+    long long total;
+    long long free;
+    long long reserved;
+    long long surplus;
+    long long pageSize;  // kB
+    long long anonymous; // kB of transparent huge pages mapped by processes
+};
+
+static long long meminfoValue(const char *text, const char *name)
+{
+    // This function returns the value of the line of /proc/meminfo that starts with name, or 0 if it has none
+    const char *line = strstr(text, name);
+    return line != NULL ? strtoll(line + strlen(name), NULL, 10) : 0;
+}
+
+static int parseZones(const char *text, struct zone *zones)
+{
+    // This function reads the free blocks of every zone from buddyinfo and returns the number of zones
+    // buddyinfo: Node 0, zone   Normal   3279   1204    133 ...
+
+    int count = 0;
+    const char *line = text;
+    while (line != NULL && *line != '\0' && count < BUDDY_MAX_ZONES)
+    {
+        struct zone *zone = &zones[count];
+        int read = 0;
+        if (sscanf(line, "Node %d, zone %15s%n", &zone->node, zone->name, &read) == 2)
+        {
+            const char *position = line + read;
+            char *end;
+            zone->orders = 0;
+            while (zone->orders < BUDDY_MAX_ORDERS)
+            {
+                long long blocks = strtoll(position, &end, 10);
+                if (end == position)
+                {
+                    break;
+                }
+                zone->blocks[zone->orders++] = blocks;
+                position = end;
+            }
+            count++;
+        }
+
+        line = strchr(line, '\n');
+        if (line != NULL)
+        {
+            line++;
+        }
+    }
+    return count;
+}
+
+static int thpSetting(char *buf, int size, const char *text)
+{
+    // This function copies the selected value of a transparent_hugepage setting (the one in brackets), or "-" if it cannot be read
+    // Example Output:
+    // thpSetting(buf, size, "always [madvise] never\n") writes "madvise"
+
+    const char *start = text != NULL ? strchr(text, '[') : NULL;
+    const char *end = start != NULL ? strchr(start, ']') : NULL;
+    if (end == NULL)
+    {
+        return snprintf(buf, size, "-");
+    }
+    return snprintf(buf, size, "%.*s", (int)(end - start - 1), start + 1);
+}
+
+void getHugePageUsage(int write_pipe)
+{
+    // This function writes the huge pages reserved for hugetlbfs (total, free, reserved and surplus), the transparent huge pages
+    // mapped by processes with the THP settings, the THP faults that got a huge page and the ones that fell back to small pages per
+    // second, and one line per zone with its free memory, the share of it in blocks large enough for a huge page and the free
+    // blocks of every order. In graphics mode the blocks are drawn as one character per order for the share of the free memory in
+    // it, from ' ' (none) to '@' (all of it) with a | before the huge page order, so a fragmented zone has its weight on the left.
+    // NOTE: A fallback is a page fault that wanted a transparent huge page and got a small page because no free block of the huge
+    // page order was left; the first call shows the averages since boot
+    // Example Output:
+    // getHugePageUsage(write_pipe) writes
+    //
+    // hugetlb      2048 kB pages  total 512  free 128  reserved 64  surplus 0
+    // THP          anonymous 1228.8 MB  enabled madvise  defrag madvise
+    // THP faults   allocated 40.0/s  fell back 12.0/s (23.1 %)  collapsed 0.5/s  failed 0.0/s  split 0.0/s
+    // ZONE              FREE   HUGE-ABLE  FREE BLOCKS BY ORDER (4 kB << order)
+    // 0 Normal      820.3 MB      18.2 %  3279 1204 133 43 27 16 19 14 5 4 34
+
+    static struct procFile meminfo, buddyinfo, enabled, defrag;
+    static struct vmstatMap map;
+    static bool opened = false;
+    static bool vmstatReadable = false;
+    static long long values[THP_COUNTER_COUNT];
+    static long long previous[THP_COUNTER_COUNT];
+    static long long previousTime = 0;
+
+    if (!opened)
+    {
+        procFileOpen(&meminfo, "/proc/meminfo");
+        procFileOpen(&buddyinfo, "/proc/buddyinfo");
+        procFileOpen(&enabled, "/sys/kernel/mm/transparent_hugepage/enabled");
+        procFileOpen(&defrag, "/sys/kernel/mm/transparent_hugepage/defrag");
+        vmstatReadable = vmstatMapOpen(&map, thpNames, THP_COUNTER_COUNT);
+        opened = true;
+    }
+
+    long long stage = overheadBegin();
+    const char *memoryText = procFileRead(&meminfo);
+    const char *buddyText = procFileRead(&buddyinfo);
+    const char *enabledText = procFileRead(&enabled);
+    const char *defragText = procFileRead(&defrag);
+    memcpy(previous, values, sizeof(values));
+    vmstatReadable = vmstatReadable && vmstatMapRead(&map, values);
+
+    // the counters start at boot, so the first sample is the average since boot
+    struct timespec now;
+    clock_gettime(CLOCK_BOOTTIME, &now);
+    long long time = now.tv_sec * 1000000000LL + now.tv_nsec;
+    double seconds = (time - previousTime) / 1e9;
+    previousTime = time;
+    overheadEnd(STAGE_READ, stage);
+
+    char buf[COLLECTOR_BUFFER];
+    int offset = 0;
+
+    if (memoryText == NULL)
+    {
+        offset = snprintf(buf, sizeof(buf), "(/proc/meminfo cannot be read)\n");
+        sendMessage(write_pipe, buf, offset);
+        return;
+    }
+
+    stage = overheadBegin();
+    struct hugeMemory huge = {
+        .total = meminfoValue(memoryText, "HugePages_Total:"),
+        .free = meminfoValue(memoryText, "HugePages_Free:"),
+        .reserved = meminfoValue(memoryText, "HugePages_Rsvd:"),
+        .surplus = meminfoValue(memoryText, "HugePages_Surp:"),
+        .pageSize = meminfoValue(memoryText, "Hugepagesize:"),
+        .anonymous = meminfoValue(memoryText, "AnonHugePages:"),
+    };
+
+    struct zone zones[BUDDY_MAX_ZONES];
+    int zoneCount = buddyText != NULL ? parseZones(buddyText, zones) : 0;
+    overheadEnd(STAGE_PARSE, stage);
+
+    // the order of a huge page: 2 MB pages of 4 kB pages are blocks of 2^9 pages
+    long long pageKb = sysconf(_SC_PAGESIZE) / 1024;
+    int hugeOrder = 0;
+    while (huge.pageSize > 0 && (pageKb << (hugeOrder + 1)) <= huge.pageSize)
+    {
+        hugeOrder++;
+    }
+    hugeOrder = huge.pageSize > 0 ? hugeOrder : 9;
+
+    stage = overheadBegin();
+    char setting[2][32];
+    thpSetting(setting[0], sizeof(setting[0]), enabledText);
+    thpSetting(setting[1], sizeof(setting[1]), defragText);
+    offset += snprintf(buf + offset, sizeof(buf) - offset, "hugetlb      %lld kB pages  total %lld  free %lld  reserved %lld  surplus %lld\n", huge.pageSize, huge.total, huge.free, huge.reserved, huge.surplus);
+    offset += snprintf(buf + offset, sizeof(buf) - offset, "THP          anonymous %.1f MB  enabled %s  defrag %s\n", huge.anonymous / 1024.0, setting[0], setting[1]);
+    if (vmstatReadable && seconds > 0)
+    {
+        double rates[THP_COUNTER_COUNT];
+        for (int i = 0; i < THP_COUNTER_COUNT; i++)
+        {
+            rates[i] = (values[i] - previous[i]) / seconds;
+        }
+        double faults = rates[THP_FAULT_ALLOC] + rates[THP_FAULT_FALLBACK];
+        offset += snprintf(buf + offset, sizeof(buf) - offset, "THP faults   allocated %.1f/s  fell back %.1f/s (%.1f %%)  collapsed %.1f/s  failed %.1f/s  split %.1f/s\n", rates[THP_FAULT_ALLOC], rates[THP_FAULT_FALLBACK], faults > 0 ? rates[THP_FAULT_FALLBACK] / faults * 100 : 0, rates[THP_COLLAPSE_ALLOC], rates[THP_COLLAPSE_FAILED], rates[THP_SPLIT_PAGE]);
+    }
+
+    if (zoneCount > 0)
+    {
+        offset += snprintf(buf + offset, sizeof(buf) - offset, "ZONE              FREE   HUGE-ABLE  FREE BLOCKS BY ORDER (%lld kB << order)\n", pageKb);
+    }
+    for (int i = 0; i < zoneCount; i++)
+    {
+        struct zone *zone = &zones[i];
+        long long pages[BUDDY_MAX_ORDERS];
+        long long freePages = 0, hugePages = 0;
+        for (int order = 0; order < zone->orders; order++)
+        {
+            pages[order] = zone->blocks[order] << order;
+            freePages += pages[order];
+            hugePages += order >= hugeOrder ? pages[order] : 0;
+        }
+
+        char name[32];
+        snprintf(name, sizeof(name), "%d %s", zone->node, zone->name);
+        offset += snprintf(buf + offset, sizeof(buf) - offset, "%-12s %8.1f MB     %5.1f %%  ", name, freePages * pageKb / 1024.0, freePages > 0 ? (float)hugePages / freePages * 100 : 0);
+
+        if (graphicOutput())
+        {
+            // one character per order for its share of the free memory, the orders that can back a huge page after the |
+            buf[offset++] = '[';
+            for (int order = 0; order < zone->orders; order++)
+            {
+                if (order == hugeOrder)
+                {
+                    buf[offset++] = '|';
+                }
+                int level = freePages > 0 ? (int)((double)pages[order] / freePages * (sizeof(heat) - 2) + 0.5) : 0;
+                buf[offset++] = pages[order] > 0 && level == 0 ? heat[1] : heat[level];
+            }
+            buf[offset++] = ']';
+        }
+        else
+        {
+            for (int order = 0; order < zone->orders; order++)
+            {
+                offset += snprintf(buf + offset, sizeof(buf) - offset, order > 0 ? " %lld" : "%lld", zone->blocks[order]);
+            }
+        }
+        buf[offset++] = '\n';
+    }
+    overheadEnd(STAGE_FORMAT, stage);
+
+    stage = overheadBegin();
+    sendMessage(write_pipe, buf, offset);
+    overheadEnd(STAGE_WRITE, stage);
+}
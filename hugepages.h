@@ -0,0 +1,17 @@
+// Author: Kristi Dodaj
+// hugepages.h: Responsible for defining the collector of the huge pages, transparent huge pages and memory fragmentation (see hugepages.c)
+
+#ifndef HUGEPAGES
+#define HUGEPAGES
+
+// the most block orders read of a zone of /proc/buddyinfo (11 unless the kernel was built with a larger MAX_ORDER)
+#define BUDDY_MAX_ORDERS 16
+
+// the most zones shown, over all NUMA nodes
+#define BUDDY_MAX_ZONES 32
+
+// define the function signatures
+
+void getHugePageUsage(int write_pipe);
+
+#endif /* HUGEPAGES */
@@ -0,0 +1,384 @@
+// Author: Kristi Dodaj
+// irq.c: Responsible for the optional collector of the per cpu distribution of softirqs (/proc/softirqs) and hardware interrupts
+// (/proc/interrupts), shown as a heatmap in graphics mode together with the busiest interrupt sources of every cpu
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <time.h>
+#include "irq.h"
+#include "procfile.h"
+#include "event_loop.h"
+#include "overhead.h"
+#include "stats_functions.h"
+
+// the longest row name kept (softirq type, irq number with its device, or the name of a special interrupt)
+#define IRQ_NAME_LENGTH 24
+
+// the number of interrupt sources listed per cpu
+#define IRQ_TOP_SOURCES 3
+
+// one of the two files, a matrix with one row per softirq type or interrupt source and one column per cpu
+struct irqMatrix
+{
+    struct procFile file;
+    int columns;                  // cpus in the header line
+    int rows;
+    int allocatedRows;
+    int *cpuIds;                  // the cpu of each column (offline cpus have no column)
+    char (*names)[IRQ_NAME_LENGTH];
+    long long *current;           // rows * columns counters of the last read
+    long long *previous;          // rows * columns counters of the read before
+    long long *delta;             // rows * columns increase between the two
+    bool primed;                  // previous holds a read with the same shape as current
+};
+
+static struct irqMatrix softirqs = {.file = {.fd = -1}};
+static struct irqMatrix interrupts = {.file = {.fd = -1}};
+static long long previousTime = 0;
+
+// the characters of the heatmap from no activity to the busiest cell
+static const char heat[] = " .:-=+*#%@";
+
+static const char *skipSpaces(const char *position)
+{
+    while (*position == ' ')
+    {
+        position++;
+    }
+    return position;
+}
+
+static const char *scanNumber(const char *position, long long *value)
+{
+    // This function reads the unsigned decimal number at position into value and returns where it stopped. It does not handle
+    // signs, bases or locales, which is all these files need and much cheaper than strtoll on matrices with thousands of cells.
+
+    long long number = 0;
+    while (*position >= '0' && *position <= '9')
+    {
+        number = number * 10 + (*position - '0');
+        position++;
+    }
+    *value = number;
+    return position;
+}
+
+static void resize(struct irqMatrix *matrix, int rows, int columns)
+{
+    // This function makes room for a matrix of the given shape. It only allocates when the shape grows (a driver registered a new
+    // interrupt or a cpu came online), so a steady machine parses into the same buffers every sample.
+
+    if (columns != matrix->columns)
+    {
+        matrix->cpuIds = realloc(matrix->cpuIds, columns * sizeof(int));
+        matrix->allocatedRows = 0; // the cells have to be reallocated for the new width
+    }
+
+    if (rows > matrix->allocatedRows)
+    {
+        int allocated = rows + 8;
+        matrix->names = realloc(matrix->names, allocated * IRQ_NAME_LENGTH);
+        matrix->current = realloc(matrix->current, allocated * columns * sizeof(long long));
+        matrix->previous = realloc(matrix->previous, allocated * columns * sizeof(long long));
+        matrix->delta = realloc(matrix->delta, allocated * columns * sizeof(long long));
+        matrix->allocatedRows = allocated;
+    }
+
+    if (!matrix->cpuIds || !matrix->names || !matrix->current || !matrix->previous || !matrix->delta)
+    {
+        perror("Error allocating memory");
+        exit(EXIT_FAILURE);
+    }
+
+    if (rows != matrix->rows || columns != matrix->columns)
+    {
+        // the previous read has another shape, so there is nothing to compare the next one to
+        matrix->primed = false;
+    }
+    matrix->rows = rows;
+    matrix->columns = columns;
+}
+
+static bool readMatrix(struct irqMatrix *matrix, bool deviceNames)
+{
+    // This function reads the file of the matrix and parses it column by column into the current counters, keeping the last ones
+    // in previous and the difference in delta. With deviceNames the name of a numbered row is the device at the end of its line
+    // (ex. "29 virtio0-input") as in /proc/interrupts. Returns false if the file could not be read.
+    // Example Output:
+    // readMatrix(&softirqs, false) parses "   CPU0  CPU1\n  HI:  0  3\n  TIMER:  14982  9021\n..." into 2 columns
+    // named HI, TIMER, ...
+
+    const char *text = procFileRead(&matrix->file);
+    if (text == NULL)
+    {
+        return false;
+    }
+
+    long long stage = overheadBegin();
+
+    // the header line names the columns, count them and the rows first so the matrix can be sized once
+    const char *body = strchr(text, '\n');
+    if (body == NULL)
+    {
+        overheadEnd(STAGE_PARSE, stage);
+        return false;
+    }
+    body++;
+
+    int columns = 0;
+    for (const char *position = strstr(text, "CPU"); position != NULL && position < body; position = strstr(position + 3, "CPU"))
+    {
+        columns++;
+    }
+    int rows = 0;
+    for (const char *position = body; *position != '\0'; position++)
+    {
+        rows += *position == '\n';
+    }
+
+    // keep the counters of the previous read
+    long long *swap = matrix->previous;
+    matrix->previous = matrix->current;
+    matrix->current = swap;
+
+    resize(matrix, rows, columns);
+
+    int column = 0;
+    for (const char *position = strstr(text, "CPU"); position != NULL && position < body && column < columns; position = strstr(position + 3, "CPU"))
+    {
+        matrix->cpuIds[column++] = atoi(position + 3);
+    }
+
+    // every row is "NAME: count count ... [description]", a row may have fewer counts than there are cpus (ex. ERR:)
+    const char *line = body;
+    for (int row = 0; row < rows; row++)
+    {
+        const char *position = skipSpaces(line);
+        const char *colon = strchr(position, ':');
+        const char *end = strchr(position, '\n');
+        if (colon == NULL || end == NULL || colon > end)
+        {
+            matrix->rows = row;
+            break;
+        }
+
+        int nameLength = colon - position < IRQ_NAME_LENGTH - 1 ? colon - position : IRQ_NAME_LENGTH - 1;
+        memcpy(matrix->names[row], position, nameLength);
+        matrix->names[row][nameLength] = '\0';
+
+        long long *cells = &matrix->current[row * columns];
+        position = colon + 1;
+        for (column = 0; column < columns; column++)
+        {
+            position = skipSpaces(position);
+            if (*position < '0' || *position > '9')
+            {
+                break;
+            }
+            position = scanNumber(position, &cells[column]);
+        }
+        for (; column < columns; column++)
+        {
+            cells[column] = 0;
+        }
+
+        if (deviceNames && matrix->names[row][0] >= '0' && matrix->names[row][0] <= '9')
+        {
+            // the device is the last word of the description
+            const char *device = end;
+            while (device > position && device[-1] != ' ')
+            {
+                device--;
+            }
+            int length = strlen(matrix->names[row]);
+            snprintf(matrix->names[row] + length, IRQ_NAME_LENGTH - length, " %.*s", (int)(end - device), device);
+        }
+
+        line = end + 1;
+    }
+
+    for (int cell = 0; cell < matrix->rows * columns; cell++)
+    {
+        matrix->delta[cell] = matrix->primed ? matrix->current[cell] - matrix->previous[cell] : 0;
+    }
+    bool compared = matrix->primed;
+    matrix->primed = true;
+
+    overheadEnd(STAGE_PARSE, stage);
+    return compared;
+}
+
+static int printHeatmap(char *buf, int size, struct irqMatrix *matrix)
+{
+    // This function writes one line per softirq type with one character per cpu, from ' ' (nothing) to '@' (the busiest cell)
+    // Example Output:
+    // printHeatmap(buf, size, &softirqs) writes (4 cpus)
+    //
+    //            0123
+    //     TIMER  ::::
+    //    NET_RX  @. .
+
+    long long busiest = 0;
+    for (int cell = 0; cell < matrix->rows * matrix->columns; cell++)
+    {
+        if (matrix->delta[cell] > busiest)
+        {
+            busiest = matrix->delta[cell];
+        }
+    }
+
+    int offset = snprintf(buf, size, "%10s  ", "");
+    for (int column = 0; column < matrix->columns && offset < size - 2; column++)
+    {
+        buf[offset++] = '0' + matrix->cpuIds[column] % 10;
+    }
+    buf[offset++] = '\n';
+
+    for (int row = 0; row < matrix->rows && offset < size - matrix->columns - 32; row++)
+    {
+        offset += snprintf(buf + offset, size - offset, "%10s  ", matrix->names[row]);
+        for (int column = 0; column < matrix->columns; column++)
+        {
+            long long delta = matrix->delta[row * matrix->columns + column];
+            int level = busiest > 0 ? (int)((double)delta / busiest * (sizeof(heat) - 2) + 0.5) : 0;
+            buf[offset++] = delta > 0 && level == 0 ? heat[1] : heat[level];
+        }
+        buf[offset++] = '\n';
+    }
+
+    return offset;
+}
+
+void getIrqDistribution(int write_pipe)
+{
+    // This function writes the softirqs and interrupts per second of every cpu since the previous call to the write_pipe, with the
+    // busiest softirq type and the IRQ_TOP_SOURCES busiest interrupt sources of each cpu. In graphics mode it also writes a heatmap
+    // of the softirqs (one row per type, one column per cpu). Both files are read through a persistent fd into preallocated
+    // matrices (see procfile.c).
+    // NOTE: When only one of the files can be opened (ex. a container that hides /proc/interrupts), the other one is shown alone
+    // Example Output:
+    // getIrqDistribution(write_pipe) writes
+    //
+    // cpu0   softirq   2210/s (NET_RX 71 %)  irq   1480/s  top: 29 virtio0-input 900/s, LOC 520/s, 30 virtio0-output 40/s
+    // cpu1   softirq     95/s (TIMER 88 %)   irq    210/s  top: LOC 205/s, CAL 5/s
+
+    if (softirqs.file.buffer == NULL)
+    {
+        procFileOpen(&softirqs.file, "/proc/softirqs");
+        procFileOpen(&interrupts.file, "/proc/interrupts");
+    }
+
+    // a file that cannot be opened is left out, the other one is still shown
+    bool compared = true;
+    if (softirqs.file.fd != -1)
+    {
+        compared = readMatrix(&softirqs, false) && compared;
+    }
+    if (interrupts.file.fd != -1)
+    {
+        compared = readMatrix(&interrupts, true) && compared;
+    }
+
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    long long time = now.tv_sec * 1000000000LL + now.tv_nsec;
+    double seconds = (time - previousTime) / 1e9;
+    previousTime = time;
+
+    char buf[COLLECTOR_BUFFER];
+    int offset = 0;
+
+    if (softirqs.file.fd == -1 && interrupts.file.fd == -1)
+    {
+        offset = snprintf(buf, sizeof(buf), "/proc/softirqs and /proc/interrupts are unavailable\n");
+        sendMessage(write_pipe, buf, offset);
+        return;
+    }
+    if (!compared)
+    {
+        offset = snprintf(buf, sizeof(buf), "(measuring)\n");
+        sendMessage(write_pipe, buf, offset);
+        return;
+    }
+
+    long long stage = overheadBegin();
+    const struct irqMatrix *cpus = softirqs.file.fd != -1 ? &softirqs : &interrupts;
+    for (int column = 0; column < cpus->columns && offset < (int)sizeof(buf) - 512; column++)
+    {
+        offset += snprintf(buf + offset, sizeof(buf) - offset, "cpu%-3d", cpus->cpuIds[column]);
+
+        // the busiest softirq type of the cpu
+        if (softirqs.file.fd != -1)
+        {
+            long long softirqTotal = 0, busiest = 0;
+            int busiestRow = 0;
+            for (int row = 0; row < softirqs.rows; row++)
+            {
+                long long delta = softirqs.delta[row * softirqs.columns + column];
+                softirqTotal += delta;
+                if (delta > busiest)
+                {
+                    busiest = delta;
+                    busiestRow = row;
+                }
+            }
+
+            offset += snprintf(buf + offset, sizeof(buf) - offset, " softirq %6.0f/s", softirqTotal / seconds);
+            if (busiest > 0)
+            {
+                offset += snprintf(buf + offset, sizeof(buf) - offset, " (%s %.0f %%)", softirqs.names[busiestRow], (double)busiest / softirqTotal * 100);
+            }
+        }
+
+        // the busiest interrupt sources of the same cpu (the columns of both files follow the online cpus in the same order)
+        if (interrupts.file.fd != -1 && column < interrupts.columns)
+        {
+            int top[IRQ_TOP_SOURCES];
+            int found = 0;
+            long long irqTotal = 0;
+            for (int row = 0; row < interrupts.rows; row++)
+            {
+                long long delta = interrupts.delta[row * interrupts.columns + column];
+                irqTotal += delta;
+                if (delta == 0)
+                {
+                    continue;
+                }
+
+                // keep the few busiest sorted, a full sort of every source is not needed
+                int position = found < IRQ_TOP_SOURCES ? found++ : IRQ_TOP_SOURCES;
+                while (position > 0 && interrupts.delta[top[position - 1] * interrupts.columns + column] < delta)
+                {
+                    if (position < IRQ_TOP_SOURCES)
+                    {
+                        top[position] = top[position - 1];
+                    }
+                    position--;
+                }
+                if (position < IRQ_TOP_SOURCES)
+                {
+                    top[position] = row;
+                }
+            }
+
+            offset += snprintf(buf + offset, sizeof(buf) - offset, "  irq %6.0f/s", irqTotal / seconds);
+            for (int i = 0; i < found; i++)
+            {
+                offset += snprintf(buf + offset, sizeof(buf) - offset, "%s%s %.0f/s", i == 0 ? "  top: " : ", ", interrupts.names[top[i]], interrupts.delta[top[i] * interrupts.columns + column] / seconds);
+            }
+        }
+        buf[offset++] = '\n';
+    }
+
+    if (graphicOutput() && softirqs.file.fd != -1)
+    {
+        offset += printHeatmap(buf + offset, sizeof(buf) - offset, &softirqs);
+    }
+    overheadEnd(STAGE_FORMAT, stage);
+
+    stage = overheadBegin();
+    sendMessage(write_pipe, buf, offset);
+    overheadEnd(STAGE_WRITE, stage);
+}
@@ -0,0 +1,11 @@
+// Author: Kristi Dodaj
+// irq.h: Responsible for defining the per cpu softirq and interrupt collector (see irq.c)
+
+#ifndef IRQ
+#define IRQ
+
+// define the function signatures
+
+void getIrqDistribution(int write_pipe);
+
+#endif /* IRQ */
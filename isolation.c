@@ -0,0 +1,241 @@
+// Author: Kristi Dodaj
+// isolation.c: Responsible for the --pin, --idle, --nice and --mlock settings that keep the monitor from perturbing the workload it
+// measures: pinning it to housekeeping cpus, running it at the lowest cpu priority, and locking and pre-faulting its memory so the
+// samples cause no page faults. Each setting is applied once before the collectors are forked and reported in the header.
+
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <sched.h>
+#include <malloc.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include "isolation.h"
+#include "topology.h"
+
+// one setting, what was asked for and whether it could be applied
+struct setting
+{
+    bool requested;
+    bool applied;
+    int error; // errno of the failure when it was not applied
+};
+
+static struct setting pin, idle, niceness, lock;
+
+static char pinList[64];
+static cpu_set_t pinSet;
+static int niceLevel = 0;
+
+static void markPinned(int cpu, int value)
+{
+    if (cpu < CPU_SETSIZE)
+    {
+        CPU_SET(cpu, &pinSet);
+    }
+}
+
+static bool validRanges(const char *list)
+{
+    // This function returns false if a cpu of the list is at or above CPU_SETSIZE or a range ends before it starts, so
+    // parseCpuList() is never given a range it would walk for billions of cpus
+    // Example Output:
+    // validRanges("0-2147483647") returns false
+
+    const char *position = list;
+    while (*position != '\0')
+    {
+        char *end;
+        long first = strtol(position, &end, 10);
+        if (end == position || first >= CPU_SETSIZE)
+        {
+            return false;
+        }
+
+        long last = first;
+        if (*end == '-')
+        {
+            position = end + 1;
+            last = strtol(position, &end, 10);
+            if (end == position || last >= CPU_SETSIZE || last < first)
+            {
+                return false;
+            }
+        }
+
+        if (*end != ',' && *end != '\0')
+        {
+            return false;
+        }
+        position = *end == ',' ? end + 1 : end;
+    }
+    return true;
+}
+
+bool isolationFlag(const char *argument)
+{
+    // This function returns true if the argument is one of the isolation flags (whether or not its value is valid)
+    // Example Output:
+    // isolationFlag("--pin=0-1") returns true
+    return strncmp(argument, "--pin=", 6) == 0 || strcmp(argument, "--idle") == 0 || strncmp(argument, "--nice=", 7) == 0 || strcmp(argument, "--mlock") == 0;
+}
+
+bool isolationRequest(const char *argument)
+{
+    // This function records an isolation flag to be applied by isolationApply() and returns false (after printing why) if its
+    // value is invalid or it was already given
+    // Example Output:
+    // isolationRequest("--pin=0-1,4") returns true and the monitor will run on cpus 0, 1 and 4 only
+    // isolationRequest("--nice=25") returns false and prints: INVALID --nice (-20 TO 19). TRY AGAIN!
+
+    struct setting *setting = strncmp(argument, "--pin=", 6) == 0 ? &pin : strcmp(argument, "--idle") == 0 ? &idle : strncmp(argument, "--nice=", 7) == 0 ? &niceness : &lock;
+    if (setting->requested)
+    {
+        printf("REPEATED ARGUMENTS. TRY AGAIN!\n");
+        return false;
+    }
+    setting->requested = true;
+
+    if (setting == &pin)
+    {
+        // a cpu list like the ones in /sys/devices/system/cpu (ex. 0-1,4)
+        const char *list = argument + 6;
+        CPU_ZERO(&pinSet);
+        if (*list == '\0' || strspn(list, "0123456789,-") != strlen(list) || strlen(list) >= sizeof(pinList) || !validRanges(list) || parseCpuList(list, markPinned, 1) == 0 || CPU_COUNT(&pinSet) == 0)
+        {
+            printf("INVALID --pin (ex. --pin=0-1,4). TRY AGAIN!\n");
+            return false;
+        }
+        strcpy(pinList, list);
+    }
+    else if (setting == &niceness)
+    {
+        char extra;
+        if (sscanf(argument + 7, "%d%c", &niceLevel, &extra) != 1 || niceLevel < -20 || niceLevel > 19)
+        {
+            printf("INVALID --nice (-20 TO 19). TRY AGAIN!\n");
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static void prefault()
+{
+    // This function touches the stack and a block of heap once so the pages the samples use are faulted in (and locked) now.
+    // NOTE: The heap is never trimmed or served by mmap() afterwards, so freed memory stays in the already locked heap and the
+    // allocations of a sample reuse it instead of faulting in new pages
+
+    volatile char stack[ISOLATION_STACK_RESERVE];
+    memset((char *)stack, 0, sizeof(stack));
+
+    mallopt(M_TRIM_THRESHOLD, -1);
+    mallopt(M_MMAP_MAX, 0);
+
+    char *heap = malloc(ISOLATION_HEAP_RESERVE);
+    if (heap != NULL)
+    {
+        memset(heap, 0, ISOLATION_HEAP_RESERVE);
+        free(heap);
+    }
+}
+
+void isolationApply()
+{
+    // This function applies the requested settings to the monitor. It is called before the collectors are forked, so the cpu
+    // affinity, the scheduling policy and the nice level are inherited by every collector; a setting that fails (ex. --nice=-5
+    // without the privilege) is reported in the header instead of stopping the monitor.
+    // Example Output:
+    // with --pin=0 --idle isolationApply() moves the monitor to cpu 0 under SCHED_IDLE
+
+    if (pin.requested)
+    {
+        pin.applied = sched_setaffinity(0, sizeof(pinSet), &pinSet) == 0;
+        pin.error = errno;
+    }
+    if (idle.requested)
+    {
+        struct sched_param parameters = {.sched_priority = 0};
+        idle.applied = sched_setscheduler(0, SCHED_IDLE, &parameters) == 0;
+        idle.error = errno;
+    }
+    if (niceness.requested)
+    {
+        niceness.applied = setpriority(PRIO_PROCESS, 0, niceLevel) == 0;
+        niceness.error = errno;
+    }
+    if (lock.requested)
+    {
+        // MCL_FUTURE also locks (and faults in) every mapping made later, ex. when the heap grows
+        lock.applied = mlockall(MCL_CURRENT | MCL_FUTURE) == 0;
+        lock.error = errno;
+        prefault();
+    }
+}
+
+void isolationChild()
+{
+    // This function is called by every forked collector. Memory locks are not inherited across fork(), so a collector locks and
+    // pre-faults its own memory; the other settings are inherited from the monitor.
+
+    if (lock.requested && lock.applied)
+    {
+        mlockall(MCL_CURRENT | MCL_FUTURE);
+        prefault();
+    }
+}
+
+static void printSetting(FILE *out, const char *name, const struct setting *setting)
+{
+    // This function prints one setting of the isolation line of the header
+    if (setting->applied)
+    {
+        fprintf(out, "  %s (applied)", name);
+    }
+    else
+    {
+        fprintf(out, "  %s (FAILED: %s)", name, strerror(setting->error));
+    }
+}
+
+int isolationPrint(FILE *out)
+{
+    // This function prints the isolation line of the header when any setting was requested and returns how many lines it printed
+    // Example Output:
+    // isolationPrint(stdout) prints and returns 1
+    //
+    // Isolation:  pinned to cpus 0-1 (applied)  SCHED_IDLE (applied)  mlock (FAILED: Cannot allocate memory)
+
+    if (!pin.requested && !idle.requested && !niceness.requested && !lock.requested)
+    {
+        return 0;
+    }
+
+    fprintf(out, "Isolation:");
+    if (pin.requested)
+    {
+        char name[96];
+        snprintf(name, sizeof(name), "pinned to cpus %s", pinList);
+        printSetting(out, name, &pin);
+    }
+    if (idle.requested)
+    {
+        printSetting(out, "SCHED_IDLE", &idle);
+    }
+    if (niceness.requested)
+    {
+        char name[32];
+        snprintf(name, sizeof(name), "nice %d", niceLevel);
+        printSetting(out, name, &niceness);
+    }
+    if (lock.requested)
+    {
+        printSetting(out, "mlock", &lock);
+    }
+    fprintf(out, "\n");
+
+    return 1;
+}
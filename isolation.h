@@ -0,0 +1,24 @@
+// Author: Kristi Dodaj
+// isolation.h: Responsible for defining the settings that keep the monitor out of the way of the workload it measures (see isolation.c)
+
+#include <stdio.h>
+#include <stdbool.h>
+
+#ifndef ISOLATION
+#define ISOLATION
+
+// the heap that --mlock touches at startup so the samples reuse locked, already faulted memory instead of growing the heap
+#define ISOLATION_HEAP_RESERVE (8 * 1024 * 1024)
+
+// the stack that --mlock touches at startup
+#define ISOLATION_STACK_RESERVE (256 * 1024)
+
+// define the function signatures
+
+bool isolationFlag(const char *argument);
+bool isolationRequest(const char *argument);
+void isolationApply();
+void isolationChild();
+int isolationPrint(FILE *out);
+
+#endif /* ISOLATION */
@@ -0,0 +1,325 @@
+// Author: Kristi Dodaj
+// libmonitor.c: Responsible for sampling the cpu usage, memory usage and user sessions into a caller-owned snapshot. It never
+// prints, forks or installs a signal handler, errors are returned (with errno set) so it can run inside any process at any rate.
+
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <utmpx.h>
+#include <sys/sysinfo.h>
+#include "libmonitor.h"
+
+// the counters of /proc/stat, all taken from the same read
+struct procStat
+{
+    long long user, nice, system, idle, iowait, irq, softirq, steal; // jiffies of the "cpu" line (guest time is already in user)
+    long long contextSwitches;                                        // ctxt
+    long long interrupts;                                             // first number of intr (the total)
+    long long forks;                                                  // processes
+    long long running;                                                // procs_running
+    long long blocked;                                                // procs_blocked
+};
+
+struct monitor
+{
+    int sections;
+    int statFd;             // /proc/stat, kept open and read again from offset 0
+    char *statBuffer;
+    int statSize;
+    struct procStat previous;
+    long long previousTime; // CLOCK_BOOTTIME nanoseconds of the previous cpu sample (0 before the first)
+};
+
+static void parseProcStat(const char *text, struct procStat *stat)
+{
+    // This function fills stat from the text of /proc/stat in a single pass. Only the first character of a line is compared before
+    // the line is either used or skipped, so the per cpu lines and the long intr line cost a jump to the next newline.
+    // Example Output:
+    // parseProcStat("cpu  3663 0 1220 89704 101 0 3 33 0 0\nctxt 174994\n...", &stat) sets stat.user = 3663, stat.steal = 33,
+    // stat.contextSwitches = 174994, ...
+
+    memset(stat, 0, sizeof(*stat));
+    const char *line = text;
+
+    while (line != NULL && *line != '\0')
+    {
+        char *end;
+        switch (*line)
+        {
+        case 'c':
+            if (strncmp(line, "cpu ", 4) == 0)
+            {
+                long long *fields[8] = {&stat->user, &stat->nice, &stat->system, &stat->idle, &stat->iowait, &stat->irq, &stat->softirq, &stat->steal};
+                const char *position = line + 4;
+                for (int i = 0; i < 8; i++)
+                {
+                    *fields[i] = strtoll(position, &end, 10);
+                    position = end;
+                }
+            }
+            else if (strncmp(line, "ctxt ", 5) == 0)
+            {
+                stat->contextSwitches = strtoll(line + 5, NULL, 10);
+            }
+            break;
+        case 'i':
+            if (strncmp(line, "intr ", 5) == 0)
+            {
+                stat->interrupts = strtoll(line + 5, NULL, 10);
+            }
+            break;
+        case 'p':
+            if (strncmp(line, "processes ", 10) == 0)
+            {
+                stat->forks = strtoll(line + 10, NULL, 10);
+            }
+            else if (strncmp(line, "procs_running ", 14) == 0)
+            {
+                stat->running = strtoll(line + 14, NULL, 10);
+            }
+            else if (strncmp(line, "procs_blocked ", 14) == 0)
+            {
+                stat->blocked = strtoll(line + 14, NULL, 10);
+            }
+            break;
+        }
+
+        line = strchr(line, '\n');
+        if (line != NULL)
+        {
+            line++;
+        }
+    }
+}
+
+static int sampleCpu(struct monitor *handle, struct monitorSnapshot *snapshot)
+{
+    // This function compares the current /proc/stat with the one of the previous sample and fills the cpu part of the snapshot
+    // FORMULA FOR CALCULATION: (U2-U1/T2-T1) * 100 WHERE T IS TOTAL TIME AND U IS TOTAL TIME WITHOUT IDLE TIME
+    // NOTE: Steal time (time a VM was ready to run but the hypervisor ran something else) counts as busy time in T and U
+    // Example Output:
+    // sampleCpu(handle, snapshot) returns 0 and sets snapshot->cpuUsage = 1.17, snapshot->steal = 0.05, ...
+
+    // read the whole file, growing the buffer until it fits
+    ssize_t length;
+    while ((length = pread(handle->statFd, handle->statBuffer, handle->statSize - 1, 0)) == handle->statSize - 1)
+    {
+        char *larger = realloc(handle->statBuffer, handle->statSize * 2);
+        if (!larger)
+        {
+            return -1;
+        }
+        handle->statBuffer = larger;
+        handle->statSize *= 2;
+    }
+    if (length < 0)
+    {
+        return -1;
+    }
+    handle->statBuffer[length] = '\0';
+
+    struct procStat current;
+    parseProcStat(handle->statBuffer, &current);
+    struct procStat *previous = &handle->previous;
+
+    struct timespec now;
+    clock_gettime(CLOCK_BOOTTIME, &now);
+    long long time = now.tv_sec * 1000000000LL + now.tv_nsec;
+    double seconds = (time - handle->previousTime) / 1e9; // the whole uptime on the first sample
+
+    long long T1 = previous->user + previous->nice + previous->system + previous->idle + previous->iowait + previous->irq + previous->softirq + previous->steal;
+    long long T2 = current.user + current.nice + current.system + current.idle + current.iowait + current.irq + current.softirq + current.steal;
+    long long U1 = T1 - previous->idle;
+    long long U2 = T2 - current.idle;
+
+    snapshot->cpuUsage = snapshot->user = snapshot->system = snapshot->iowait = snapshot->steal = snapshot->irq = snapshot->softirq = 0;
+    if (T2 != T1)
+    {
+        float total = T2 - T1;
+        snapshot->cpuUsage = (U2 - U1) / total * 100;
+        snapshot->user = (current.user + current.nice - previous->user - previous->nice) / total * 100;
+        snapshot->system = (current.system - previous->system) / total * 100;
+        snapshot->iowait = (current.iowait - previous->iowait) / total * 100;
+        snapshot->steal = (current.steal - previous->steal) / total * 100;
+        snapshot->irq = (current.irq - previous->irq) / total * 100;
+        snapshot->softirq = (current.softirq - previous->softirq) / total * 100;
+    }
+
+    snapshot->contextSwitches = seconds > 0 ? (current.contextSwitches - previous->contextSwitches) / seconds : 0;
+    snapshot->interrupts = seconds > 0 ? (current.interrupts - previous->interrupts) / seconds : 0;
+    snapshot->forks = seconds > 0 ? (current.forks - previous->forks) / seconds : 0;
+    snapshot->running = current.running;
+    snapshot->blocked = current.blocked;
+
+    handle->previous = current;
+    handle->previousTime = time;
+    return 0;
+}
+
+static int sampleMemory(struct monitorSnapshot *snapshot)
+{
+    // This function fills the memory part of the snapshot using the <sys/sysinfo.h> C library (1 GB = 1024^3 bytes)
+    // Example Output:
+    // sampleMemory(snapshot) returns 0 and sets snapshot->memoryUsed = 7.18, snapshot->memoryTotal = 7.77, ...
+
+    struct sysinfo info;
+    if (sysinfo(&info) == -1)
+    {
+        return -1;
+    }
+
+    // total virtual RAM = physical memory + swap memory
+    double unit = (double)info.mem_unit / 1073741824;
+    snapshot->memoryTotal = info.totalram * unit;
+    snapshot->memoryUsed = (info.totalram - info.freeram) * unit;
+    snapshot->virtualTotal = (info.totalram + info.totalswap) * unit;
+    snapshot->virtualUsed = (info.totalram + info.totalswap - info.freeram - info.freeswap) * unit;
+    return 0;
+}
+
+static int sampleUsers(struct monitorSnapshot *snapshot)
+{
+    // This function fills the users part of the snapshot from the utmp user log file using the <utmpx.h> C library
+    // NOTE: The utmpx functions keep their position in a global, so two threads must not sample users at the same time
+    // Example Output:
+    // sampleUsers(snapshot) returns 0 and sets snapshot->userCount = 2, snapshot->users[0].user = "dodajkri", ...
+
+    struct utmpx *entry;
+    snapshot->userCount = 0;
+
+    setutxent();
+    while ((entry = getutxent()) != NULL)
+    {
+        // validate that this is a user process
+        if (entry->ut_type != USER_PROCESS)
+        {
+            continue;
+        }
+
+        if (snapshot->userCount < MONITOR_MAX_USERS)
+        {
+            struct monitorUser *user = &snapshot->users[snapshot->userCount];
+            snprintf(user->user, sizeof(user->user), "%.*s", (int)sizeof(entry->ut_user), entry->ut_user);
+            snprintf(user->line, sizeof(user->line), "%.*s", (int)sizeof(entry->ut_line), entry->ut_line);
+            snprintf(user->host, sizeof(user->host), "%.*s", (int)sizeof(entry->ut_host), entry->ut_host);
+        }
+        snapshot->userCount++;
+    }
+    endutxent();
+
+    return 0;
+}
+
+struct monitor *monitor_open(const struct monitorConfig *config)
+{
+    // This function creates a handle that samples the given sections and opens the files it keeps between samples. It returns NULL
+    // (with errno set) if they cannot be opened.
+    // Example Output:
+    // monitor_open(&(struct monitorConfig){.sections = MONITOR_CPU | MONITOR_MEMORY}) returns a new handle
+
+    struct monitor *handle = calloc(1, sizeof(struct monitor));
+    if (!handle)
+    {
+        return NULL;
+    }
+
+    handle->sections = config->sections;
+    handle->statFd = -1;
+
+    if (handle->sections & MONITOR_CPU)
+    {
+        handle->statSize = 4096;
+        handle->statBuffer = malloc(handle->statSize);
+        handle->statFd = open("/proc/stat", O_RDONLY | O_CLOEXEC);
+        if (!handle->statBuffer || handle->statFd == -1)
+        {
+            int error = errno;
+            monitor_close(handle);
+            errno = error;
+            return NULL;
+        }
+    }
+
+    return handle;
+}
+
+int monitor_sample(struct monitor *handle, struct monitorSnapshot *snapshot)
+{
+    // This function fills the snapshot with one sample of every section of the handle. It returns 0, or -1 (with errno set) if a
+    // section could not be sampled, in which case that section is missing from snapshot->sections and the others are still filled.
+    // NOTE: The cpu shares and rates are measured since the previous call on the same handle (since boot on the first call)
+    // Example Output:
+    // monitor_sample(handle, &snapshot) returns 0 and sets snapshot.sections = MONITOR_CPU | MONITOR_MEMORY, snapshot.cpuUsage = 1.17, ...
+
+    int result = 0;
+    int error = 0;
+
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    snapshot->timestamp = now.tv_sec + now.tv_nsec / 1e9;
+    snapshot->sections = 0;
+
+    if (handle->sections & MONITOR_CPU)
+    {
+        if (sampleCpu(handle, snapshot) == 0)
+        {
+            snapshot->sections |= MONITOR_CPU;
+        }
+        else
+        {
+            result = -1;
+            error = errno;
+        }
+    }
+    if (handle->sections & MONITOR_MEMORY)
+    {
+        if (sampleMemory(snapshot) == 0)
+        {
+            snapshot->sections |= MONITOR_MEMORY;
+        }
+        else
+        {
+            result = -1;
+            error = errno;
+        }
+    }
+    if (handle->sections & MONITOR_USERS)
+    {
+        if (sampleUsers(snapshot) == 0)
+        {
+            snapshot->sections |= MONITOR_USERS;
+        }
+        else
+        {
+            result = -1;
+            error = errno;
+        }
+    }
+
+    if (result == -1)
+    {
+        errno = error;
+    }
+    return result;
+}
+
+void monitor_close(struct monitor *handle)
+{
+    // This function closes the files of the handle and frees it
+
+    if (handle == NULL)
+    {
+        return;
+    }
+    if (handle->statFd != -1)
+    {
+        close(handle->statFd);
+    }
+    free(handle->statBuffer);
+    free(handle);
+}
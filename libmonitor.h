@@ -0,0 +1,70 @@
+// Author: Kristi Dodaj
+// libmonitor.h: Responsible for defining the embeddable sampling library (see libmonitor.c). A program links libmonitor.a or
+// libmonitor.so, opens a handle once and fills its own snapshot as often as it likes, without any output, fork or signal handler.
+
+#ifndef LIBMONITOR
+#define LIBMONITOR
+
+// the sections a handle samples (combined with |)
+#define MONITOR_CPU 1
+#define MONITOR_MEMORY 2
+#define MONITOR_USERS 4
+
+// the most user sessions a snapshot lists (userCount still counts all of them)
+#define MONITOR_MAX_USERS 64
+
+// what monitor_open() is asked to sample
+struct monitorConfig
+{
+    int sections;
+};
+
+// one user session from utmp
+struct monitorUser
+{
+    char user[33];
+    char line[33];
+    char host[257];
+};
+
+// everything one call of monitor_sample() fills in, owned by the caller
+struct monitorSnapshot
+{
+    double timestamp; // CLOCK_REALTIME seconds of the sample
+    int sections;     // the sections that were filled in (a section that failed is left out)
+
+    // MONITOR_CPU: shares of the total cpu time since the previous sample (since boot on the first one) in %
+    float cpuUsage;
+    float user;
+    float system;
+    float iowait;
+    float steal;
+    float irq;
+    float softirq;
+    double contextSwitches; // per second
+    double interrupts;      // per second
+    double forks;           // per second
+    long long running;      // runnable tasks right now
+    long long blocked;      // tasks blocked on I/O right now
+
+    // MONITOR_MEMORY: in GB (1 GB = 1024^3 bytes), virtual is physical memory plus swap
+    float memoryUsed;
+    float memoryTotal;
+    float virtualUsed;
+    float virtualTotal;
+
+    // MONITOR_USERS
+    int userCount;
+    struct monitorUser users[MONITOR_MAX_USERS];
+};
+
+// a handle keeps its open files and the previous sample, its layout is private to the library
+struct monitor;
+
+// define the function signatures
+
+struct monitor *monitor_open(const struct monitorConfig *config);
+int monitor_sample(struct monitor *handle, struct monitorSnapshot *snapshot);
+void monitor_close(struct monitor *handle);
+
+#endif /* LIBMONITOR */
@@ -0,0 +1,180 @@
+// Author: Kristi Dodaj
+// loadavg.c: Responsible for the optional collector of the load average, the runnable and blocked tasks and the fork rate, each
+// drawn as a sparkline of unicode blocks over the last LOAD_HISTORY samples. The values and their blocks are kept in fixed circular
+// buffers: a sample writes the block of its own value only, and a whole line is drawn again only when its scale changes.
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include "loadavg.h"
+#include "procfile.h"
+#include "libmonitor.h"
+#include "event_loop.h"
+#include "overhead.h"
+#include "stats_functions.h"
+
+// the eight heights of a sparkline, each 3 bytes of UTF-8
+static const char blocks[8][4] = {"▁", "▂", "▃", "▄", "▅", "▆", "▇", "█"};
+
+// one series and the sparkline drawn from it
+struct sparkline
+{
+    float values[LOAD_HISTORY];   // circular, in the same positions as glyphs
+    char glyphs[LOAD_HISTORY * 3]; // the block of every value at the current scale
+    float scale;                  // the value drawn as a full block (the largest of the window, at least minimum)
+    float minimum;                // so a quiet series is drawn low instead of scaled up to full blocks
+};
+
+enum series
+{
+    LOAD,
+    RUNNING,
+    BLOCKED,
+    FORKS,
+    SERIES_COUNT
+};
+
+static struct sparkline lines[SERIES_COUNT];
+static int next = 0;  // the position the next sample is written to (the oldest once the buffers are full)
+static int count = 0; // the samples in the buffers
+static long redraws = 0; // the lines drawn again in full since the start
+
+static void drawGlyph(struct sparkline *line, int position)
+{
+    // This function writes the block of one value at the scale of its line
+    int height = line->scale > 0 ? (int)(line->values[position] / line->scale * 7 + 0.5) : 0;
+    height = height < 0 ? 0 : (height > 7 ? 7 : height);
+    memcpy(&line->glyphs[position * 3], blocks[height], 3);
+}
+
+static void push(struct sparkline *line, float value)
+{
+    // This function adds a value at position next. Only its own block is drawn unless the scale changed: the value is the new
+    // largest, or the largest dropped out of the window, then the whole line is drawn again.
+
+    float dropped = count == LOAD_HISTORY ? line->values[next] : 0;
+    line->values[next] = value;
+
+    float scale = line->scale;
+    if (value > scale)
+    {
+        scale = value;
+    }
+    else if (dropped >= scale && scale > line->minimum)
+    {
+        scale = line->minimum;
+        int filled = count < LOAD_HISTORY ? count + 1 : LOAD_HISTORY;
+        for (int i = 0; i < filled; i++)
+        {
+            scale = line->values[i] > scale ? line->values[i] : scale;
+        }
+    }
+
+    if (scale != line->scale)
+    {
+        line->scale = scale;
+        int filled = count < LOAD_HISTORY ? count + 1 : LOAD_HISTORY;
+        for (int i = 0; i < filled; i++)
+        {
+            drawGlyph(line, i);
+        }
+        redraws++;
+    }
+    else
+    {
+        drawGlyph(line, next);
+    }
+}
+
+static int copyLine(char *buf, const struct sparkline *line)
+{
+    // This function copies the blocks of a line into buf from the oldest to the newest and returns the bytes written
+    int oldest = count < LOAD_HISTORY ? 0 : next;
+    int tail = (count < LOAD_HISTORY ? count : LOAD_HISTORY - oldest) * 3;
+    memcpy(buf, &line->glyphs[oldest * 3], tail);
+    memcpy(buf + tail, line->glyphs, oldest * 3);
+    return (count < LOAD_HISTORY ? count : LOAD_HISTORY) * 3;
+}
+
+void getLoadSparklines(int write_pipe)
+{
+    // This function writes the 1, 5 and 15 minute load average, the runnable and blocked tasks and the forks per second to the
+    // write_pipe, each followed by a sparkline of its last LOAD_HISTORY samples (the right end is the latest) and the value of a
+    // full block. The load and the runnable tasks are scaled to at least the number of cpus, so a line of full blocks means the
+    // cpus are saturated.
+    // NOTE: The load average counts the tasks blocked on I/O (state D) as well, compare it with the runnable tasks to tell them apart
+    // Example Output:
+    // getLoadSparklines(write_pipe) writes
+    //
+    // load      2.41  1.90  1.22  ▁▁▂▂▃▃▄▅▆▇██▇▆  (full 8)
+    // running   3                 ▁▂▁▃▂▄▅▇█▅▃▂▁▁  (full 8)
+    // blocked   0                 ▁▁▁▁▁▁▁▁▂█▁▁▁▁  (full 1)
+    // forks     12.0/s            ▁▁▁▁█▃▁▁▁▁▁▁▁▁  (full 240.0/s)
+    // 14 of 60 samples -- lines drawn again 5 times (only when a scale changed)
+
+    static struct monitor *handle = NULL;
+    static struct procFile loadavg;
+    static bool opened = false;
+
+    if (!opened)
+    {
+        handle = monitor_open(&(struct monitorConfig){.sections = MONITOR_CPU});
+        procFileOpen(&loadavg, "/proc/loadavg");
+        float cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        lines[LOAD].minimum = cpus;
+        lines[RUNNING].minimum = cpus;
+        lines[BLOCKED].minimum = 1;
+        lines[FORKS].minimum = 10;
+        for (int i = 0; i < SERIES_COUNT; i++)
+        {
+            lines[i].scale = lines[i].minimum;
+        }
+        opened = true;
+    }
+
+    // /proc/loadavg: 1, 5 and 15 minute averages, runnable/total tasks, last pid
+    long long stage = overheadBegin();
+    float load[3] = {0, 0, 0};
+    const char *text = procFileRead(&loadavg);
+    struct monitorSnapshot snapshot = {0};
+    bool sampled = handle != NULL && monitor_sample(handle, &snapshot) != -1;
+    overheadEnd(STAGE_READ, stage);
+
+    char buf[COLLECTOR_BUFFER];
+    int offset = 0;
+
+    if (text == NULL || sscanf(text, "%f %f %f", &load[0], &load[1], &load[2]) != 3 || !sampled)
+    {
+        offset = snprintf(buf, sizeof(buf), "(/proc/loadavg or /proc/stat cannot be read)\n");
+        sendMessage(write_pipe, buf, offset);
+        return;
+    }
+
+    stage = overheadBegin();
+    push(&lines[LOAD], load[0]);
+    push(&lines[RUNNING], snapshot.running);
+    push(&lines[BLOCKED], snapshot.blocked);
+    push(&lines[FORKS], snapshot.forks);
+    next = (next + 1) % LOAD_HISTORY;
+    count = count < LOAD_HISTORY ? count + 1 : LOAD_HISTORY;
+    overheadEnd(STAGE_COMPUTE, stage);
+
+    stage = overheadBegin();
+    offset += snprintf(buf + offset, sizeof(buf) - offset, "load     %5.2f %5.2f %5.2f  ", load[0], load[1], load[2]);
+    offset += copyLine(buf + offset, &lines[LOAD]);
+    offset += snprintf(buf + offset, sizeof(buf) - offset, "  (full %.2f)\nrunning  %-18lld  ", lines[LOAD].scale, snapshot.running);
+    offset += copyLine(buf + offset, &lines[RUNNING]);
+    offset += snprintf(buf + offset, sizeof(buf) - offset, "  (full %.0f)\nblocked  %-18lld  ", lines[RUNNING].scale, snapshot.blocked);
+    offset += copyLine(buf + offset, &lines[BLOCKED]);
+    char forks[32];
+    snprintf(forks, sizeof(forks), "%.1f/s", snapshot.forks);
+    offset += snprintf(buf + offset, sizeof(buf) - offset, "  (full %.0f)\nforks    %-18s  ", lines[BLOCKED].scale, forks);
+    offset += copyLine(buf + offset, &lines[FORKS]);
+    offset += snprintf(buf + offset, sizeof(buf) - offset, "  (full %.1f/s)\n%d of %d samples -- lines drawn again %ld times (only when a scale changed)\n", lines[FORKS].scale, count, LOAD_HISTORY, redraws);
+    overheadEnd(STAGE_FORMAT, stage);
+
+    stage = overheadBegin();
+    sendMessage(write_pipe, buf, offset);
+    overheadEnd(STAGE_WRITE, stage);
+}
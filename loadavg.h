@@ -0,0 +1,14 @@
+// Author: Kristi Dodaj
+// loadavg.h: Responsible for defining the collector of the load average and runnable tasks sparklines (see loadavg.c)
+
+#ifndef LOADAVG
+#define LOADAVG
+
+// the samples each sparkline shows (the oldest is dropped once it is full)
+#define LOAD_HISTORY 60
+
+// define the function signatures
+
+void getLoadSparklines(int write_pipe);
+
+#endif /* LOADAVG */
@@ -9,11 +9,17 @@
 #include <stdbool.h>
 #include <string.h>
 #include "stats_functions.h"
+#include "alerts.h"
+#include "overhead.h"
+#include "topology.h"
+#include "daemon.h"
+#include "isolation.h"
 
-void parseArguments(int argc, char *argv[], bool *system, bool *user, bool *sequential, bool *graphic, int *samples, int *tdelay)
+void parseArguments(int argc, char *argv[], bool *system, bool *user, bool *sequential, bool *graphic, int *samples, int *tdelay, int intervals[3], const char **daemon, const char **connect)
 {
     // This function will take in int argc and char *argv[] and will update the boolean pointers (user, sequential, system, graphics) and int
-    // pointers (samples, tdelay) according to the command line arguments inputted.
+    // pointers (samples, tdelay) as well as the collector intervals in milliseconds (intervals = {cpu, memory, users}, 0 when not given)
+    // and the daemon socket to serve on (daemon) or read from (connect), left NULL when not given, according to the command line arguments inputted.
     // Note: We assume that positional arguments for samples and tdelay are in this order (samples, tdelay), and will ALWAYS be the first two arguments inputted.
     // Example Output 1:
     // Suppose we execute as follows: ./a.out 5 2 --user
@@ -53,6 +59,24 @@ void parseArguments(int argc, char *argv[], bool *system, bool *user, bool *sequ
         {
             *graphic = true;
         }
+        // check for the collector interval flags (cpu, memory, users)
+        sscanf(argv[i], "--cpu-interval=%d", &intervals[0]);
+        sscanf(argv[i], "--memory-interval=%d", &intervals[1]);
+        sscanf(argv[i], "--users-interval=%d", &intervals[2]);
+        // check for flags --daemon and --connect (with the default socket when no path is given)
+        if (strcmp(argv[i], "--daemon") == 0 || strncmp(argv[i], "--daemon=", 9) == 0)
+        {
+            *daemon = argv[i][8] == '=' ? argv[i] + 9 : daemonDefaultSocket();
+        }
+        if (strcmp(argv[i], "--connect") == 0 || strncmp(argv[i], "--connect=", 10) == 0)
+        {
+            *connect = argv[i][9] == '=' ? argv[i] + 10 : daemonDefaultSocket();
+        }
+        // check for flag --overhead-log
+        if (strncmp(argv[i], "--overhead-log=", 15) == 0)
+        {
+            overheadLogOpen(argv[i] + 15);
+        }
         // check for flag --samples
         int sampleNumber;
         if (sscanf(argv[i], "--samples=%d", &sampleNumber) == 1 && sampleNumber > 0)
@@ -106,9 +130,36 @@ bool validateArguments(int argc, char *argv[])
     int graphicArgCount = 0;
     int tdelayArgCount = 0;
     int positionalArgCount = 0;
+    int alertArgCount = 0;
+    int overheadLogArgCount = 0;
+    int cpuIntervalArgCount = 0;
+    int memoryIntervalArgCount = 0;
+    int usersIntervalArgCount = 0;
+    int daemonArgCount = 0;
+    int connectArgCount = 0;
+
+    // --alert may be given any number of times and the optional panels (e.g. --perf) and isolation settings (e.g. --mlock) only change how the
+    // monitor runs, so none of them count towards the argument limit
+    int panelArgCount = 0;
+    int isolationArgCount = 0;
+    for (int i = 1; i < argc; i++)
+    {
+        if (strncmp(argv[i], "--alert=", 8) == 0)
+        {
+            alertArgCount++;
+        }
+        else if (strncmp(argv[i], "--", 2) == 0 && panelExists(argv[i] + 2))
+        {
+            panelArgCount++;
+        }
+        else if (isolationFlag(argv[i]))
+        {
+            isolationArgCount++;
+        }
+    }
 
     // check number of arguments
-    if (argc > 7)
+    if (argc - alertArgCount - panelArgCount - isolationArgCount > 11)
     {
         printf("TOO MANY ARGUMENTS. TRY AGAIN!\n");
         return false;
@@ -123,7 +174,7 @@ bool validateArguments(int argc, char *argv[])
         // check if all the flags are correctly formated
         if (argc >= 3)
         {
-            if (strcmp(argv[i], "--graphics") != 0 && strcmp(argv[i], "--sequential") != 0 && strcmp(argv[i], "--system") != 0 && strcmp(argv[i], "--user") != 0 && sscanf(argv[1], "%d", &dummyValue) != 1 && sscanf(argv[2], "%d", &dummyValue) != 1 && sscanf(argv[i], "--samples=%d", &dummyValue) != 1 && sscanf(argv[i], "--tdelay=%d", &dummyValue) != 1)
+            if (strcmp(argv[i], "--graphics") != 0 && strcmp(argv[i], "--sequential") != 0 && strcmp(argv[i], "--system") != 0 && strcmp(argv[i], "--user") != 0 && sscanf(argv[1], "%d", &dummyValue) != 1 && sscanf(argv[2], "%d", &dummyValue) != 1 && sscanf(argv[i], "--samples=%d", &dummyValue) != 1 && sscanf(argv[i], "--tdelay=%d", &dummyValue) != 1 && strncmp(argv[i], "--alert=", 8) != 0 && strncmp(argv[i], "--overhead-log=", 15) != 0 && sscanf(argv[i], "--cpu-interval=%d", &dummyValue) != 1 && sscanf(argv[i], "--memory-interval=%d", &dummyValue) != 1 && sscanf(argv[i], "--users-interval=%d", &dummyValue) != 1 && !(strncmp(argv[i], "--", 2) == 0 && panelExists(argv[i] + 2)) && strcmp(argv[i], "--daemon") != 0 && strncmp(argv[i], "--daemon=", 9) != 0 && strcmp(argv[i], "--connect") != 0 && strncmp(argv[i], "--connect=", 10) != 0 && !isolationFlag(argv[i]))
             {
                 printf("ONE OR MORE ARGUMENTS ARE MISTYPED OR IN THE WRONG ORDER. TRY AGAIN!\n");
                 return false;
@@ -132,7 +183,7 @@ bool validateArguments(int argc, char *argv[])
 
         if (argc < 3)
         {
-            if (strcmp(argv[i], "--graphics") != 0 && strcmp(argv[i], "--sequential") != 0 && strcmp(argv[i], "--system") != 0 && strcmp(argv[i], "--user") != 0 && sscanf(argv[1], "%d", &dummyValue) != 1 && sscanf(argv[i], "--samples=%d", &dummyValue) != 1 && sscanf(argv[i], "--tdelay=%d", &dummyValue) != 1)
+            if (strcmp(argv[i], "--graphics") != 0 && strcmp(argv[i], "--sequential") != 0 && strcmp(argv[i], "--system") != 0 && strcmp(argv[i], "--user") != 0 && sscanf(argv[1], "%d", &dummyValue) != 1 && sscanf(argv[i], "--samples=%d", &dummyValue) != 1 && sscanf(argv[i], "--tdelay=%d", &dummyValue) != 1 && strncmp(argv[i], "--alert=", 8) != 0 && strncmp(argv[i], "--overhead-log=", 15) != 0 && sscanf(argv[i], "--cpu-interval=%d", &dummyValue) != 1 && sscanf(argv[i], "--memory-interval=%d", &dummyValue) != 1 && sscanf(argv[i], "--users-interval=%d", &dummyValue) != 1 && !(strncmp(argv[i], "--", 2) == 0 && panelExists(argv[i] + 2)) && strcmp(argv[i], "--daemon") != 0 && strncmp(argv[i], "--daemon=", 9) != 0 && strcmp(argv[i], "--connect") != 0 && strncmp(argv[i], "--connect=", 10) != 0 && !isolationFlag(argv[i]))
             {
                 printf("ONE OR MORE ARGUMENTS ARE MISTYPED OR IN THE WRONG ORDER. TRY AGAIN!\n");
                 return false;
@@ -185,6 +236,85 @@ bool validateArguments(int argc, char *argv[])
                 return false;
             }
         }
+        else if (sscanf(argv[i], "--cpu-interval=%d", &dummyValue) == 1)
+        {
+            cpuIntervalArgCount++;
+            if (cpuIntervalArgCount > 1 || dummyValue <= 0)
+            {
+                printf("REPEATED OR INVALID --cpu-interval. TRY AGAIN!\n");
+                return false;
+            }
+        }
+        else if (sscanf(argv[i], "--memory-interval=%d", &dummyValue) == 1)
+        {
+            memoryIntervalArgCount++;
+            if (memoryIntervalArgCount > 1 || dummyValue <= 0)
+            {
+                printf("REPEATED OR INVALID --memory-interval. TRY AGAIN!\n");
+                return false;
+            }
+        }
+        else if (sscanf(argv[i], "--users-interval=%d", &dummyValue) == 1)
+        {
+            usersIntervalArgCount++;
+            if (usersIntervalArgCount > 1 || dummyValue <= 0)
+            {
+                printf("REPEATED OR INVALID --users-interval. TRY AGAIN!\n");
+                return false;
+            }
+        }
+        else if (strcmp(argv[i], "--daemon") == 0 || strncmp(argv[i], "--daemon=", 9) == 0)
+        {
+            daemonArgCount++;
+            if (daemonArgCount > 1 || connectArgCount > 0)
+            {
+                printf("REPEATED ARGUMENTS OR BOTH --daemon AND --connect. TRY AGAIN!\n");
+                return false;
+            }
+        }
+        else if (strcmp(argv[i], "--connect") == 0 || strncmp(argv[i], "--connect=", 10) == 0)
+        {
+            connectArgCount++;
+            if (connectArgCount > 1 || daemonArgCount > 0)
+            {
+                printf("REPEATED ARGUMENTS OR BOTH --daemon AND --connect. TRY AGAIN!\n");
+                return false;
+            }
+        }
+        else if (strncmp(argv[i], "--overhead-log=", 15) == 0)
+        {
+            overheadLogArgCount++;
+            if (overheadLogArgCount > 1)
+            {
+                printf("REPEATED ARGUMENTS. TRY AGAIN!\n");
+                return false;
+            }
+        }
+        else if (strncmp(argv[i], "--", 2) == 0 && panelExists(argv[i] + 2))
+        {
+            // turn the panel on now, a panel that is already on was given twice (or given a value it does not take, ex. --pid=0)
+            if (!enablePanel(argv[i] + 2))
+            {
+                printf("REPEATED OR INVALID ARGUMENTS. TRY AGAIN!\n");
+                return false;
+            }
+        }
+        else if (isolationFlag(argv[i]))
+        {
+            // record the setting now so an invalid or repeated one is reported before anything is printed
+            if (!isolationRequest(argv[i]))
+            {
+                return false;
+            }
+        }
+        else if (strncmp(argv[i], "--alert=", 8) == 0)
+        {
+            // compile the rule now so a malformed one is reported before anything is printed
+            if (!alertsCompile(argv[i] + 8))
+            {
+                return false;
+            }
+        }
         else if (sscanf(argv[i], "--tdelay=%d", &dummyValue) == 1)
         {
             tdelayArgCount++;
@@ -274,7 +404,25 @@ void navigate(int argc, char *argv[])
         bool graphic = false;
         int samples = 10;
         int tdelay = 1;
-        parseArguments(argc, argv, &system, &user, &sequential, &graphic, &samples, &tdelay);
+        int intervals[3] = {0, 0, 0};
+        const char *daemon = NULL;
+        const char *connect = NULL;
+        parseArguments(argc, argv, &system, &user, &sequential, &graphic, &samples, &tdelay, intervals, &daemon, &connect);
+        setCollectorIntervals(intervals[0], intervals[1], intervals[2]);
+
+        // pin, deprioritise and lock the monitor before any collector is forked so they inherit it
+        isolationApply();
+
+        // the daemon only collects and serves, it has no output to navigate to
+        if (daemon != NULL)
+        {
+            runDaemon(daemon, tdelay, graphic);
+            return;
+        }
+        if (connect != NULL)
+        {
+            setDaemonSocket(connect);
+        }
 
         // check if sequential
         if (sequential)
@@ -360,6 +508,12 @@ int main(int argc, char *argv[])
         exit(1);
     }
 
+    // start measuring the cost of the monitor before any collector is forked
+    overheadInit();
+
+    // discover the cpu topology once, the collectors forked later inherit it
+    topologyInit();
+
     // call the navigate function which will redirect to the right output depeneding on the arguments
     navigate(argc, argv);
 
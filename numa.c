@@ -0,0 +1,198 @@
+// Author: Kristi Dodaj
+// numa.c: Responsible for the optional collector of memory used per NUMA node and the numa_hit/numa_miss/numa_foreign rates of
+// every node, so one exhausted node is not hidden behind the machine wide total
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <dirent.h>
+#include "numa.h"
+#include "procfile.h"
+#include "event_loop.h"
+#include "overhead.h"
+#include "stats_functions.h"
+
+// what is kept per node between two samples
+struct numaNode
+{
+    int id;
+    char meminfoPath[64];
+    char numastatPath[64];
+    struct procFile meminfo;
+    struct procFile numastat;
+    long long previousHit;
+    long long previousMiss;
+    long long previousForeign;
+    long long previousLocal;
+    long long previousOther;
+};
+
+static struct numaNode *nodes = NULL;
+static int nodeCount = -1; // -1 until the nodes were discovered
+static long long previousTime = 0;
+
+static long long fieldValue(const char *text, const char *name)
+{
+    // This function returns the number that follows name in the text of a meminfo or numastat file, or 0 if name is not there
+    // Example Output:
+    // fieldValue("Node 0 MemTotal:        4161272 kB\n...", "MemTotal:") returns 4161272
+
+    const char *field = text != NULL ? strstr(text, name) : NULL;
+    return field != NULL ? strtoll(field + strlen(name), NULL, 10) : 0;
+}
+
+static int compareNodes(const void *first, const void *second)
+{
+    return ((const struct numaNode *)first)->id - ((const struct numaNode *)second)->id;
+}
+
+static void discoverNodes()
+{
+    // This function finds every node in /sys/devices/system/node (memory only nodes included) and opens its meminfo and numastat
+    // once, so the later samples are a pread() of each
+
+    nodeCount = 0;
+    DIR *directory = opendir("/sys/devices/system/node");
+    if (directory == NULL)
+    {
+        // a kernel without NUMA support has no node directory
+        return;
+    }
+
+    int allocated = 0;
+    struct dirent *entry;
+    while ((entry = readdir(directory)) != NULL)
+    {
+        int id;
+        if (sscanf(entry->d_name, "node%d", &id) != 1)
+        {
+            continue;
+        }
+
+        if (nodeCount == allocated)
+        {
+            allocated = allocated == 0 ? 4 : allocated * 2;
+            nodes = realloc(nodes, allocated * sizeof(struct numaNode));
+            if (!nodes)
+            {
+                perror("Error allocating memory");
+                exit(EXIT_FAILURE);
+            }
+        }
+
+        nodes[nodeCount].id = id;
+        nodeCount++;
+    }
+    closedir(directory);
+
+    // readdir gives no order, show the nodes by id
+    qsort(nodes, nodeCount, sizeof(struct numaNode), compareNodes);
+
+    // open the files only once the array stopped moving, the procFiles keep pointers to their paths
+    for (int i = 0; i < nodeCount; i++)
+    {
+        struct numaNode *node = &nodes[i];
+        snprintf(node->meminfoPath, sizeof(node->meminfoPath), "/sys/devices/system/node/node%d/meminfo", node->id);
+        snprintf(node->numastatPath, sizeof(node->numastatPath), "/sys/devices/system/node/node%d/numastat", node->id);
+        procFileOpen(&node->meminfo, node->meminfoPath);
+        procFileOpen(&node->numastat, node->numastatPath);
+        node->previousHit = node->previousMiss = node->previousForeign = -1;
+    }
+}
+
+void getNumaUsage(int write_pipe)
+{
+    // This function writes one line per NUMA node to the write_pipe with the memory used on that node and the numa_hit, numa_miss
+    // and numa_foreign rates since the previous call (the first call has nothing to compare to). In graphics mode each line ends
+    // with a bar of the node's used memory, one # per 5 %.
+    // NOTE: numa_miss counts pages that were meant for another node but had to be allocated here, numa_foreign counts pages meant
+    // for this node that ended up on another one, local is the share of allocations that stayed on the node of the task
+    // Example Output:
+    // getNumaUsage(write_pipe) writes (in graphics mode)
+    //
+    // node0   0.86 GB / 3.97 GB ( 21.7 %)  hit   1520/s  miss      0/s  foreign      0/s  local 100.0 %  [####................]
+    // node1   3.90 GB / 3.97 GB ( 98.2 %)  hit    310/s  miss    842/s  foreign      0/s  local  26.9 %  [####################]
+
+    if (nodeCount == -1)
+    {
+        discoverNodes();
+    }
+
+    char buf[COLLECTOR_BUFFER];
+    int offset = 0;
+
+    if (nodeCount == 0)
+    {
+        offset = snprintf(buf, sizeof(buf), "no NUMA nodes found in /sys/devices/system/node\n");
+        sendMessage(write_pipe, buf, offset);
+        return;
+    }
+
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    long long time = now.tv_sec * 1000000000LL + now.tv_nsec;
+    double seconds = previousTime > 0 ? (time - previousTime) / 1e9 : 0;
+    previousTime = time;
+
+    for (int i = 0; i < nodeCount && offset < (int)sizeof(buf) - 256; i++)
+    {
+        struct numaNode *node = &nodes[i];
+
+        const char *meminfo = procFileRead(&node->meminfo);
+        const char *numastat = procFileRead(&node->numastat);
+        if (meminfo == NULL || numastat == NULL)
+        {
+            offset += snprintf(buf + offset, sizeof(buf) - offset, "node%-3d (unavailable)\n", node->id);
+            continue;
+        }
+
+        long long stage = overheadBegin();
+        long long total = fieldValue(meminfo, "MemTotal:");
+        long long used = fieldValue(meminfo, "MemUsed:");
+        long long hit = fieldValue(numastat, "numa_hit ");
+        long long miss = fieldValue(numastat, "numa_miss ");
+        long long foreign = fieldValue(numastat, "numa_foreign ");
+        long long local = fieldValue(numastat, "local_node ");
+        long long other = fieldValue(numastat, "other_node ");
+        overheadEnd(STAGE_PARSE, stage);
+
+        stage = overheadBegin();
+        float percent = total > 0 ? (float)used / total * 100 : 0;
+        offset += snprintf(buf + offset, sizeof(buf) - offset, "node%-3d %5.2f GB / %.2f GB (%5.1f %%)", node->id, used / 1048576.0, total / 1048576.0, percent);
+
+        if (seconds > 0 && node->previousHit >= 0)
+        {
+            long long allocations = (local - node->previousLocal) + (other - node->previousOther);
+            float localPercent = allocations > 0 ? (float)(local - node->previousLocal) / allocations * 100 : 100;
+            offset += snprintf(buf + offset, sizeof(buf) - offset, "  hit %6.0f/s  miss %6.0f/s  foreign %6.0f/s  local %5.1f %%", (hit - node->previousHit) / seconds, (miss - node->previousMiss) / seconds, (foreign - node->previousForeign) / seconds, localPercent);
+        }
+        else
+        {
+            offset += snprintf(buf + offset, sizeof(buf) - offset, "  (measuring)");
+        }
+
+        if (graphicOutput())
+        {
+            int bars = (int)(percent / 5 + 0.5);
+            offset += snprintf(buf + offset, sizeof(buf) - offset, "  [");
+            for (int bar = 0; bar < 20; bar++)
+            {
+                buf[offset++] = bar < bars ? '#' : '.';
+            }
+            buf[offset++] = ']';
+        }
+        buf[offset++] = '\n';
+        overheadEnd(STAGE_FORMAT, stage);
+
+        node->previousHit = hit;
+        node->previousMiss = miss;
+        node->previousForeign = foreign;
+        node->previousLocal = local;
+        node->previousOther = other;
+    }
+
+    long long stage = overheadBegin();
+    sendMessage(write_pipe, buf, offset);
+    overheadEnd(STAGE_WRITE, stage);
+}
@@ -0,0 +1,11 @@
+// Author: Kristi Dodaj
+// numa.h: Responsible for defining the NUMA node memory collector (see numa.c)
+
+#ifndef NUMA
+#define NUMA
+
+// define the function signatures
+
+void getNumaUsage(int write_pipe);
+
+#endif /* NUMA */
@@ -0,0 +1,251 @@
+// Author: Kristi Dodaj
+// output.c: Responsible for writing the frames to stdout without ever blocking the event loop. Each frame is printed into memory,
+// queued, and written whenever stdout can take more. When the terminal or pipe falls behind in the update modes the frame that is
+// still waiting is replaced by the newer one (and counted as dropped), so a slow consumer never delays the samples.
+
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/stat.h>
+#include "output.h"
+#include "event_loop.h"
+#include "overhead.h"
+
+// one frame waiting to be written
+struct queuedFrame
+{
+    char *data;
+    int length;
+    int written;  // bytes already written (only the frame at the head of the queue is ever partly written)
+    int capacity; // bytes allocated for data, kept when the slot is reused
+};
+
+static struct queuedFrame queue[OUTPUT_QUEUE_SEQUENTIAL];
+static int head = 0;
+static int queued = 0;
+static int queueLimit = OUTPUT_QUEUE_UPDATE;
+
+static bool keepAll = false;
+static bool direct = true;     // stdout is a regular file (or the output was not started), so frames are written straight away
+static bool watching = false;  // the event loop is waiting for stdout to become writable
+static int savedFlags = -1;    // the flags of stdout before it was made non-blocking
+static long dropped = 0;
+
+static FILE *frameStream = NULL; // the memory stream a frame is printed into
+static char *frameBuffer = NULL;
+static size_t frameSize = 0;
+
+static void restoreFlags()
+{
+    // This function makes stdout blocking again, the terminal is shared with the shell that started the monitor
+    if (savedFlags != -1)
+    {
+        fcntl(STDOUT_FILENO, F_SETFL, savedFlags);
+        savedFlags = -1;
+    }
+}
+
+static bool writeQueued()
+{
+    // This function writes as much of the queued frames as stdout takes without blocking and returns true once the queue is empty
+
+    long long stage = overheadBegin();
+
+    while (queued > 0)
+    {
+        struct queuedFrame *frame = &queue[head];
+        ssize_t count = write(STDOUT_FILENO, frame->data + frame->written, frame->length - frame->written);
+
+        if (count < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            if (errno != EAGAIN)
+            {
+                // the reader went away (ex. a closed pipe), there is nobody left to show the frames to
+                queued = 0;
+            }
+            break;
+        }
+
+        frame->written += count;
+        if (frame->written == frame->length)
+        {
+            head = (head + 1) % OUTPUT_QUEUE_SEQUENTIAL;
+            queued--;
+        }
+    }
+
+    overheadEnd(STAGE_WRITE, stage);
+    return queued == 0;
+}
+
+static void outputReady(int fd, void *context)
+{
+    // This function is called by the event loop when stdout can take more, and stops watching it once everything is written
+    if (writeQueued() && watching)
+    {
+        eventLoopUnwatch(STDOUT_FILENO);
+        watching = false;
+    }
+}
+
+static void waitWritable()
+{
+    // This function writes the queue with stdout blocking, for the sequential mode when its queue is full and at the end of a run
+
+    if (savedFlags != -1)
+    {
+        fcntl(STDOUT_FILENO, F_SETFL, savedFlags);
+    }
+    writeQueued();
+    if (savedFlags != -1)
+    {
+        fcntl(STDOUT_FILENO, F_SETFL, savedFlags | O_NONBLOCK);
+    }
+}
+
+void outputBegin(bool keepEveryFrame)
+{
+    // This function starts queueing the frames of a run. With keepEveryFrame (the sequential mode) no frame is ever dropped and
+    // drawing only waits for the terminal once OUTPUT_QUEUE_SEQUENTIAL frames are queued. Otherwise at most OUTPUT_QUEUE_UPDATE
+    // frames are queued and a newer frame replaces the one still waiting.
+    // NOTE: A regular file never blocks for long and cannot be watched by epoll, so output to a file is written directly
+    // Example Output:
+    // outputBegin(false) makes stdout non-blocking when it is a terminal or a pipe
+
+    keepAll = keepEveryFrame;
+    queueLimit = keepEveryFrame ? OUTPUT_QUEUE_SEQUENTIAL : OUTPUT_QUEUE_UPDATE;
+
+    if (frameStream == NULL)
+    {
+        frameStream = open_memstream(&frameBuffer, &frameSize);
+        if (frameStream == NULL)
+        {
+            perror("open_memstream: Failed to create the frame buffer");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    // everything printed before the first frame has to be out before the frames
+    fflush(stdout);
+
+    struct stat info;
+    direct = fstat(STDOUT_FILENO, &info) == -1 || S_ISREG(info.st_mode);
+    if (!direct && savedFlags == -1)
+    {
+        savedFlags = fcntl(STDOUT_FILENO, F_GETFL);
+        if (savedFlags == -1 || fcntl(STDOUT_FILENO, F_SETFL, savedFlags | O_NONBLOCK) == -1)
+        {
+            perror("fcntl: Failed to make stdout non-blocking, frames are written directly");
+            direct = true;
+            savedFlags = -1;
+        }
+
+        // restoreFlags() clears savedFlags, so a run that is paused and resumed comes back here and must not register it again
+        static bool registered = false;
+        if (!registered)
+        {
+            atexit(restoreFlags);
+            registered = true;
+        }
+    }
+}
+
+FILE *outputFrameStart(bool *replacing)
+{
+    // This function returns the stream the next frame is printed into until outputFrameEnd(), which holds it in memory instead of
+    // writing it to stdout. replacing is set to true when that frame will replace one that is still waiting, so an update frame
+    // knows it has to redraw what the dropped frame would have drawn.
+    // NOTE: Everything of a frame has to be printed to the returned stream, printf() still goes straight to stdout
+    // Example Output:
+    // outputFrameStart(&replacing) returns the frame stream, with replacing = false
+
+    fseeko(frameStream, 0, SEEK_SET);
+    *replacing = !direct && !keepAll && queued >= queueLimit;
+    return frameStream;
+}
+
+void outputFrameEnd()
+{
+    // This function queues the frame printed since outputFrameStart() and writes as much as stdout takes right away. If the
+    // queue is full an update frame replaces the last frame that is waiting (which counts as dropped), and a sequential frame
+    // waits for the terminal.
+
+    fflush(frameStream);
+    int length = ftello(frameStream);
+
+    if (direct)
+    {
+        fwrite(frameBuffer, 1, length, stdout);
+        fflush(stdout);
+        return;
+    }
+
+    long long stage = overheadBegin();
+    if (queued >= queueLimit)
+    {
+        if (keepAll)
+        {
+            waitWritable();
+        }
+        else if (queue[(head + queued - 1) % OUTPUT_QUEUE_SEQUENTIAL].written == 0)
+        {
+            // coalesce: the waiting frame was never started, the new one takes its place
+            queued--;
+            dropped++;
+        }
+    }
+
+    struct queuedFrame *frame = &queue[(head + queued) % OUTPUT_QUEUE_SEQUENTIAL];
+    if (frame->capacity < length)
+    {
+        frame->data = realloc(frame->data, length);
+        if (!frame->data)
+        {
+            perror("Error allocating memory");
+            exit(EXIT_FAILURE);
+        }
+        frame->capacity = length;
+    }
+    memcpy(frame->data, frameBuffer, length);
+    frame->length = length;
+    frame->written = 0;
+    queued++;
+    overheadEnd(STAGE_WRITE, stage);
+
+    if (!writeQueued() && !watching)
+    {
+        eventLoopWatchWritable(STDOUT_FILENO, outputReady, NULL);
+        watching = true;
+    }
+}
+
+void outputFinish()
+{
+    // This function writes every frame that is still queued (waiting for the terminal if it has to) and makes stdout blocking
+    // again, so what is printed after the run (or while it is paused, until outputBegin() is called again) follows the last frame
+
+    if (watching)
+    {
+        eventLoopUnwatch(STDOUT_FILENO);
+        watching = false;
+    }
+    waitWritable();
+    restoreFlags();
+    direct = true;
+}
+
+long outputDropped()
+{
+    // This function returns how many update frames were dropped because the output could not keep up
+    // Example Output:
+    // outputDropped() returns 0
+    return dropped;
+}
@@ -0,0 +1,24 @@
+// Author: Kristi Dodaj
+// output.h: Responsible for defining the non-blocking frame output (see output.c)
+
+#include <stdio.h>
+#include <stdbool.h>
+
+#ifndef OUTPUT
+#define OUTPUT
+
+// the most frames waiting to be written in the update modes (the one being written and the newest), older ones are dropped
+#define OUTPUT_QUEUE_UPDATE 2
+
+// the most frames waiting to be written in the sequential mode before drawing waits for the terminal (no frame is ever dropped)
+#define OUTPUT_QUEUE_SEQUENTIAL 64
+
+// define the function signatures
+
+void outputBegin(bool keepEveryFrame);
+FILE *outputFrameStart(bool *replacing);
+void outputFrameEnd();
+void outputFinish();
+long outputDropped();
+
+#endif /* OUTPUT */
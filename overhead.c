@@ -0,0 +1,242 @@
+// Author: Kristi Dodaj
+// overhead.c: Responsible for measuring how much the monitor itself costs (stage timings, cpu time of the parent and the
+// collector children, read and write syscalls per sample) and reporting it in the header and in a machine-readable log
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include "overhead.h"
+
+// the collector children live in other processes, so the counters they update are kept in a shared anonymous mapping
+struct overheadCounters
+{
+    long long stageNanoseconds[STAGE_COUNT];
+    long long samples;
+};
+
+static struct overheadCounters localCounters;
+static struct overheadCounters *counters = &localCounters;
+
+static const char *stageNames[STAGE_COUNT] = {"read", "parse", "compute", "format", "write"};
+
+// the forked collectors whose cpu time and syscalls count towards the monitor
+#define MAX_TRACKED_CHILDREN 16
+static pid_t children[MAX_TRACKED_CHILDREN];
+static int childCount = 0;
+
+// values used to turn the running totals into per-sample and per-second figures
+static long long startTime = 0;
+static long long previousSyscalls = -1;
+static double syscallsPerSample = 0;
+static double overheadPercent = 0;
+
+static FILE *logFile = NULL;
+
+static long long nowNanoseconds()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
+void overheadInit()
+{
+    // This function sets up the shared counters and the start time. It has to be called before any collector is forked
+    // so that the children write their stage timings where the parent can read them.
+    // Example Output:
+    // overheadInit() maps one shared page for the counters
+
+    void *shared = mmap(NULL, sizeof(struct overheadCounters), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+
+    if (shared == MAP_FAILED)
+    {
+        // error checking for system resources
+        perror("mmap: Failed to share the overhead counters, only the main process will be measured");
+    }
+    else
+    {
+        counters = shared;
+        memset(counters, 0, sizeof(*counters));
+    }
+
+    startTime = nowNanoseconds();
+}
+
+bool overheadLogOpen(const char *path)
+{
+    // This function opens the file that receives one JSON line with the overhead figures after every sample
+    // Example Output:
+    // overheadLogOpen("/tmp/overhead.jsonl") returns true
+
+    logFile = fopen(path, "w");
+
+    if (logFile == NULL)
+    {
+        perror("fopen: Failed to open the overhead log");
+        return false;
+    }
+
+    return true;
+}
+
+void overheadLogClose()
+{
+    // This function closes the overhead log at the end of a run, also when it was stopped early (ctrl c, SIGTERM)
+
+    if (logFile != NULL)
+    {
+        fclose(logFile);
+        logFile = NULL;
+    }
+}
+
+void overheadTrackChild(pid_t pid)
+{
+    // This function registers a forked collector so its cpu time and syscalls are included in the totals.
+    // NOTE: It is called straight after fork() in both processes, so it ignores the 0 returned to the child
+
+    if (pid > 0 && childCount < MAX_TRACKED_CHILDREN)
+    {
+        children[childCount++] = pid;
+    }
+}
+
+long long overheadBegin()
+{
+    // This function returns the timestamp that starts timing a stage
+    return nowNanoseconds();
+}
+
+void overheadEnd(enum overheadStage stage, long long start)
+{
+    // This function adds the time elapsed since start (from overheadBegin()) to the given stage
+    __atomic_fetch_add(&counters->stageNanoseconds[stage], nowNanoseconds() - start, __ATOMIC_RELAXED);
+}
+
+static long long processTicks(pid_t pid)
+{
+    // This function returns the utime + stime of a live child from /proc/[pid]/stat in clock ticks (0 once it is gone)
+
+    char path[64];
+    snprintf(path, sizeof(path), "/proc/%d/stat", pid);
+
+    FILE *stat = fopen(path, "r");
+    if (stat == NULL)
+    {
+        return 0;
+    }
+
+    unsigned long utime = 0, stime = 0;
+    if (fscanf(stat, "%*d (%*[^)]) %*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %lu %lu", &utime, &stime) != 2)
+    {
+        utime = stime = 0;
+    }
+
+    fclose(stat);
+    return utime + stime;
+}
+
+static long long processSyscalls(const char *path)
+{
+    // This function returns syscr + syscw (read and write type syscalls) from a /proc/[pid]/io file
+
+    FILE *io = fopen(path, "r");
+    if (io == NULL)
+    {
+        return 0;
+    }
+
+    char line[128];
+    long long value, total = 0;
+    while (fgets(line, sizeof(line), io) != NULL)
+    {
+        if (sscanf(line, "syscr: %lld", &value) == 1 || sscanf(line, "syscw: %lld", &value) == 1)
+        {
+            total += value;
+        }
+    }
+
+    fclose(io);
+    return total;
+}
+
+void overheadSample()
+{
+    // This function marks the end of one sample: it recomputes the cpu share of the monitor (main process, its threads and
+    // every collector child, alive or already waited for), the syscalls made since the previous sample and writes the log line.
+    // Example Output:
+    // overheadSample() writes to the log
+    //
+    // {"sample":3,"overhead_pct_core":0.041,"rw_syscalls_per_sample":18,"read_us":21.4,"parse_us":3.1,"compute_us":0.1,"format_us":2.0,"write_us":9.8}
+
+    counters->samples++;
+
+    // cpu time of this process (all threads) and of the children that were already waited for
+    struct rusage self, waited;
+    getrusage(RUSAGE_SELF, &self);
+    getrusage(RUSAGE_CHILDREN, &waited);
+
+    double cpuSeconds = self.ru_utime.tv_sec + self.ru_utime.tv_usec / 1e6 + self.ru_stime.tv_sec + self.ru_stime.tv_usec / 1e6;
+    cpuSeconds += waited.ru_utime.tv_sec + waited.ru_utime.tv_usec / 1e6 + waited.ru_stime.tv_sec + waited.ru_stime.tv_usec / 1e6;
+
+    // plus the children that are still running
+    long long syscalls = processSyscalls("/proc/self/io");
+    long ticksPerSecond = sysconf(_SC_CLK_TCK);
+    for (int i = 0; i < childCount; i++)
+    {
+        char path[64];
+        snprintf(path, sizeof(path), "/proc/%d/io", children[i]);
+        syscalls += processSyscalls(path);
+        cpuSeconds += (double)processTicks(children[i]) / ticksPerSecond;
+    }
+
+    double elapsed = (nowNanoseconds() - startTime) / 1e9;
+    if (elapsed > 0)
+    {
+        overheadPercent = cpuSeconds / elapsed * 100;
+    }
+
+    if (previousSyscalls >= 0 && syscalls >= previousSyscalls)
+    {
+        syscallsPerSample = syscalls - previousSyscalls;
+    }
+    previousSyscalls = syscalls;
+
+    if (logFile != NULL)
+    {
+        fprintf(logFile, "{\"sample\":%lld,\"overhead_pct_core\":%.4f,\"cpu_seconds\":%.4f,\"rw_syscalls_per_sample\":%.0f", counters->samples, overheadPercent, cpuSeconds, syscallsPerSample);
+        for (int i = 0; i < STAGE_COUNT; i++)
+        {
+            fprintf(logFile, ",\"%s_us\":%.2f", stageNames[i], counters->stageNanoseconds[i] / 1000.0 / counters->samples);
+        }
+        fprintf(logFile, "}\n");
+        fflush(logFile);
+    }
+}
+
+int overheadPrint(FILE *out)
+{
+    // This function prints the overhead lines of the header and returns how many lines it printed
+    // NOTE: The stage timings are averages per sample over the whole run
+    // Example Output:
+    // overheadPrint(stdout) prints
+    //
+    // Monitor Overhead: 0.041 % of a core -- 18 read/write syscalls/sample
+    // Stage Times (us/sample): read 21.4  parse 3.1  compute 0.1  format 2.0  write 9.8
+
+    fprintf(out, "Monitor Overhead: %.3f %% of a core -- %.0f read/write syscalls/sample \n", overheadPercent, syscallsPerSample);
+    fprintf(out, "Stage Times (us/sample):");
+
+    long long samples = counters->samples > 0 ? counters->samples : 1;
+    for (int i = 0; i < STAGE_COUNT; i++)
+    {
+        fprintf(out, " %s %.1f ", stageNames[i], counters->stageNanoseconds[i] / 1000.0 / samples);
+    }
+    fprintf(out, "\n");
+
+    return 2;
+}
@@ -0,0 +1,33 @@
+// Author: Kristi Dodaj
+// overhead.h: Responsible for defining the functions that measure the monitor's own cost (see overhead.c)
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <sys/types.h>
+
+#ifndef OVERHEAD
+#define OVERHEAD
+
+// the stages every sample goes through, timed separately
+enum overheadStage
+{
+    STAGE_READ,
+    STAGE_PARSE,
+    STAGE_COMPUTE,
+    STAGE_FORMAT,
+    STAGE_WRITE,
+    STAGE_COUNT
+};
+
+// define the function signatures
+
+void overheadInit();
+bool overheadLogOpen(const char *path);
+void overheadLogClose();
+void overheadTrackChild(pid_t pid);
+long long overheadBegin();
+void overheadEnd(enum overheadStage stage, long long start);
+void overheadSample();
+int overheadPrint(FILE *out);
+
+#endif /* OVERHEAD */
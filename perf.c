@@ -0,0 +1,394 @@
+// Author: Kristi Dodaj
+// perf.c: Responsible for the optional collector that reads grouped perf_event counters per cpu (cycles, instructions, cache
+// misses, context switches) and reports IPC and miss rates next to the utilisation of each core
+
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+#include <sys/syscall.h>
+#include <sys/ioctl.h>
+#include <linux/perf_event.h>
+#include "perf.h"
+#include "event_loop.h"
+#include "overhead.h"
+#include "stats_functions.h"
+#include "topology.h"
+
+// the most counters in one group
+#define PERF_GROUP_SIZE 5
+
+// the counters opened on each cpu, either the hardware group or the software group when hardware events are unavailable
+static const struct
+{
+    uint32_t type;
+    uint64_t config;
+} hardwareGroup[PERF_GROUP_SIZE] = {
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_REFERENCES},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+    {PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES},
+},
+  softwareGroup[PERF_GROUP_SIZE] = {
+      {PERF_TYPE_SOFTWARE, PERF_COUNT_SW_TASK_CLOCK},
+      {PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES},
+      {PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CPU_MIGRATIONS},
+      {PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS},
+};
+
+// the layout of one read() of a group opened with PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING
+struct groupReading
+{
+    uint64_t count;
+    uint64_t timeEnabled;
+    uint64_t timeRunning;
+    uint64_t values[PERF_GROUP_SIZE];
+};
+
+// what is kept per cpu between two samples
+struct perfCpu
+{
+    int leader;                    // fd of the group leader (-1 when the cpu is offline or could not be opened)
+    int members[PERF_GROUP_SIZE];  // fds of the whole group, the leader included
+    struct groupReading previous;  // the previous reading of the group
+    long long previousBusy;        // busy jiffies from /proc/stat at the previous sample
+    long long previousTotal;       // total jiffies from /proc/stat at the previous sample
+};
+
+static struct perfCpu *cpus = NULL;
+static int cpuCount = 0;
+static int groupSize = 0;
+static bool hardware = false;
+static const char *unavailable = NULL; // why no counters could be opened at all
+static long long previousTime = 0;
+
+static int openCounter(uint32_t type, uint64_t config, int cpu, int group)
+{
+    // This function opens one system wide counter on the given cpu, in the group led by group (-1 to start a new group)
+
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = config;
+    attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    attr.disabled = group == -1; // the whole group is enabled through its leader once it is complete
+
+    return syscall(SYS_perf_event_open, &attr, -1, cpu, group, PERF_FLAG_FD_CLOEXEC);
+}
+
+static bool openGroup(struct perfCpu *cpu, int index, bool useHardware)
+{
+    // This function opens the whole group of counters on one cpu and returns false if any of them is not available
+
+    int size = useHardware ? PERF_GROUP_SIZE : 4;
+    int fds[PERF_GROUP_SIZE];
+
+    for (int i = 0; i < size; i++)
+    {
+        uint32_t type = useHardware ? hardwareGroup[i].type : softwareGroup[i].type;
+        uint64_t config = useHardware ? hardwareGroup[i].config : softwareGroup[i].config;
+
+        fds[i] = openCounter(type, config, index, i == 0 ? -1 : fds[0]);
+        if (fds[i] == -1)
+        {
+            while (i-- > 0)
+            {
+                close(fds[i]);
+            }
+            return false;
+        }
+    }
+
+    cpu->leader = fds[0];
+    memcpy(cpu->members, fds, sizeof(fds));
+    memset(&cpu->previous, 0, sizeof(cpu->previous));
+    groupSize = size;
+    ioctl(cpu->leader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+    ioctl(cpu->leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+
+    // NOTE: the file descriptors of the other members stay open for as long as the cpu is online, they are read through the leader
+    return true;
+}
+
+static void closeGroup(struct perfCpu *cpu)
+{
+    // This function closes every counter of the group on a cpu that went offline
+    for (int i = 0; i < groupSize; i++)
+    {
+        close(cpu->members[i]);
+    }
+    cpu->leader = -1;
+}
+
+static void followHotplug()
+{
+    // This function opens the group of every cpu that came online and closes the group of every cpu that went offline since the
+    // topology was last read (see topologyRefresh() in topology.c)
+
+    const struct topology *machine = topologyGet();
+
+    for (int i = 0; i < cpuCount && i < machine->possible; i++)
+    {
+        if (machine->cpus[i].online && cpus[i].leader == -1)
+        {
+            openGroup(&cpus[i], i, hardware);
+        }
+        else if (!machine->cpus[i].online && cpus[i].leader != -1)
+        {
+            closeGroup(&cpus[i]);
+        }
+    }
+}
+
+static void openCounters()
+{
+    // This function opens one group per cpu, trying the hardware counters first and falling back to the software ones
+    // (VMs and containers often have no PMU) rather than failing
+
+    const struct topology *machine = topologyGet();
+    cpuCount = machine->possible;
+    cpus = calloc(cpuCount, sizeof(struct perfCpu));
+    if (!cpus)
+    {
+        perror("Error allocating memory");
+        exit(EXIT_FAILURE);
+    }
+
+    hardware = true;
+    int opened = 0;
+    int lastError = 0;
+
+    for (int pass = 0; pass < 2 && opened == 0; pass++)
+    {
+        for (int i = 0; i < cpuCount; i++)
+        {
+            cpus[i].leader = -1;
+            if (machine->cpus[i].online && openGroup(&cpus[i], i, hardware))
+            {
+                opened++;
+            }
+            else
+            {
+                lastError = errno;
+            }
+        }
+
+        if (opened == 0)
+        {
+            hardware = false;
+        }
+    }
+
+    if (opened == 0)
+    {
+        unavailable = (lastError == EACCES || lastError == EPERM) ? "not permitted (see /proc/sys/kernel/perf_event_paranoid)" : strerror(lastError);
+    }
+}
+
+static void readCpuTimes(long long *busy, long long *total)
+{
+    // This function fills busy and total (in jiffies) of every cpu from the per-cpu lines of /proc/stat
+
+    FILE *stat = fopen("/proc/stat", "r");
+    if (stat == NULL)
+    {
+        perror("fopen: Failed to open /proc/stat");
+        return;
+    }
+
+    char line[512];
+    while (fgets(line, sizeof(line), stat) != NULL)
+    {
+        int cpu;
+        long long user, nice, system, idle, iowait, irq, softirq, steal;
+        if (sscanf(line, "cpu%d %lld %lld %lld %lld %lld %lld %lld %lld", &cpu, &user, &nice, &system, &idle, &iowait, &irq, &softirq, &steal) == 9 && cpu < cpuCount)
+        {
+            total[cpu] = user + nice + system + idle + iowait + irq + softirq + steal;
+            busy[cpu] = total[cpu] - idle - iowait;
+        }
+        else if (strncmp(line, "cpu", 3) != 0)
+        {
+            // the per-cpu lines all come first
+            break;
+        }
+    }
+
+    fclose(stat);
+}
+
+static int groupCpus(const struct topology *machine, int *order)
+{
+    // This function fills order with the online cpus sorted by socket, then NUMA node, then cpu id and returns how many there are
+
+    int count = 0;
+    for (int i = 0; i < cpuCount && i < machine->possible; i++)
+    {
+        if (!machine->cpus[i].online)
+        {
+            continue;
+        }
+
+        // insertion sort, the list is short and already nearly sorted on most machines
+        int j = count++;
+        while (j > 0 && (machine->cpus[order[j - 1]].socket > machine->cpus[i].socket || (machine->cpus[order[j - 1]].socket == machine->cpus[i].socket && machine->cpus[order[j - 1]].node > machine->cpus[i].node)))
+        {
+            order[j] = order[j - 1];
+            j--;
+        }
+        order[j] = i;
+    }
+    return count;
+}
+
+void getPerfCounters(int write_pipe)
+{
+    // This function reads every cpu's counter group with a single read() each, works out the rates since the previous call and
+    // writes one line per cpu to the write_pipe. The counters are opened on the first call (in the collector process).
+    // NOTE: Counters that were multiplexed by the kernel are scaled by time_enabled / time_running
+    // Example Output:
+    // getPerfCounters(write_pipe) writes (hardware counters)
+    //
+    // socket 0 / node 0
+    //   cpu0   util  34.50 %  IPC 1.42  cache miss  3.10 %  ctx    812/s
+    //   cpu1   util   2.00 %  IPC 0.61  cache miss 12.40 %  ctx     95/s
+    //
+    // or (software fallback)
+    //
+    // (no hardware counters, showing software events)
+    // socket 0 / node 0
+    //   cpu0   util  34.50 %  ctx    812/s  migrations    4/s  faults    120/s
+
+    if (cpus == NULL)
+    {
+        openCounters();
+    }
+    else if (topologyRefresh() && unavailable == NULL)
+    {
+        followHotplug();
+    }
+
+    char buf[COLLECTOR_BUFFER];
+    int offset = 0;
+
+    if (unavailable != NULL)
+    {
+        offset = snprintf(buf, sizeof(buf), "perf events unavailable: %s\n", unavailable);
+        sendMessage(write_pipe, buf, offset);
+        return;
+    }
+
+    // the per-core utilisation the counters are shown next to
+    long long stage = overheadBegin();
+    long long busy[cpuCount], total[cpuCount];
+    memset(busy, 0, sizeof(busy));
+    memset(total, 0, sizeof(total));
+    readCpuTimes(busy, total);
+
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    long long time = now.tv_sec * 1000000000LL + now.tv_nsec;
+    double seconds = previousTime > 0 ? (time - previousTime) / 1e9 : 0;
+    previousTime = time;
+
+    struct groupReading readings[cpuCount];
+    for (int i = 0; i < cpuCount; i++)
+    {
+        if (cpus[i].leader == -1 || read(cpus[i].leader, &readings[i], sizeof(readings[i])) <= 0)
+        {
+            readings[i].count = 0;
+        }
+    }
+    overheadEnd(STAGE_READ, stage);
+
+    stage = overheadBegin();
+    if (!hardware)
+    {
+        offset += snprintf(buf + offset, sizeof(buf) - offset, "(no hardware counters, showing software events)\n");
+    }
+
+    // the cpus are listed grouped by socket and NUMA node, each group after a line naming it
+    const struct topology *machine = topologyGet();
+    int order[cpuCount];
+    int ordered = groupCpus(machine, order);
+
+    for (int k = 0; k < ordered && offset < (int)sizeof(buf) - 256; k++)
+    {
+        int i = order[k];
+        struct groupReading *current = &readings[i];
+        struct groupReading *previous = &cpus[i].previous;
+
+        if (current->count == 0)
+        {
+            continue;
+        }
+
+        if (k == 0 || machine->cpus[order[k - 1]].socket != machine->cpus[i].socket || machine->cpus[order[k - 1]].node != machine->cpus[i].node)
+        {
+            offset += snprintf(buf + offset, sizeof(buf) - offset, "socket %d / node %d\n", machine->cpus[i].socket, machine->cpus[i].node);
+        }
+
+        float utilisation = 0;
+        if (total[i] > cpus[i].previousTotal)
+        {
+            utilisation = (float)(busy[i] - cpus[i].previousBusy) / (total[i] - cpus[i].previousTotal) * 100;
+        }
+
+        // deltas of every counter, scaled up when the group only ran part of the time
+        double delta[PERF_GROUP_SIZE] = {0};
+        uint64_t enabled = current->timeEnabled - previous->timeEnabled;
+        uint64_t running = current->timeRunning - previous->timeRunning;
+        double scale = running > 0 ? (double)enabled / running : 0;
+        for (int j = 0; j < groupSize; j++)
+        {
+            delta[j] = (current->values[j] - previous->values[j]) * scale;
+        }
+
+        offset += snprintf(buf + offset, sizeof(buf) - offset, "  cpu%-3d util %6.2f %%", i, utilisation);
+
+        if (seconds == 0)
+        {
+            offset += snprintf(buf + offset, sizeof(buf) - offset, "  (measuring)\n");
+        }
+        else if (hardware)
+        {
+            double ipc = delta[0] > 0 ? delta[1] / delta[0] : 0;
+            double missRate = delta[2] > 0 ? delta[3] / delta[2] * 100 : 0;
+            offset += snprintf(buf + offset, sizeof(buf) - offset, "  IPC %4.2f  cache miss %5.2f %%  ctx %6.0f/s", ipc, missRate, delta[4] / seconds);
+        }
+        else
+        {
+            // a system wide task-clock only counts the elapsed time, it leads the group so the others can be scaled but is not shown
+            offset += snprintf(buf + offset, sizeof(buf) - offset, "  ctx %6.0f/s  migrations %4.0f/s  faults %6.0f/s", delta[1] / seconds, delta[2] / seconds, delta[3] / seconds);
+        }
+
+        if (seconds > 0)
+        {
+            // in graphics mode add a bar of the utilisation, one | per 5 %
+            if (graphicOutput())
+            {
+                offset += snprintf(buf + offset, sizeof(buf) - offset, "  ");
+                for (int bar = 0; bar < (int)(utilisation / 5) && offset < (int)sizeof(buf) - 2; bar++)
+                {
+                    buf[offset++] = '|';
+                }
+            }
+            offset += snprintf(buf + offset, sizeof(buf) - offset, "\n");
+        }
+
+        cpus[i].previous = *current;
+        cpus[i].previousBusy = busy[i];
+        cpus[i].previousTotal = total[i];
+    }
+    overheadEnd(STAGE_FORMAT, stage);
+
+    stage = overheadBegin();
+    sendMessage(write_pipe, buf, offset);
+    overheadEnd(STAGE_WRITE, stage);
+}
@@ -0,0 +1,11 @@
+// Author: Kristi Dodaj
+// perf.h: Responsible for defining the hardware performance counter collector (see perf.c)
+
+#ifndef PERF
+#define PERF
+
+// define the function signatures
+
+void getPerfCounters(int write_pipe);
+
+#endif /* PERF */
@@ -0,0 +1,610 @@
+// Author: Kristi Dodaj
+// procbatch.c: Responsible for reading one small file (ex. statm) of every process per sample without an openat, read and close for
+// each of them. The file of every known pid is opened once and kept open, registered with an io_uring, and all the reads of a sample
+// are submitted in batches of PROCBATCH_RING with a single io_uring_enter() each. When io_uring is unavailable (old kernel, seccomp,
+// kernel.io_uring_disabled) the kept files are read with one pread() each on the /proc scan workers instead.
+
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+#include "procbatch.h"
+#include "procscan.h"
+
+// the io_uring of a batch: its rings mapped into memory and the table of registered files
+struct procRing
+{
+    int fd;
+    void *sqMap, *cqMap, *sqesMap; // the three mappings (cqMap is sqMap with IORING_FEAT_SINGLE_MMAP)
+    size_t sqSize, cqSize, sqesSize;
+    unsigned *sqHead, *sqTail, *sqMask, *sqArray;
+    struct io_uring_sqe *sqes;
+    unsigned *cqHead, *cqTail, *cqMask;
+    struct io_uring_cqe *cqes;
+
+    bool registered;    // the files are registered (IOSQE_FIXED_FILE), otherwise the plain fds are used
+    int *slotFds;       // the registered table, -1 for a free slot
+    int slotCount;
+    int *freeSlots;     // stack of the free slots
+    int freeCount;
+    int changedLow;     // the range of slots changed since the table was last updated (changedLow > changedHigh when none)
+    int changedHigh;
+};
+
+static struct procRing *ringSetup()
+{
+    // This function creates the io_uring and maps its rings, or returns NULL if io_uring cannot be used
+
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    int fd = syscall(__NR_io_uring_setup, PROCBATCH_RING, &params);
+    if (fd == -1)
+    {
+        return NULL;
+    }
+
+    size_t sqSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    size_t cqSize = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    if (params.features & IORING_FEAT_SINGLE_MMAP)
+    {
+        sqSize = cqSize = sqSize > cqSize ? sqSize : cqSize;
+    }
+
+    char *sq = mmap(NULL, sqSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+    char *cq = (params.features & IORING_FEAT_SINGLE_MMAP) ? sq : mmap(NULL, cqSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+    size_t sqesSize = params.sq_entries * sizeof(struct io_uring_sqe);
+    struct io_uring_sqe *sqes = mmap(NULL, sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+    struct procRing *ring = calloc(1, sizeof(struct procRing));
+    if (sq == MAP_FAILED || cq == MAP_FAILED || sqes == MAP_FAILED || !ring)
+    {
+        if (sqes != MAP_FAILED)
+        {
+            munmap(sqes, sqesSize);
+        }
+        if (cq != MAP_FAILED && cq != sq)
+        {
+            munmap(cq, cqSize);
+        }
+        if (sq != MAP_FAILED)
+        {
+            munmap(sq, sqSize);
+        }
+        close(fd);
+        free(ring);
+        return NULL;
+    }
+
+    ring->fd = fd;
+    ring->sqMap = sq;
+    ring->sqSize = sqSize;
+    ring->cqMap = cq;
+    ring->cqSize = cqSize;
+    ring->sqesMap = sqes;
+    ring->sqesSize = sqesSize;
+    ring->sqHead = (unsigned *)(sq + params.sq_off.head);
+    ring->sqTail = (unsigned *)(sq + params.sq_off.tail);
+    ring->sqMask = (unsigned *)(sq + params.sq_off.ring_mask);
+    ring->sqArray = (unsigned *)(sq + params.sq_off.array);
+    ring->sqes = sqes;
+    ring->cqHead = (unsigned *)(cq + params.cq_off.head);
+    ring->cqTail = (unsigned *)(cq + params.cq_off.tail);
+    ring->cqMask = (unsigned *)(cq + params.cq_off.ring_mask);
+    ring->cqes = (struct io_uring_cqe *)(cq + params.cq_off.cqes);
+    ring->registered = true;
+    ring->changedLow = 0;
+    ring->changedHigh = -1;
+
+    return ring;
+}
+
+static void ringClose(struct procRing *ring)
+{
+    // This function tears an io_uring down: the registered files are unregistered (the table holds a reference to each of them),
+    // the rings are unmapped and the io_uring is closed. The kept files themselves stay open for pread().
+
+    if (ring->registered && ring->slotCount > 0)
+    {
+        syscall(__NR_io_uring_register, ring->fd, IORING_UNREGISTER_FILES, NULL, 0);
+    }
+    munmap(ring->sqesMap, ring->sqesSize);
+    if (ring->cqMap != ring->sqMap)
+    {
+        munmap(ring->cqMap, ring->cqSize);
+    }
+    munmap(ring->sqMap, ring->sqSize);
+    close(ring->fd);
+    free(ring->slotFds);
+    free(ring->freeSlots);
+    free(ring);
+}
+
+static int ringGrowSlots(struct procRing *ring, int needed)
+{
+    // This function makes room for needed registered files by registering a larger (sparse) table and returns the system calls it
+    // made. If the kernel refuses the plain fds are used from then on.
+
+    int count = ring->slotCount == 0 ? 1024 : ring->slotCount;
+    while (count < needed)
+    {
+        count *= 2;
+    }
+
+    int *slotFds = realloc(ring->slotFds, count * sizeof(int));
+    int *freeSlots = realloc(ring->freeSlots, count * sizeof(int));
+    if (!slotFds || !freeSlots)
+    {
+        perror("Error allocating memory");
+        exit(EXIT_FAILURE);
+    }
+    ring->slotFds = slotFds;
+    ring->freeSlots = freeSlots;
+
+    // the new slots are free, the lowest ones on top of the stack
+    for (int slot = count - 1; slot >= ring->slotCount; slot--)
+    {
+        ring->slotFds[slot] = -1;
+        ring->freeSlots[ring->freeCount++] = slot;
+    }
+
+    int calls = 1;
+    if (ring->slotCount > 0)
+    {
+        syscall(__NR_io_uring_register, ring->fd, IORING_UNREGISTER_FILES, NULL, 0);
+        calls++;
+    }
+    ring->slotCount = count;
+    ring->changedLow = count; // the whole table was just registered, nothing is pending
+    ring->changedHigh = -1;
+
+    if (syscall(__NR_io_uring_register, ring->fd, IORING_REGISTER_FILES, ring->slotFds, count) == -1)
+    {
+        ring->registered = false;
+    }
+    return calls;
+}
+
+static int ringUpdateSlots(struct procRing *ring)
+{
+    // This function tells the kernel about the slots that changed since the last sample, with one call for the whole range, and
+    // returns the system calls it made
+
+    if (!ring->registered || ring->changedLow > ring->changedHigh)
+    {
+        return 0;
+    }
+
+    struct io_uring_files_update update = {.offset = ring->changedLow, .fds = (unsigned long)(ring->slotFds + ring->changedLow)};
+    if (syscall(__NR_io_uring_register, ring->fd, IORING_REGISTER_FILES_UPDATE, &update, ring->changedHigh - ring->changedLow + 1) == -1)
+    {
+        ring->registered = false;
+    }
+    ring->changedLow = ring->slotCount;
+    ring->changedHigh = -1;
+    return 1;
+}
+
+static void markChanged(struct procRing *ring, int slot)
+{
+    if (slot < ring->changedLow)
+    {
+        ring->changedLow = slot;
+    }
+    if (slot > ring->changedHigh)
+    {
+        ring->changedHigh = slot;
+    }
+}
+
+static void entryOpen(struct procBatch *batch, struct procBatchEntry *entry)
+{
+    // This function opens the file of a process that is new (or whose file could not be read) and registers it
+
+    char path[64];
+    snprintf(path, sizeof(path), "/proc/%d/%s", entry->pid, batch->file);
+    entry->fd = open(path, O_RDONLY | O_CLOEXEC);
+    entry->slot = -1;
+    batch->syscalls++;
+
+    struct procRing *ring = batch->ring;
+    if (entry->fd != -1 && ring != NULL && ring->registered)
+    {
+        if (ring->freeCount == 0)
+        {
+            batch->syscalls += ringGrowSlots(ring, ring->slotCount + 1);
+        }
+        if (ring->registered)
+        {
+            entry->slot = ring->freeSlots[--ring->freeCount];
+            ring->slotFds[entry->slot] = entry->fd;
+            markChanged(ring, entry->slot);
+        }
+    }
+}
+
+static void entryClose(struct procBatch *batch, struct procBatchEntry *entry)
+{
+    // This function closes the file of a process that exited and frees its registered slot
+
+    struct procRing *ring = batch->ring;
+    if (entry->slot != -1 && ring != NULL && ring->registered)
+    {
+        ring->slotFds[entry->slot] = -1;
+        ring->freeSlots[ring->freeCount++] = entry->slot;
+        markChanged(ring, entry->slot);
+    }
+    if (entry->fd != -1)
+    {
+        close(entry->fd);
+        batch->syscalls++;
+    }
+    entry->fd = -1;
+    entry->slot = -1;
+}
+
+void procBatchInit(struct procBatch *batch, const char *file, int bufferSize)
+{
+    // This function prepares a batch that reads /proc/[pid]/file (at most bufferSize - 1 bytes of it) for every process. It sets up
+    // the io_uring when it is available and raises the limit of open files to the hard limit, since one file stays open per process.
+    // Example Output:
+    // procBatchInit(&batch, "statm", 128) reads /proc/[pid]/statm of every process on each procBatchRead(&batch)
+
+    memset(batch, 0, sizeof(*batch));
+    batch->file = file;
+    batch->bufferSize = bufferSize;
+    batch->ring = ringSetup();
+
+    struct rlimit limit;
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < limit.rlim_max)
+    {
+        limit.rlim_cur = limit.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &limit);
+    }
+}
+
+bool procBatchUsesUring(const struct procBatch *batch)
+{
+    // This function returns true if the batch reads through io_uring, false if it fell back to pread()
+    return batch->ring != NULL;
+}
+
+static void ensureCapacity(struct procBatch *batch, int count)
+{
+    // This function grows the arrays of the batch to count processes (they never shrink)
+
+    if (count <= batch->capacity)
+    {
+        return;
+    }
+
+    int capacity = batch->capacity == 0 ? 1024 : batch->capacity;
+    while (capacity < count)
+    {
+        capacity *= 2;
+    }
+
+    batch->entries = realloc(batch->entries, capacity * sizeof(struct procBatchEntry));
+    batch->spare = realloc(batch->spare, capacity * sizeof(struct procBatchEntry));
+    batch->buffers = realloc(batch->buffers, (size_t)capacity * batch->bufferSize);
+    batch->vectors = realloc(batch->vectors, capacity * sizeof(struct iovec));
+    if (!batch->entries || !batch->spare || !batch->buffers || !batch->vectors)
+    {
+        perror("Error allocating memory");
+        exit(EXIT_FAILURE);
+    }
+    batch->capacity = capacity;
+}
+
+static void syncPids(struct procBatch *batch)
+{
+    // This function brings the entries in line with the processes in /proc: both lists are sorted by pid, so one merge keeps the
+    // open file of every known process, opens the new ones and closes the ones that exited. With a budget nothing is opened here,
+    // only the files of the entries read this sample are (see openWindow()).
+
+    int count;
+    const int *pids = procScanList(&count);
+    ensureCapacity(batch, count);
+
+    struct procBatchEntry *old = batch->entries;
+    int i = 0;
+    for (int j = 0; j < count; j++)
+    {
+        while (i < batch->count && old[i].pid < pids[j])
+        {
+            entryClose(batch, &old[i++]);
+        }
+
+        struct procBatchEntry *entry = &batch->spare[j];
+        if (i < batch->count && old[i].pid == pids[j])
+        {
+            *entry = old[i++];
+            if (entry->fd == -1 && batch->budget == 0)
+            {
+                entryOpen(batch, entry);
+            }
+        }
+        else
+        {
+            entry->pid = pids[j];
+            entry->fd = -1;
+            entry->slot = -1;
+            if (batch->budget == 0)
+            {
+                entryOpen(batch, entry);
+            }
+        }
+    }
+    while (i < batch->count)
+    {
+        entryClose(batch, &old[i++]);
+    }
+
+    // the rebuilt list becomes the entries, the old one is reused next sample
+    struct procBatchEntry *rebuilt = batch->spare;
+    batch->spare = batch->entries;
+    batch->entries = rebuilt;
+    batch->count = count;
+}
+
+static int windowIndex(const struct procBatch *batch, int position)
+{
+    // the entry at position of the entries read this sample
+    int index = batch->first + position;
+    return index < batch->count ? index : index - batch->count;
+}
+
+static void openWindow(struct procBatch *batch)
+{
+    // This function opens the files of the entries read this sample that are not open yet, and with a budget closes the ones the
+    // next sample does not read, so at most budget files are kept open and opened per sample however many processes there are
+
+    if (batch->budget > 0)
+    {
+        for (int i = 0; i < batch->reads; i++)
+        {
+            struct procBatchEntry *entry = &batch->entries[windowIndex(batch, i)];
+            if (entry->fd == -1)
+            {
+                entryOpen(batch, entry);
+            }
+        }
+    }
+
+    if (batch->ring != NULL)
+    {
+        batch->syscalls += ringUpdateSlots(batch->ring);
+    }
+}
+
+static void closeOutsideWindow(struct procBatch *batch)
+{
+    // This function closes the kept files of the entries the next sample does not read (only with a budget smaller than the
+    // number of processes, the next sample starts where this one stopped)
+
+    if (batch->budget == 0 || batch->reads == batch->count)
+    {
+        return;
+    }
+
+    int nextFirst = windowIndex(batch, batch->reads);
+    for (int i = 0; i < batch->count; i++)
+    {
+        struct procBatchEntry *entry = &batch->entries[i];
+        if (entry->fd != -1 && (i - nextFirst + batch->count) % batch->count >= batch->budget)
+        {
+            entryClose(batch, entry);
+        }
+    }
+}
+
+static void readEntry(int position, int worker, void *context)
+{
+    // This function reads the file of one process with pread() from offset 0 (the fallback without io_uring). A process whose file
+    // could not be kept open (ex. the open file limit was reached) is read with an open, read and close.
+
+    struct procBatch *batch = context;
+    struct procBatchEntry *entry = &batch->entries[windowIndex(batch, position)];
+
+    if (entry->fd != -1)
+    {
+        entry->length = pread(entry->fd, entry->text, batch->bufferSize - 1, 0);
+        return;
+    }
+
+    char path[64];
+    snprintf(path, sizeof(path), "/proc/%d/%s", entry->pid, batch->file);
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    entry->length = fd != -1 ? pread(fd, entry->text, batch->bufferSize - 1, 0) : -1;
+    if (fd != -1)
+    {
+        close(fd);
+    }
+}
+
+static bool ringRead(struct procBatch *batch)
+{
+    // This function submits the reads of every kept file in batches of PROCBATCH_RING, each with a single io_uring_enter() that
+    // also waits for all of its completions, and stores the results in the entries. It returns false if the io_uring failed.
+
+    struct procRing *ring = batch->ring;
+    unsigned mask = *ring->sqMask;
+    int position = 0;
+
+    while (position < batch->reads)
+    {
+        unsigned tail = *ring->sqTail;
+        int submitted = 0;
+
+        for (; position < batch->reads && submitted < PROCBATCH_RING; position++)
+        {
+            int next = windowIndex(batch, position);
+            struct procBatchEntry *entry = &batch->entries[next];
+            if (entry->fd == -1)
+            {
+                continue;
+            }
+
+            struct io_uring_sqe *sqe = &ring->sqes[tail & mask];
+            memset(sqe, 0, sizeof(*sqe));
+            sqe->opcode = IORING_OP_READV;
+            if (entry->slot != -1 && ring->registered)
+            {
+                sqe->fd = entry->slot;
+                sqe->flags = IOSQE_FIXED_FILE;
+            }
+            else
+            {
+                sqe->fd = entry->fd;
+            }
+            sqe->addr = (unsigned long)&batch->vectors[next];
+            sqe->len = 1;
+            sqe->off = 0;
+            sqe->user_data = next;
+            ring->sqArray[tail & mask] = tail & mask;
+            tail++;
+            submitted++;
+        }
+
+        if (submitted == 0)
+        {
+            break;
+        }
+        __atomic_store_n(ring->sqTail, tail, __ATOMIC_RELEASE);
+
+        int result;
+        do
+        {
+            result = syscall(__NR_io_uring_enter, ring->fd, submitted, submitted, IORING_ENTER_GETEVENTS, NULL, 0);
+            batch->syscalls++;
+        } while (result == -1 && errno == EINTR);
+        if (result == -1)
+        {
+            return false;
+        }
+
+        // reap the completions into the entries
+        int reaped = 0;
+        while (reaped < submitted)
+        {
+            unsigned head = *ring->cqHead;
+            unsigned available = __atomic_load_n(ring->cqTail, __ATOMIC_ACQUIRE);
+            if (head == available)
+            {
+                // everything submitted has to complete, wait for the rest
+                result = syscall(__NR_io_uring_enter, ring->fd, 0, submitted - reaped, IORING_ENTER_GETEVENTS, NULL, 0);
+                batch->syscalls++;
+                if (result == -1 && errno != EINTR)
+                {
+                    return false;
+                }
+                continue;
+            }
+            for (; head != available; head++, reaped++)
+            {
+                struct io_uring_cqe *cqe = &ring->cqes[head & *ring->cqMask];
+                batch->entries[cqe->user_data].length = cqe->res;
+            }
+            __atomic_store_n(ring->cqHead, head, __ATOMIC_RELEASE);
+        }
+    }
+
+    return true;
+}
+
+int procBatchRead(struct procBatch *batch)
+{
+    // This function reads the file of every process in /proc into batch->entries and returns how many processes there are. An
+    // entry whose read failed (the process exited, or its pid was reused and the kept file belongs to the old one) has length -1
+    // and its file is opened again on the next sample. With a budget only batch->reads entries from batch->first on are read
+    // (the others have length -1) and the next call goes on from there, and only the files of those entries are opened and kept.
+    // Example Output:
+    // procBatchRead(&batch) returns 31250 after 31 io_uring_enter() calls and sets batch.entries[0].text = "5126 3090 2387 ..."
+
+    batch->syscalls = 0;
+    syncPids(batch);
+
+    // with a budget, read the next budget files from where the previous sample stopped (by pid, since the entries move as
+    // processes come and go)
+    batch->first = 0;
+    batch->reads = batch->count;
+    if (batch->budget > 0 && batch->budget < batch->count)
+    {
+        while (batch->first < batch->count && batch->entries[batch->first].pid < batch->nextPid)
+        {
+            batch->first++;
+        }
+        if (batch->first == batch->count)
+        {
+            batch->first = 0;
+        }
+        batch->reads = batch->budget;
+        batch->nextPid = batch->entries[windowIndex(batch, batch->reads)].pid;
+    }
+
+    openWindow(batch);
+
+    for (int i = 0; i < batch->count; i++)
+    {
+        struct procBatchEntry *entry = &batch->entries[i];
+        entry->text = batch->buffers + (size_t)i * batch->bufferSize;
+        entry->length = -1;
+        batch->vectors[i].iov_base = entry->text;
+        batch->vectors[i].iov_len = batch->bufferSize - 1;
+    }
+
+    if (batch->ring != NULL && !ringRead(batch))
+    {
+        // the io_uring stopped working (ex. it was disabled), read with pread() from now on
+        ringClose(batch->ring);
+        batch->ring = NULL;
+        for (int i = 0; i < batch->count; i++)
+        {
+            batch->entries[i].slot = -1;
+        }
+    }
+
+    if (batch->ring == NULL)
+    {
+        // one pread() per kept file, an open, read and close for the others
+        procScanParallel(batch->reads, readEntry, batch);
+        for (int i = 0; i < batch->reads; i++)
+        {
+            batch->syscalls += batch->entries[windowIndex(batch, i)].fd != -1 ? 1 : 3;
+        }
+    }
+    else
+    {
+        // the processes without a kept file were not in the io_uring batch
+        for (int i = 0; i < batch->reads; i++)
+        {
+            if (batch->entries[windowIndex(batch, i)].fd == -1)
+            {
+                readEntry(i, 0, batch);
+                batch->syscalls += 3;
+            }
+        }
+    }
+
+    for (int i = 0; i < batch->reads; i++)
+    {
+        struct procBatchEntry *entry = &batch->entries[windowIndex(batch, i)];
+        if (entry->length >= 0)
+        {
+            entry->text[entry->length] = '\0';
+        }
+        else if (entry->fd != -1)
+        {
+            // reopened next sample (ESRCH: the process of this file is gone)
+            entryClose(batch, entry);
+        }
+    }
+    closeOutsideWindow(batch);
+
+    return batch->count;
+}
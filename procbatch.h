@@ -0,0 +1,51 @@
+// Author: Kristi Dodaj
+// procbatch.h: Responsible for defining the batched reader of one small file of every process (see procbatch.c)
+
+#include <stdbool.h>
+#include <sys/uio.h>
+
+#ifndef PROCBATCH
+#define PROCBATCH
+
+// the reads submitted to the kernel with one io_uring_enter()
+#define PROCBATCH_RING 1024
+
+// one process whose file is read by the batch
+struct procBatchEntry
+{
+    int pid;
+    int fd;       // kept open between samples (-1 when it could not be opened)
+    int slot;     // index of fd in the files registered with io_uring (-1 when not registered)
+    int length;   // bytes read in the last sample, -1 if the read failed (ex. the process exited)
+    char *text;   // the contents of the last read, null terminated (valid until the next procBatchRead())
+};
+
+struct procRing;
+
+// the same file (ex. statm) of every process, read once per sample
+struct procBatch
+{
+    const char *file;               // the name of the file in /proc/[pid]
+    int bufferSize;                 // bytes read per process
+    struct procBatchEntry *entries; // sorted by pid
+    int count;
+    int capacity;
+    struct procBatchEntry *spare;   // the entries are rebuilt into spare and swapped, so a sample does not allocate
+    char *buffers;                  // capacity buffers of bufferSize bytes
+    struct iovec *vectors;          // one per entry, for IORING_OP_READV
+    struct procRing *ring;          // NULL when io_uring is unavailable
+    long syscalls;                  // system calls made by the last procBatchRead(), opening and closing the kept files included
+                                    // (not counting the pid listing)
+    int budget;                     // the most files read per sample, 0 for all of them (the others are read on later samples in turn)
+    int first;                      // the entries read by the last procBatchRead(): reads of them from first on, wrapping around
+    int reads;
+    int nextPid;                    // the pid the next budgeted read starts at
+};
+
+// define the function signatures
+
+void procBatchInit(struct procBatch *batch, const char *file, int bufferSize);
+int procBatchRead(struct procBatch *batch);
+bool procBatchUsesUring(const struct procBatch *batch);
+
+#endif /* PROCBATCH */
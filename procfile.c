@@ -0,0 +1,103 @@
+// Author: Kristi Dodaj
+// procfile.c: Responsible for reading /proc and /sys files through file descriptors that stay open for the whole run, so every
+// sample costs only the pread() calls of each file instead of an open, read and close
+
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include "procfile.h"
+#include "overhead.h"
+
+// the buffer every file starts with, doubled whenever a file does not fit
+#define PROCFILE_INITIAL_SIZE 4096
+
+bool procFileOpen(struct procFile *file, const char *path)
+{
+    // This function opens the file at path once and returns false if it cannot be opened (the collector then shows it as
+    // unavailable rather than failing)
+    // Example Output:
+    // procFileOpen(&file, "/proc/vmstat") returns true
+
+    file->path = path;
+    file->length = 0;
+    file->size = PROCFILE_INITIAL_SIZE;
+    file->buffer = malloc(file->size);
+    if (!file->buffer)
+    {
+        perror("Error allocating memory");
+        exit(EXIT_FAILURE);
+    }
+    file->buffer[0] = '\0';
+
+    file->fd = open(path, O_RDONLY | O_CLOEXEC);
+    return file->fd != -1;
+}
+
+const char *procFileRead(struct procFile *file)
+{
+    // This function reads the whole file again from the start with pread() and returns its contents (null terminated), or NULL
+    // if it could not be read. The buffer is kept between calls and only grows when the file does not fit into it.
+    // NOTE: Most of these files are generated on every read, so reading from offset 0 always gives the current values. Files with
+    // one record per line (seq_file) return about a page per pread() however large the buffer is, so the file is only complete
+    // once a pread() returns 0.
+    // Example Output:
+    // procFileRead(&file) returns "numa_hit 1108805\nnuma_miss 0\n..."
+
+    if (file->fd == -1)
+    {
+        return NULL;
+    }
+
+    long long stage = overheadBegin();
+    int length = 0;
+    while (1)
+    {
+        if (length == file->size - 1)
+        {
+            // the file did not fit, so keep reading into a buffer twice the size
+            char *larger = realloc(file->buffer, file->size * 2);
+            if (!larger)
+            {
+                perror("Error allocating memory");
+                exit(EXIT_FAILURE);
+            }
+            file->buffer = larger;
+            file->size *= 2;
+        }
+
+        ssize_t read = pread(file->fd, file->buffer + length, file->size - 1 - length, length);
+        if (read < 0)
+        {
+            // error checking for system resources
+            perror("pread: Failed to read a /proc file");
+            overheadEnd(STAGE_READ, stage);
+            return NULL;
+        }
+        if (read == 0)
+        {
+            break;
+        }
+        length += read;
+    }
+    file->length = length;
+    file->buffer[length] = '\0';
+    overheadEnd(STAGE_READ, stage);
+
+    return file->buffer;
+}
+
+void procFileClose(struct procFile *file)
+{
+    // This function closes the file and frees its buffer
+
+    if (file->fd != -1)
+    {
+        close(file->fd);
+    }
+    free(file->buffer);
+    file->fd = -1;
+    file->buffer = NULL;
+}
@@ -0,0 +1,25 @@
+// Author: Kristi Dodaj
+// procfile.h: Responsible for defining the persistent file reader the collectors use for /proc and /sys files (see procfile.c)
+
+#include <stdbool.h>
+
+#ifndef PROCFILE
+#define PROCFILE
+
+// a /proc or /sys file that stays open between samples and is read again from offset 0 every time
+struct procFile
+{
+    const char *path;
+    int fd;         // -1 when the file could not be opened
+    char *buffer;   // the contents of the last read, null terminated
+    int size;       // bytes allocated for buffer (grows when the file does not fit)
+    int length;     // bytes in buffer from the last read
+};
+
+// define the function signatures
+
+bool procFileOpen(struct procFile *file, const char *path);
+const char *procFileRead(struct procFile *file);
+void procFileClose(struct procFile *file);
+
+#endif /* PROCFILE */
@@ -0,0 +1,329 @@
+// Author: Kristi Dodaj
+// procio.c: Responsible for the optional collector of the processes that do the most I/O. The counters of /proc/[pid]/io are read in
+// one batch (at most PROCIO_READ_BUDGET of them per sample, taking turns on larger hosts with only the files of the turn open),
+// turned into rates against the counters kept from the previous read of each process, and only the busiest ones are picked out
+// with a min-heap instead of sorting them all.
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include "procio.h"
+#include "procscan.h"
+#include "procbatch.h"
+#include "event_loop.h"
+#include "overhead.h"
+#include "stats_functions.h"
+
+// the counters of /proc/[pid]/io since the process started (characters and bytes, system calls)
+struct ioCounters
+{
+    long long rchar;      // read by read() and the like, page cache hits included
+    long long wchar;
+    long long syscr;
+    long long syscw;
+    long long readBytes;  // fetched from the storage layer
+    long long writeBytes; // sent to the storage layer
+    bool valid;           // read and parsed this sample
+};
+
+// a process followed between samples, its rates are per second between its two last reads
+struct ioProcess
+{
+    int pid;
+    struct ioCounters counters;
+    long long readTime; // ns of the last read, 0 for never
+    long readSample;
+    bool measured;      // the rates below are set (the process was read twice)
+    double rchar, wchar, syscr, syscw, readBytes, writeBytes;
+};
+
+static struct procBatch io; // /proc/[pid]/io of every process, kept open and read in one batch
+static bool ioReady = false;
+static struct ioCounters *parsed = NULL;   // one per batch entry
+static struct ioProcess *known = NULL;     // sorted by pid, one per batch entry of the previous sample
+static struct ioProcess *spare = NULL;     // the known processes are rebuilt into spare and swapped, like the batch entries
+static int knownCount = 0;
+static int capacity = 0;
+static long sample = 0;
+
+static void ensureCapacity(int count)
+{
+    // This function grows the arrays to count processes (they never shrink)
+
+    if (count <= capacity)
+    {
+        return;
+    }
+    while (capacity < count)
+    {
+        capacity = capacity == 0 ? 1024 : capacity * 2;
+    }
+
+    parsed = realloc(parsed, capacity * sizeof(struct ioCounters));
+    known = realloc(known, capacity * sizeof(struct ioProcess));
+    spare = realloc(spare, capacity * sizeof(struct ioProcess));
+    if (!parsed || !known || !spare)
+    {
+        perror("Error allocating memory");
+        exit(EXIT_FAILURE);
+    }
+}
+
+static void parseIo(int index, int worker, void *context)
+{
+    // This function takes the counters of one process out of the io text read by the batch
+
+    struct procBatchEntry *entry = &io.entries[index];
+    struct ioCounters *counters = &parsed[index];
+
+    // io: rchar, wchar, syscr, syscw, read_bytes, write_bytes, cancelled_write_bytes (one "name: value" per line)
+    counters->valid = entry->length > 0 && sscanf(entry->text, "rchar: %lld wchar: %lld syscr: %lld syscw: %lld read_bytes: %lld write_bytes: %lld", &counters->rchar, &counters->wchar, &counters->syscr, &counters->syscw, &counters->readBytes, &counters->writeBytes) == 6;
+}
+
+static bool busier(const struct ioProcess *first, const struct ioProcess *second)
+{
+    // This function returns true if first did more I/O than second: storage bytes first, the characters read and written when
+    // those are equal (ex. both only hit the page cache)
+
+    double a = first->readBytes + first->writeBytes;
+    double b = second->readBytes + second->writeBytes;
+    if (a != b)
+    {
+        return a > b;
+    }
+    return first->rchar + first->wchar > second->rchar + second->wchar;
+}
+
+static void heapInsert(struct ioProcess **heap, int *size, struct ioProcess *entry)
+{
+    // This function keeps the PROCIO_SHOWN busiest processes in a min-heap (the least busy at heap[0])
+
+    int i;
+    if (*size < PROCIO_SHOWN)
+    {
+        i = (*size)++;
+        while (i > 0 && busier(heap[(i - 1) / 2], entry))
+        {
+            heap[i] = heap[(i - 1) / 2];
+            i = (i - 1) / 2;
+        }
+        heap[i] = entry;
+        return;
+    }
+
+    if (!busier(entry, heap[0]))
+    {
+        return;
+    }
+
+    // replace the least busy and sift it down
+    i = 0;
+    while (2 * i + 1 < *size)
+    {
+        int child = 2 * i + 1;
+        if (child + 1 < *size && busier(heap[child], heap[child + 1]))
+        {
+            child++;
+        }
+        if (!busier(entry, heap[child]))
+        {
+            break;
+        }
+        heap[i] = heap[child];
+        i = child;
+    }
+    heap[i] = entry;
+}
+
+static int byBusiest(const void *first, const void *second)
+{
+    const struct ioProcess *a = *(struct ioProcess *const *)first;
+    const struct ioProcess *b = *(struct ioProcess *const *)second;
+    return busier(b, a) - busier(a, b);
+}
+
+static void measure(struct ioProcess *process, const struct ioCounters *counters, long long now)
+{
+    // This function sets the rates of a process from its counters read now and the ones of its previous read. A process read for
+    // the first time, or whose counters went back (its pid was reused), is only measured from its next read.
+
+    const struct ioCounters *before = &process->counters;
+    double seconds = (now - process->readTime) / 1e9;
+
+    process->measured = process->readTime > 0 && seconds > 0 && counters->rchar >= before->rchar && counters->wchar >= before->wchar && counters->readBytes >= before->readBytes && counters->writeBytes >= before->writeBytes;
+    if (process->measured)
+    {
+        process->rchar = (counters->rchar - before->rchar) / seconds;
+        process->wchar = (counters->wchar - before->wchar) / seconds;
+        process->syscr = (counters->syscr - before->syscr) / seconds;
+        process->syscw = (counters->syscw - before->syscw) / seconds;
+        process->readBytes = (counters->readBytes - before->readBytes) / seconds;
+        process->writeBytes = (counters->writeBytes - before->writeBytes) / seconds;
+    }
+
+    process->counters = *counters;
+    process->readTime = now;
+    process->readSample = sample;
+}
+
+void getIoConsumers(int write_pipe)
+{
+    // This function writes the PROCIO_SHOWN processes that did the most I/O to the write_pipe, ranked by the bytes they read from
+    // and wrote to storage per second (then by the characters read and written, which include the page cache), with their read
+    // and write system calls per second. At most PROCIO_READ_BUDGET processes are read per sample, taking turns, so on a larger
+    // host a process keeps the rate of its previous read (marked *) until its turn comes again. In graphics mode each line ends
+    // with a bar of the share of the storage I/O of all processes, one # per 5 %.
+    // NOTE: /proc/[pid]/io of another user's process needs the same permission as ptrace, without it the process is not ranked
+    // Example Output:
+    // getIoConsumers(write_pipe) writes
+    //
+    //     PID  COMMAND              READ/s      WRITE/s      RCHAR/s      WCHAR/s  SYSCR/s  SYSCW/s
+    //    1734  postgres            12.4 MB      80.0 MB      14.1 MB      80.2 MB     1210     9840
+    //     912  jbd2/nvme0n1p2       0.0 MB       6.2 MB       0.0 MB       0.0 MB        0        0*
+    // 31250 processes -- 4096 io files read with io_uring (5 syscalls), 12 could not be read (* rate from an earlier sample)
+
+    sample++;
+    if (!ioReady)
+    {
+        procBatchInit(&io, "io", 256);
+        io.budget = PROCIO_READ_BUDGET;
+        ioReady = true;
+    }
+
+    long long stage = overheadBegin();
+    procBatchRead(&io);
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    long long now = time.tv_sec * 1000000000LL + time.tv_nsec;
+    overheadEnd(STAGE_READ, stage);
+
+    stage = overheadBegin();
+    ensureCapacity(io.count);
+    procScanParallel(io.count, parseIo, NULL);
+    overheadEnd(STAGE_PARSE, stage);
+
+    // both the known processes and the entries are sorted by pid, so one merge finds the previous counters of every process
+    stage = overheadBegin();
+    struct ioProcess *busiest[PROCIO_SHOWN];
+    int busiestCount = 0;
+    int unreadable = 0;
+    double totalBytes = 0;
+    int j = 0;
+    for (int i = 0; i < io.count; i++)
+    {
+        int pid = io.entries[i].pid;
+        while (j < knownCount && known[j].pid < pid)
+        {
+            j++;
+        }
+
+        struct ioProcess *process = &spare[i];
+        if (j < knownCount && known[j].pid == pid)
+        {
+            *process = known[j++];
+        }
+        else
+        {
+            memset(process, 0, sizeof(*process));
+            process->pid = pid;
+        }
+
+        if (parsed[i].valid)
+        {
+            measure(process, &parsed[i], now);
+        }
+        else if (io.entries[i].length < 0 && (i - io.first + io.count) % io.count < io.reads)
+        {
+            // its turn came but the file could not be read (exited, or no permission)
+            unreadable++;
+        }
+
+        if (process->measured)
+        {
+            totalBytes += process->readBytes + process->writeBytes;
+            heapInsert(busiest, &busiestCount, process);
+        }
+    }
+
+    struct ioProcess *rebuilt = spare;
+    spare = known;
+    known = rebuilt;
+    knownCount = io.count;
+
+    qsort(busiest, busiestCount, sizeof(struct ioProcess *), byBusiest);
+    overheadEnd(STAGE_COMPUTE, stage);
+
+    char buf[COLLECTOR_BUFFER];
+    int offset = 0;
+
+    if (io.count == 0)
+    {
+        offset = snprintf(buf, sizeof(buf), "(/proc cannot be read)\n");
+        sendMessage(write_pipe, buf, offset);
+        return;
+    }
+
+    stage = overheadBegin();
+    if (busiestCount == 0)
+    {
+        offset += snprintf(buf + offset, sizeof(buf) - offset, "(the rates are shown once a process was read twice)\n");
+    }
+    else
+    {
+        offset += snprintf(buf + offset, sizeof(buf) - offset, "    PID  COMMAND              READ/s      WRITE/s      RCHAR/s      WCHAR/s  SYSCR/s  SYSCW/s\n");
+    }
+
+    for (int i = 0; i < busiestCount; i++)
+    {
+        struct ioProcess *process = busiest[i];
+
+        char path[64], name[16];
+        snprintf(path, sizeof(path), "/proc/%d/comm", process->pid);
+        int fd = open(path, O_RDONLY | O_CLOEXEC);
+        ssize_t length = fd != -1 ? read(fd, name, sizeof(name) - 1) : -1;
+        if (fd != -1)
+        {
+            close(fd);
+        }
+        if (length <= 0)
+        {
+            strcpy(name, "?");
+        }
+        else
+        {
+            name[length] = '\0';
+            name[strcspn(name, "\n")] = '\0';
+        }
+
+        const char *stale = process->readSample != sample ? "*" : " ";
+        offset += snprintf(buf + offset, sizeof(buf) - offset, "%7d  %-15s %8.1f MB  %8.1f MB  %8.1f MB  %8.1f MB %8.0f %8.0f%s", process->pid, name, process->readBytes / 1048576, process->writeBytes / 1048576, process->rchar / 1048576, process->wchar / 1048576, process->syscr, process->syscw, stale);
+
+        if (graphicOutput())
+        {
+            int bars = totalBytes > 0 ? (int)((process->readBytes + process->writeBytes) / totalBytes * 20 + 0.5) : 0;
+            offset += snprintf(buf + offset, sizeof(buf) - offset, "  [");
+            for (int bar = 0; bar < 20; bar++)
+            {
+                buf[offset++] = bar < bars ? '#' : '.';
+            }
+            buf[offset++] = ']';
+        }
+        buf[offset++] = '\n';
+    }
+
+    offset += snprintf(buf + offset, sizeof(buf) - offset, "%d processes -- %d io files read with %s (%ld syscalls)", io.count, io.reads, procBatchUsesUring(&io) ? "io_uring" : "pread", io.syscalls);
+    if (unreadable > 0)
+    {
+        offset += snprintf(buf + offset, sizeof(buf) - offset, ", %d could not be read", unreadable);
+    }
+    offset += snprintf(buf + offset, sizeof(buf) - offset, " (* rate from an earlier sample)\n");
+    overheadEnd(STAGE_FORMAT, stage);
+
+    stage = overheadBegin();
+    sendMessage(write_pipe, buf, offset);
+    overheadEnd(STAGE_WRITE, stage);
+}
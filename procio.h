@@ -0,0 +1,17 @@
+// Author: Kristi Dodaj
+// procio.h: Responsible for defining the collector of the processes that do the most I/O (see procio.c)
+
+#ifndef PROCIO
+#define PROCIO
+
+// the processes shown by the panel
+#define PROCIO_SHOWN 10
+
+// the most /proc/[pid]/io files read per sample, the other processes keep the rate of an earlier sample
+#define PROCIO_READ_BUDGET 4096
+
+// define the function signatures
+
+void getIoConsumers(int write_pipe);
+
+#endif /* PROCIO */
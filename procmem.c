@@ -0,0 +1,328 @@
+// Author: Kristi Dodaj
+// procmem.c: Responsible for the optional collector of the processes that use the most memory. Every process is ranked by its RSS
+// from /proc/[pid]/statm, which is cheap (and read for all of them in one batch), and only the largest ones get their PSS and swap from /proc/[pid]/smaps_rollup, which
+// walks the page tables of the process, so the cost stays bounded on hosts with tens of thousands of processes.
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include "procmem.h"
+#include "procscan.h"
+#include "procbatch.h"
+#include "event_loop.h"
+#include "overhead.h"
+#include "stats_functions.h"
+
+// one of the processes with the largest RSS (sizes in kB)
+struct consumer
+{
+    int pid;
+    char name[16];       // from /proc/[pid]/comm
+    long long rss;
+    long long pss;       // -1 until smaps_rollup was read (or when it cannot be read)
+    long long swap;
+    long readSample;     // the sample smaps_rollup was last read in (0 for never)
+};
+
+// what one worker of the /proc scan found, merged into the candidates once the scan is done (see procscan.c)
+struct workerResult
+{
+    struct consumer heap[PROCMEM_CANDIDATES];
+    int count;
+    int processes;
+} __attribute__((aligned(64)));
+
+static struct workerResult results[PROCSCAN_MAX_WORKERS];
+static struct consumer known[PROCMEM_CANDIDATES]; // the candidates of the previous sample, to keep their PSS
+static int knownCount = 0;
+static long sample = 0;
+static struct procBatch statm; // /proc/[pid]/statm of every process, kept open and read in one batch
+static bool statmReady = false;
+
+static int readSmall(const char *path, char *buf, int size)
+{
+    // This function reads a small /proc file whole into buf (null terminated) and returns its length, or -1 if it cannot be read
+    // (ex. the process exited in between)
+
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd == -1)
+    {
+        return -1;
+    }
+    ssize_t length = read(fd, buf, size - 1);
+    close(fd);
+    if (length < 0)
+    {
+        return -1;
+    }
+    buf[length] = '\0';
+    return length;
+}
+
+static long long rollupValue(const char *text, const char *name)
+{
+    // This function returns the kB value of a field of smaps_rollup, or 0 if it is not there
+    // Example Output:
+    // rollupValue("...Pss:               12340 kB\n...", "\nPss:") returns 12340
+
+    const char *field = strstr(text, name);
+    return field != NULL ? strtoll(field + strlen(name), NULL, 10) : 0;
+}
+
+static void heapInsert(struct consumer *heap, int *size, struct consumer entry)
+{
+    // This function keeps the PROCMEM_CANDIDATES processes with the largest RSS in a min-heap (smallest RSS at heap[0]), so the
+    // whole scan is a comparison with heap[0] for most processes
+
+    int i;
+    if (*size < PROCMEM_CANDIDATES)
+    {
+        i = (*size)++;
+        while (i > 0 && heap[(i - 1) / 2].rss > entry.rss)
+        {
+            heap[i] = heap[(i - 1) / 2];
+            i = (i - 1) / 2;
+        }
+        heap[i] = entry;
+        return;
+    }
+
+    if (entry.rss <= heap[0].rss)
+    {
+        return;
+    }
+
+    // replace the smallest and sift it down
+    i = 0;
+    while (2 * i + 1 < *size)
+    {
+        int child = 2 * i + 1;
+        if (child + 1 < *size && heap[child + 1].rss < heap[child].rss)
+        {
+            child++;
+        }
+        if (heap[child].rss >= entry.rss)
+        {
+            break;
+        }
+        heap[i] = heap[child];
+        i = child;
+    }
+    heap[i] = entry;
+}
+
+static int byOldestRead(const void *first, const void *second)
+{
+    long a = ((const struct consumer *)first)->readSample;
+    long b = ((const struct consumer *)second)->readSample;
+    return (a > b) - (a < b);
+}
+
+static long long rankSize(const struct consumer *consumer)
+{
+    // the PSS once it is known, the RSS until then
+    return consumer->pss >= 0 ? consumer->pss : consumer->rss;
+}
+
+static int byLargest(const void *first, const void *second)
+{
+    long long a = rankSize(first);
+    long long b = rankSize(second);
+    return (a < b) - (a > b);
+}
+
+static void parseStatm(int index, int worker, void *context)
+{
+    // This function takes the RSS of one process from the statm text read by the batch into the heap of the worker that visits it
+
+    struct procBatchEntry *entry = &statm.entries[index];
+    struct workerResult *result = &results[worker];
+    long pageKilobytes = *(long *)context;
+
+    if (entry->length <= 0)
+    {
+        // the process exited since /proc was listed
+        return;
+    }
+    result->processes++;
+
+    // statm: size resident shared text lib data dt (in pages)
+    long long size, resident;
+    if (sscanf(entry->text, "%lld %lld", &size, &resident) != 2 || resident == 0)
+    {
+        // kernel threads have no memory of their own
+        return;
+    }
+
+    struct consumer consumer = {.pid = entry->pid, .rss = resident * pageKilobytes, .pss = -1};
+    heapInsert(result->heap, &result->count, consumer);
+}
+
+static int scanProcesses(struct consumer *candidates, int *count)
+{
+    // This function reads /proc/[pid]/statm of every process in one batch (see procbatch.c), takes the RSS out of each on the scan
+    // workers, merges their heaps into the largest ones in candidates and returns the number of processes seen
+
+    if (!statmReady)
+    {
+        procBatchInit(&statm, "statm", 128);
+        statmReady = true;
+    }
+
+    long pageKilobytes = sysconf(_SC_PAGESIZE) / 1024;
+    int workers = procScanWorkers();
+    for (int i = 0; i < workers; i++)
+    {
+        results[i].count = 0;
+        results[i].processes = 0;
+    }
+
+    long long stage = overheadBegin();
+    procBatchRead(&statm);
+    overheadEnd(STAGE_READ, stage);
+
+    stage = overheadBegin();
+    procScanParallel(statm.count, parseStatm, &pageKilobytes);
+    overheadEnd(STAGE_PARSE, stage);
+
+    stage = overheadBegin();
+    int processes = 0;
+    *count = 0;
+    for (int i = 0; i < workers; i++)
+    {
+        processes += results[i].processes;
+        for (int j = 0; j < results[i].count; j++)
+        {
+            heapInsert(candidates, count, results[i].heap[j]);
+        }
+    }
+    overheadEnd(STAGE_COMPUTE, stage);
+
+    return processes;
+}
+
+void getMemoryConsumers(int write_pipe)
+{
+    // This function writes the PROCMEM_SHOWN processes that use the most memory to the write_pipe, ranked by PSS (proportional set
+    // size: every shared page is divided between the processes that map it, so shared memory is not counted twice). Every process
+    // is ranked by its RSS first; of the PROCMEM_CANDIDATES largest at most PROCMEM_ROLLUP_BUDGET get their smaps_rollup read per
+    // sample (the ones read longest ago first), the others keep the PSS of an earlier sample (marked *). In graphics mode each line
+    // ends with a bar of the PSS as a share of the physical memory, one # per 5 %.
+    // NOTE: smaps_rollup of another user's process needs the same permission as ptrace, without it the PSS is shown as -
+    // Example Output:
+    // getMemoryConsumers(write_pipe) writes
+    //
+    //     PID  COMMAND                RSS          PSS         SWAP
+    //    1734  postgres         2104.5 MB     612.0 MB       0.0 MB
+    //    2210  java              840.2 MB     838.9 MB*     12.4 MB
+    // 31250 processes -- statm read with io_uring (31 syscalls) -- 8 smaps_rollup reads (* PSS from an earlier sample)
+
+    sample++;
+
+    struct consumer candidates[PROCMEM_CANDIDATES];
+    int count;
+    int processes = scanProcesses(candidates, &count);
+
+    char buf[COLLECTOR_BUFFER];
+    int offset = 0;
+
+    if (processes == 0)
+    {
+        offset = snprintf(buf, sizeof(buf), "(/proc cannot be read)\n");
+        sendMessage(write_pipe, buf, offset);
+        return;
+    }
+
+    long long stage = overheadBegin();
+    for (int i = 0; i < count; i++)
+    {
+        struct consumer *candidate = &candidates[i];
+
+        char path[64];
+        snprintf(path, sizeof(path), "/proc/%d/comm", candidate->pid);
+        if (readSmall(path, candidate->name, sizeof(candidate->name)) <= 0)
+        {
+            strcpy(candidate->name, "?");
+        }
+        candidate->name[strcspn(candidate->name, "\n")] = '\0';
+
+        // keep what an earlier sample read for the same process (a reused pid has another name)
+        for (int j = 0; j < knownCount; j++)
+        {
+            if (known[j].pid == candidate->pid && strcmp(known[j].name, candidate->name) == 0)
+            {
+                candidate->pss = known[j].pss;
+                candidate->swap = known[j].swap;
+                candidate->readSample = known[j].readSample;
+            }
+        }
+    }
+
+    // spend the budget on the candidates that were never read or read longest ago
+    qsort(candidates, count, sizeof(struct consumer), byOldestRead);
+    int reads = 0;
+    for (int i = 0; i < count && reads < PROCMEM_ROLLUP_BUDGET; i++)
+    {
+        struct consumer *candidate = &candidates[i];
+
+        char path[64], text[2048];
+        snprintf(path, sizeof(path), "/proc/%d/smaps_rollup", candidate->pid);
+        reads++;
+        candidate->readSample = sample;
+        if (readSmall(path, text, sizeof(text)) <= 0)
+        {
+            candidate->pss = -1;
+            continue;
+        }
+        candidate->pss = rollupValue(text, "\nPss:");
+        candidate->swap = rollupValue(text, "\nSwap:");
+    }
+    overheadEnd(STAGE_READ, stage);
+
+    stage = overheadBegin();
+    memcpy(known, candidates, count * sizeof(struct consumer));
+    knownCount = count;
+    qsort(candidates, count, sizeof(struct consumer), byLargest);
+    overheadEnd(STAGE_COMPUTE, stage);
+
+    stage = overheadBegin();
+    long long physical = sysconf(_SC_PHYS_PAGES) * (sysconf(_SC_PAGESIZE) / 1024);
+    offset += snprintf(buf + offset, sizeof(buf) - offset, "    PID  COMMAND                RSS          PSS         SWAP\n");
+
+    for (int i = 0; i < count && i < PROCMEM_SHOWN; i++)
+    {
+        struct consumer *consumer = &candidates[i];
+        const char *stale = consumer->readSample != sample ? "*" : " ";
+
+        offset += snprintf(buf + offset, sizeof(buf) - offset, "%7d  %-15s %8.1f MB", consumer->pid, consumer->name, consumer->rss / 1024.0);
+        if (consumer->pss >= 0)
+        {
+            offset += snprintf(buf + offset, sizeof(buf) - offset, "  %8.1f MB%s  %8.1f MB", consumer->pss / 1024.0, stale, consumer->swap / 1024.0);
+        }
+        else
+        {
+            offset += snprintf(buf + offset, sizeof(buf) - offset, "         -             -   ");
+        }
+
+        if (graphicOutput())
+        {
+            int bars = physical > 0 ? (int)((float)rankSize(consumer) / physical * 20 + 0.5) : 0;
+            offset += snprintf(buf + offset, sizeof(buf) - offset, "  [");
+            for (int bar = 0; bar < 20; bar++)
+            {
+                buf[offset++] = bar < bars ? '#' : '.';
+            }
+            buf[offset++] = ']';
+        }
+        buf[offset++] = '\n';
+    }
+
+    offset += snprintf(buf + offset, sizeof(buf) - offset, "%d processes -- statm read with %s (%ld syscalls) -- %d smaps_rollup reads (* PSS from an earlier sample)\n", processes, procBatchUsesUring(&statm) ? "io_uring" : "pread", statm.syscalls, reads);
+    overheadEnd(STAGE_FORMAT, stage);
+
+    stage = overheadBegin();
+    sendMessage(write_pipe, buf, offset);
+    overheadEnd(STAGE_WRITE, stage);
+}
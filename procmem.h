@@ -0,0 +1,20 @@
+// Author: Kristi Dodaj
+// procmem.h: Responsible for defining the collector of the processes that use the most memory (see procmem.c)
+
+#ifndef PROCMEM
+#define PROCMEM
+
+// the processes shown by the panel
+#define PROCMEM_SHOWN 10
+
+// the processes with the largest RSS that are considered for the PSS ranking
+#define PROCMEM_CANDIDATES 20
+
+// the most /proc/[pid]/smaps_rollup files read per sample, the other candidates keep the PSS of an earlier sample
+#define PROCMEM_ROLLUP_BUDGET 8
+
+// define the function signatures
+
+void getMemoryConsumers(int write_pipe);
+
+#endif /* PROCMEM */
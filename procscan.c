@@ -0,0 +1,270 @@
+// Author: Kristi Dodaj
+// procscan.c: Responsible for walking every /proc/[pid] directory on a small pool of threads. The pids are listed once per scan and
+// split into one contiguous range per worker; each worker claims PROCSCAN_CHUNK pids at a time from its own range and, once that is
+// done, steals chunks from the ranges of the others, so a few processes that are slow to read never leave the rest of the pool idle.
+
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <sched.h>
+#include <dirent.h>
+#include <pthread.h>
+#include "procscan.h"
+
+// the part of the pid list a worker starts on, on its own cache line since every claim writes next
+struct range
+{
+    int next; // the first pid index not claimed yet (claimed with an atomic add by the owner and the thieves)
+    int end;
+} __attribute__((aligned(64)));
+
+static struct range ranges[PROCSCAN_MAX_WORKERS];
+static int *pids = NULL;
+static int pidCount = 0;
+static int pidCapacity = 0;
+static DIR *proc = NULL;
+
+// the pool, started on the first scan that is large enough (in the collector process, threads do not survive a fork)
+static int workerCount = 0;
+static bool poolStarted = false;
+static pthread_t threads[PROCSCAN_MAX_WORKERS];
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t startScan = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t scanDone = PTHREAD_COND_INITIALIZER;
+static long generation = 0; // incremented for every parallel scan, the workers wait for it to change
+static int busy = 0;        // workers that did not finish the current scan
+
+// the scan that is running
+static int activeWorkers = 1;
+static void (*currentVisit)(int index, int worker, void *context);
+static void *currentContext;
+static void (*currentPidVisit)(int pid, int worker, void *context); // the visit of procScan(), called through visitPid()
+
+int procScanWorkers()
+{
+    // This function returns how many threads a large scan uses: one per cpu the monitor may run on (see --pin), at most
+    // PROCSCAN_MAX_WORKERS
+    // Example Output:
+    // procScanWorkers() returns 8 on a 64 cpu host
+
+    if (workerCount == 0)
+    {
+        cpu_set_t allowed;
+        workerCount = sched_getaffinity(0, sizeof(allowed), &allowed) == 0 ? CPU_COUNT(&allowed) : 1;
+        if (workerCount > PROCSCAN_MAX_WORKERS)
+        {
+            workerCount = PROCSCAN_MAX_WORKERS;
+        }
+        if (workerCount < 1)
+        {
+            workerCount = 1;
+        }
+    }
+    return workerCount;
+}
+
+static int byPid(const void *first, const void *second)
+{
+    return *(const int *)first - *(const int *)second;
+}
+
+const int *procScanList(int *count)
+{
+    // This function lists the pids in /proc, in ascending order, and returns them (valid until the next call). The directory stays
+    // open and the list only grows, so the steady state does not allocate.
+    // Example Output:
+    // procScanList(&count) returns {1, 2, 3, 17, ...} and sets count = 31250
+
+    pidCount = 0;
+    *count = 0;
+    if (proc == NULL)
+    {
+        proc = opendir("/proc");
+        if (proc == NULL)
+        {
+            return pids;
+        }
+    }
+    rewinddir(proc);
+    bool sorted = true;
+
+    struct dirent *entry;
+    while ((entry = readdir(proc)) != NULL)
+    {
+        if (entry->d_name[0] < '1' || entry->d_name[0] > '9')
+        {
+            continue;
+        }
+
+        if (pidCount == pidCapacity)
+        {
+            pidCapacity = pidCapacity == 0 ? 1024 : pidCapacity * 2;
+            pids = realloc(pids, pidCapacity * sizeof(int));
+            if (!pids)
+            {
+                perror("Error allocating memory");
+                exit(EXIT_FAILURE);
+            }
+        }
+        pids[pidCount] = atoi(entry->d_name);
+        if (pidCount > 0 && pids[pidCount] < pids[pidCount - 1])
+        {
+            sorted = false;
+        }
+        pidCount++;
+    }
+
+    // procfs lists the processes by pid already, sorting is only a safety net
+    if (!sorted)
+    {
+        qsort(pids, pidCount, sizeof(int), byPid);
+    }
+
+    *count = pidCount;
+    return pids;
+}
+
+static void scanRanges(int worker)
+{
+    // This function visits chunks of the own range of the worker first, then steals what is left of the other ranges
+
+    for (int k = 0; k < activeWorkers; k++)
+    {
+        struct range *range = &ranges[(worker + k) % activeWorkers];
+
+        int first;
+        while ((first = __atomic_fetch_add(&range->next, PROCSCAN_CHUNK, __ATOMIC_RELAXED)) < range->end)
+        {
+            int last = first + PROCSCAN_CHUNK < range->end ? first + PROCSCAN_CHUNK : range->end;
+            for (int i = first; i < last; i++)
+            {
+                currentVisit(i, worker, currentContext);
+            }
+        }
+    }
+}
+
+static void *workerMain(void *argument)
+{
+    // This function is the loop of every pool thread: wait for the next scan, take part in it, report that it finished
+
+    int worker = (int)(long)argument;
+    long seen = 0;
+
+    while (1)
+    {
+        pthread_mutex_lock(&lock);
+        while (generation == seen)
+        {
+            pthread_cond_wait(&startScan, &lock);
+        }
+        seen = generation;
+        pthread_mutex_unlock(&lock);
+
+        if (worker < activeWorkers)
+        {
+            scanRanges(worker);
+        }
+
+        pthread_mutex_lock(&lock);
+        if (--busy == 0)
+        {
+            pthread_cond_signal(&scanDone);
+        }
+        pthread_mutex_unlock(&lock);
+    }
+
+    return NULL;
+}
+
+static void startPool()
+{
+    // This function starts the pool threads (the calling thread is worker 0). Their stacks are kept small since they only read
+    // small files, which also keeps what --mlock has to lock small.
+
+    pthread_attr_t attributes;
+    pthread_attr_init(&attributes);
+    pthread_attr_setstacksize(&attributes, 256 * 1024);
+
+    for (int i = 1; i < workerCount; i++)
+    {
+        if (pthread_create(&threads[i], &attributes, workerMain, (void *)(long)i) != 0)
+        {
+            // run the scans on the threads that did start
+            perror("pthread_create: Failed to start a /proc scan worker");
+            workerCount = i;
+            break;
+        }
+    }
+
+    pthread_attr_destroy(&attributes);
+    poolStarted = true;
+}
+
+void procScanParallel(int count, void (*visit)(int index, int worker, void *context), void *context)
+{
+    // This function calls visit(index, worker, context) once for every index from 0 to count - 1 on up to procScanWorkers() threads
+    // at the same time. worker (0 to procScanWorkers() - 1) tells visit which thread it runs on so it can write to its own result
+    // buffer without locking; the caller merges the buffers once procScanParallel() returns.
+    // NOTE: Fewer than PROCSCAN_PARALLEL_MIN indexes are visited on the calling thread only
+    // Example Output:
+    // procScanParallel(31250, readStatm, NULL) returns after every index was visited by one of the 8 workers
+
+    currentVisit = visit;
+    currentContext = context;
+    activeWorkers = count >= PROCSCAN_PARALLEL_MIN ? procScanWorkers() : 1;
+    if (activeWorkers > 1 && !poolStarted)
+    {
+        startPool();
+        activeWorkers = workerCount;
+    }
+
+    // one contiguous range of indexes per worker
+    for (int i = 0; i < activeWorkers; i++)
+    {
+        ranges[i].next = (long)count * i / activeWorkers;
+        ranges[i].end = (long)count * (i + 1) / activeWorkers;
+    }
+
+    if (activeWorkers == 1)
+    {
+        scanRanges(0);
+        return;
+    }
+
+    pthread_mutex_lock(&lock);
+    busy = workerCount - 1;
+    generation++;
+    pthread_cond_broadcast(&startScan);
+    pthread_mutex_unlock(&lock);
+
+    scanRanges(0);
+
+    pthread_mutex_lock(&lock);
+    while (busy > 0)
+    {
+        pthread_cond_wait(&scanDone, &lock);
+    }
+    pthread_mutex_unlock(&lock);
+}
+
+static void visitPid(int index, int worker, void *context)
+{
+    currentPidVisit(pids[index], worker, context);
+}
+
+int procScan(void (*visit)(int pid, int worker, void *context), void *context)
+{
+    // This function calls visit(pid, worker, context) once for every process in /proc (see procScanParallel()) and returns how
+    // many there were
+    // Example Output:
+    // procScan(countThreads, &results) returns 31250 after every pid was visited by one of the 8 workers
+
+    int count;
+    procScanList(&count);
+    currentPidVisit = visit;
+    procScanParallel(count, visitPid, context);
+    return count;
+}
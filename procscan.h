@@ -0,0 +1,23 @@
+// Author: Kristi Dodaj
+// procscan.h: Responsible for defining the parallel walk of the /proc/[pid] directories (see procscan.c)
+
+#ifndef PROCSCAN
+#define PROCSCAN
+
+// the most threads a scan runs on (the collector itself is one of them)
+#define PROCSCAN_MAX_WORKERS 8
+
+// below this many processes the scan stays on one thread, starting the others costs more than it saves
+#define PROCSCAN_PARALLEL_MIN 2048
+
+// the pids a worker claims at a time, small enough that a few slow processes cannot hold up the rest of a range
+#define PROCSCAN_CHUNK 32
+
+// define the function signatures
+
+int procScanWorkers();
+const int *procScanList(int *count);
+void procScanParallel(int count, void (*visit)(int index, int worker, void *context), void *context);
+int procScan(void (*visit)(int pid, int worker, void *context), void *context);
+
+#endif /* PROCSCAN */
@@ -0,0 +1,153 @@
+// Author: Kristi Dodaj
+// schedstat.c: Responsible for the run queue latency of every cpu from /proc/schedstat. The cpu usage cannot tell a busy cpu from an
+// overloaded one, the time runnable tasks wait on its run queue before they get a timeslice can: it stays near zero until the cpu
+// has more work than it can run and then grows with the backlog.
+
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "schedstat.h"
+#include "procfile.h"
+#include "topology.h"
+
+// the totals of one cpu at the previous sample
+struct runQueueTotals
+{
+    long long waitNs;
+    long long slices;
+};
+
+static struct procFile schedstat;
+static bool opened = false;
+static struct runQueue *queues = NULL;           // the cpus of the last sample, in the order of the file
+static struct runQueueTotals *previous = NULL;   // indexed by cpu number
+static int queueCapacity = 0;
+static int previousCapacity = 0;
+static long long previousTime = 0; // 0 before the first sample, so it is compared with the boot
+
+static void growPrevious(int cpu)
+{
+    // This function makes room for the totals of cpu (a cpu that comes online later starts from zero, like the first sample)
+
+    if (cpu < previousCapacity)
+    {
+        return;
+    }
+    int capacity = previousCapacity == 0 ? 64 : previousCapacity;
+    while (capacity <= cpu)
+    {
+        capacity *= 2;
+    }
+    previous = realloc(previous, capacity * sizeof(struct runQueueTotals));
+    if (!previous)
+    {
+        perror("Error allocating memory");
+        exit(EXIT_FAILURE);
+    }
+    memset(previous + previousCapacity, 0, (capacity - previousCapacity) * sizeof(struct runQueueTotals));
+    previousCapacity = capacity;
+}
+
+const struct runQueue *runQueueSample(int *count, struct runQueue *total)
+{
+    // This function reads /proc/schedstat and returns the run queue of every cpu since the previous call (count of them), with
+    // the system wide total in total, or NULL if the kernel does not provide it (built without CONFIG_SCHEDSTATS)
+    // NOTE: The first call has nothing to compare to, so it returns the averages since boot. A read with fewer cpus than the
+    // topology has online returns NULL (and keeps the previous totals) rather than a system wide wait of only some of them.
+    // Example Output:
+    // runQueueSample(&count, &total) returns {{0, 12.4, 830.0, 14.9}, {1, 140.2, 1210.5, 115.8}, ...} and sets count = 12 and
+    // total = {-1, 480.7, 9960.1, 48.3}
+
+    *count = 0;
+    if (!opened)
+    {
+        procFileOpen(&schedstat, "/proc/schedstat");
+        opened = true;
+    }
+
+    const char *text = procFileRead(&schedstat);
+    if (text == NULL)
+    {
+        return NULL;
+    }
+
+    // every online cpu has a line, so a read with fewer of them is incomplete
+    int cpus = 0;
+    const char *line = text;
+    while (line != NULL && *line != '\0')
+    {
+        cpus += strncmp(line, "cpu", 3) == 0;
+        line = strchr(line, '\n');
+        if (line != NULL)
+        {
+            line++;
+        }
+    }
+    topologyRefresh();
+    if (cpus < topologyGet()->online)
+    {
+        return NULL;
+    }
+
+    struct timespec now;
+    clock_gettime(CLOCK_BOOTTIME, &now);
+    long long time = now.tv_sec * 1000000000LL + now.tv_nsec;
+    double seconds = (time - previousTime) / 1e9;
+    previousTime = time;
+
+    long long totalWait = 0, totalSlices = 0;
+    *total = (struct runQueue){.cpu = -1};
+
+    // cpuN yld_count legacy schedule() goidle ttwu ttwu_local run_ns wait_ns timeslices (the domain lines are skipped)
+    line = text;
+    while (line != NULL && *line != '\0')
+    {
+        int cpu;
+        long long waitNs, slices;
+        if (strncmp(line, "cpu", 3) == 0 && sscanf(line, "cpu%d %*s %*s %*s %*s %*s %*s %*s %lld %lld", &cpu, &waitNs, &slices) == 3 && cpu >= 0)
+        {
+            if (*count == queueCapacity)
+            {
+                queueCapacity = queueCapacity == 0 ? 64 : queueCapacity * 2;
+                queues = realloc(queues, queueCapacity * sizeof(struct runQueue));
+                if (!queues)
+                {
+                    perror("Error allocating memory");
+                    exit(EXIT_FAILURE);
+                }
+            }
+            growPrevious(cpu);
+
+            long long waited = waitNs - previous[cpu].waitNs;
+            long long ran = slices - previous[cpu].slices;
+            previous[cpu].waitNs = waitNs;
+            previous[cpu].slices = slices;
+            totalWait += waited;
+            totalSlices += ran;
+
+            struct runQueue *queue = &queues[(*count)++];
+            queue->cpu = cpu;
+            queue->waitRate = seconds > 0 ? waited / 1e6 / seconds : 0;
+            queue->sliceRate = seconds > 0 ? ran / seconds : 0;
+            queue->waitPerSlice = ran > 0 ? waited / 1e3 / ran : 0;
+        }
+
+        line = strchr(line, '\n');
+        if (line != NULL)
+        {
+            line++;
+        }
+    }
+
+    if (*count == 0)
+    {
+        return NULL;
+    }
+
+    total->waitRate = seconds > 0 ? totalWait / 1e6 / seconds : 0;
+    total->sliceRate = seconds > 0 ? totalSlices / seconds : 0;
+    total->waitPerSlice = totalSlices > 0 ? totalWait / 1e3 / totalSlices : 0;
+    return queues;
+}
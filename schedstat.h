@@ -0,0 +1,20 @@
+// Author: Kristi Dodaj
+// schedstat.h: Responsible for defining the run queue latency read from /proc/schedstat (see schedstat.c)
+
+#ifndef SCHEDSTAT
+#define SCHEDSTAT
+
+// the run queue of one cpu (or of all of them) over the last interval
+struct runQueue
+{
+    int cpu;             // -1 for the system wide total
+    double waitRate;     // ms the tasks spent waiting on the run queue per second
+    double sliceRate;    // timeslices run per second
+    double waitPerSlice; // average wait before a timeslice in us
+};
+
+// define the function signatures
+
+const struct runQueue *runQueueSample(int *count, struct runQueue *total);
+
+#endif /* SCHEDSTAT */
@@ -5,25 +5,55 @@
 #include <stdio.h>
 #include <string.h>
 #include <sys/utsname.h>
-#include <utmpx.h>
 #include <unistd.h>
 #include <sys/resource.h>
-#include <sys/sysinfo.h>
 #include <sys/wait.h>
 #include <math.h>
-
-void header(int samples, int tdelay)
+#include <stdbool.h>
+#include <signal.h>
+#include <time.h>
+#include "alerts.h"
+#include "overhead.h"
+#include "event_loop.h"
+#include "perf.h"
+#include "topology.h"
+#include "numa.h"
+#include "irq.h"
+#include "procmem.h"
+#include "procio.h"
+#include "threads.h"
+#include "schedstat.h"
+#include "filesystems.h"
+#include "tcp.h"
+#include "loadavg.h"
+#include "vmstat.h"
+#include "hugepages.h"
+#include "procfile.h"
+#include "libmonitor.h"
+#include "daemon.h"
+#include "output.h"
+#include "isolation.h"
+
+int header(FILE *out, int samples, int tdelay)
 {
     // This function will take in int samples and int tdelay as parameters and print the header of the program which displays the
     // number of samples and the second delay as well as the memory usage of the program using the <sys/resources.h> C library
+    // and the cost of the monitor itself (see overhead.c). It returns the number of lines printed (including the leading blank line).
     // Example Output:
-    // header(10, 1) prints
+    // header(stdout, 10, 1) prints and returns 5
     //
     // Nbr of samples: 10 -- every 1 secs
     // Memory Usage: 4092 kilobytes
+    // Monitor Overhead: 0.041 % of a core -- 18 read/write syscalls/sample
+    // Stage Times (us/sample): read 21.4  parse 3.1  compute 0.1  format 2.0  write 9.8
 
-    // print sampe and tdelay
-    printf("\nNbr of samples: %d -- every %d secs\n", samples, tdelay);
+    // print sampe and tdelay (and the frames the terminal was too slow to show, see output.c)
+    fprintf(out, "\nNbr of samples: %d -- every %d secs", samples, tdelay);
+    if (outputDropped() > 0)
+    {
+        fprintf(out, " -- %ld frames dropped (slow output)", outputDropped());
+    }
+    fprintf(out, "\n");
 
     // find and print the memory usage
     struct rusage usage;
@@ -35,7 +65,43 @@ void header(int samples, int tdelay)
         // NOTE: The program will exit since printing from usage would fail given the usage object is not populated
     }
 
-    printf("Memory Usage: %ld kilobytes \n", usage.ru_maxrss);
+    fprintf(out, "Memory Usage: %ld kilobytes \n", usage.ru_maxrss);
+    int lines = 3;
+
+    // print the cpu and syscall cost of the monitor
+    lines += overheadPrint(out);
+
+    // show whether the isolation settings (--pin, --idle, --nice, --mlock) could be applied
+    lines += isolationPrint(out);
+
+    // show how much the alert rules cost to evaluate when there are any
+    if (alertsCount() > 0)
+    {
+        fprintf(out, "Alert Rules: %d -- %.3f microseconds/rule\n", alertsCount(), alertsCostPerRule());
+        lines++;
+    }
+
+    return lines;
+}
+
+void refreshHeader(FILE *out, int samples, int tdelay, int lines)
+{
+    // This function reprints the header of the update modes in place (lines is what the first header() call returned) so the
+    // overhead figures stay current, and puts the cursor back where it was
+    // Example Output:
+    // refreshHeader(stdout, 10, 1, 5) reprints the 5 header lines at the top of the terminal
+
+    fprintf(out, "\0337"); // save the cursor position
+
+    for (int i = 1; i <= lines; i++)
+    {
+        fprintf(out, "\033[%d;0H\033[2K", i); // clear each header line
+    }
+
+    fprintf(out, "\033[1;0H");
+    header(out, samples, tdelay);
+
+    fprintf(out, "\0338"); // restore the cursor position
 }
 
 void getSystemInfo()
@@ -68,10 +134,10 @@ void getSystemInfo()
     printf("Architecture = %s \n", info.machine);
 }
 
-void getUsers(int write_pipe, int size_pipe)
+void getUsers(int write_pipe)
 {
-    // This function will write to the write_pipe the list of users along with each of their connected sessions using the <utmpx.h> C library
-    // and reading through the utmp user log file. It will also write the size of the total string through a second pipe (size_pipe).
+    // This function will write to the write_pipe the list of users along with each of their connected sessions, sampled from the
+    // utmp user log file by the monitor library (see libmonitor.c). The list is sent as one message (see sendMessage() in event_loop.c).
     // Example Output:
     // getUsers() writes
     //
@@ -79,209 +145,131 @@ void getUsers(int write_pipe, int size_pipe)
     // dodajkri      pts/2 (tmux(97972).%2)
     // dodajkri      pts/0 (138.51.8.149)
 
-    struct utmpx *users; // initialize utmpx struct
-
-    // rewinds pointer to beginning of utmp file
-    setutxent();
+    // the library handle of this collector (kept between calls)
+    static struct monitor *handle = NULL;
+    static struct monitorSnapshot snapshot;
 
-    // count how many lines
-    int count = 0;
-    while ((users = getutxent()) != NULL)
+    if (handle == NULL && (handle = monitor_open(&(struct monitorConfig){.sections = MONITOR_USERS})) == NULL)
     {
-        // validate that this is a user process
-        if (users->ut_type == USER_PROCESS)
-        {
-            count++;
-        }
+        // error checking for system resources
+        perror("monitor_open: Failed to start sampling the users");
+        sendMessage(write_pipe, "", 0);
+        return;
     }
 
-    // allocate memory for the buffer
-    char *buf = (char *)malloc(count * 1024);
-    if (!buf)
+    // read through utmp file
+    long long stage = overheadBegin();
+    if (monitor_sample(handle, &snapshot) == -1)
     {
-        perror("Error allocating memory");
-        exit(EXIT_FAILURE);
+        perror("monitor_sample: Failed to read the users");
     }
+    overheadEnd(STAGE_READ, stage);
 
+    stage = overheadBegin();
+    char buf[COLLECTOR_BUFFER];
     int offset = 0;
 
-    // read through utmp file
-    setutxent();
-    while ((users = getutxent()) != NULL)
+    for (int i = 0; i < snapshot.userCount && i < MONITOR_MAX_USERS; i++)
     {
-        // validate that this is a user process
-        if (users->ut_type == USER_PROCESS)
-        {
-            offset += sprintf(buf + offset, "%s      %s (%s) \n", users->ut_user, users->ut_line, users->ut_host);
-        }
+        offset += snprintf(buf + offset, sizeof(buf) - offset, "%s      %s (%s) \n", snapshot.users[i].user, snapshot.users[i].line, snapshot.users[i].host);
     }
-
-    // close the utmp file
-    endutxent();
-
-    // resize the buffer to the actual size
-    buf = (char *)realloc(buf, offset + 1);
-    if (!buf)
+    if (snapshot.userCount > MONITOR_MAX_USERS)
     {
-        perror("Error reallocating memory");
-        exit(EXIT_FAILURE);
+        offset += snprintf(buf + offset, sizeof(buf) - offset, "... and %d more sessions\n", snapshot.userCount - MONITOR_MAX_USERS);
     }
-
-    // add the null terminator
-    buf[offset] = '\0';
+    overheadEnd(STAGE_FORMAT, stage);
 
     // send the buffer to the pipe
-    write(write_pipe, buf, offset + 1);
-
-    // send size
-    char str[100];
-    sprintf(str, "%d", offset + 1);
-    write(size_pipe, str, strlen(str) + 1);
-
-    // free the allocated memory
-    free(buf);
+    stage = overheadBegin();
+    sendMessage(write_pipe, buf, offset);
+    overheadEnd(STAGE_WRITE, stage);
 }
 
-void getCpuNumber()
+void getCpuNumber(FILE *out)
 {
-    // This function will print out the number of cpu's as well as the total number of cores using the /proc/cpuinfo file to scrape the information.
+    // This function will print out the number of cpu's (logical cpus online) and the total number of physical cores, followed by
+    // the sockets, SMT threads per core, NUMA nodes and offline cpus. The topology is discovered once from sysfs and only read
+    // again after a cpu hotplug event (see topology.c), so nothing is parsed here on a normal frame.
     // Example Ouput:
-    // getCpuNumber() prints
+    // getCpuNumber(stdout) prints
     //
-    // Number of CPU's: 12     Total Number of Cores: 72
-
-    // initialize variables to store information
-    int cpuNumber = 0;
-    int coreNumber = 0;
-    char line[200];
-
-    // open the /proc/cpuinfo file and scrape the cpu and core numbers
-    FILE *info = fopen("/proc/cpuinfo", "r");
-
-    // error checking for system resources
-    if (info == NULL)
-    {
-        perror("fopen: Failed to open /proc/cpuinfo");
-
-        // NOTE: The program will exit since fgets will fail given the file is not opened
-    }
-
-    while (fgets(line, sizeof(line), info) != NULL)
-    {
-        if (strstr(line, "processor") != NULL)
-        {
-            cpuNumber++;
-        }
-        if (strstr(line, "cpu cores") != NULL)
-        {
-            char *ptr = strchr(line, ':'); // pointer to first occurrence of ':'
-            coreNumber += atoi((ptr + 1)); // converts string to int
-        }
-    }
-
-    // error checking for system resources
-    if (ferror(info))
-    {
-        perror("fgets: Failed to read /proc/cpuinfo");
-        fclose(info);
-    }
+    // Number of CPU's: 12     Total Number of Cores: 6
+    //  Sockets: 1     Threads per Core: 2     NUMA Nodes: 1     Offline CPU's: 0
 
-    if (fclose(info) != 0)
-    {
-        perror("fclose: Failed to close /proc/cpuinfo");
-    }
+    long long stage = overheadBegin();
+    topologyRefresh();
+    const struct topology *machine = topologyGet();
+    overheadEnd(STAGE_PARSE, stage);
 
     // print final output
-    printf("Number of CPU's: %d     Total Number of Cores: %d\n", cpuNumber, coreNumber);
+    fprintf(out, "Number of CPU's: %d     Total Number of Cores: %d\n", machine->online, machine->cores);
+    fprintf(out, " Sockets: %d     Threads per Core: %d     NUMA Nodes: %d     Offline CPU's: %d\n", machine->sockets, machine->cores > 0 ? machine->online / machine->cores : 0, machine->nodes, machine->possible - machine->online);
 }
 
-void getCpuUsage(int write_pipe, int tdelay)
+void getCpuUsage(int write_pipe)
 {
-    // This function takes the second interval (int tdelay), and compares two measurements that are tdelay seconds apart done by reading the /proc/stat file.
-    // The function will write the overall percent increase(ex. 0.18%) or decrease(ex. -0.18%) as a float rounded to 2 decimal places to the write_pipe.
-    // FORMULA FOR CALCULATION: (U2-U1/T2-T1) * 100 WHERE T IS TOTAL TIME AND U IS TOTAL TIME WITHOUT IDLE TIME
+    // This function writes the cpu usage measured by the monitor library (see libmonitor.c) since the previous call to the write_pipe
+    // (the collector calls it once per cpu interval, so the two measurements are one interval apart) as a float rounded to 2 decimal
+    // places, followed by the share of each cpu state (user, system, iowait, steal, irq, softirq), the context switch, interrupt and
+    // fork rates per second and the runnable and blocked tasks. All of them come from one read of /proc/stat. When the kernel has
+    // /proc/schedstat they are followed by the run queue wait per timeslice (us), the run queue wait (ms per second) and the
+    // timeslices per second of the whole system, then the wait per timeslice of every cpu as cpu:us (see runQueueSample()).
+    // NOTE: The first call has nothing to compare to, so it writes the averages since boot
     // Example Output:
-    // getCpuUsage(1)
+    // getCpuUsage(write_pipe)
     //
-    // writes: 1.17
-
-    // declare and populate all the desired times spent by the CPU
-    long int user;
-    long int nice;
-    long int system;
-    long int irq;
-    long int softirq;
-    long int steal;
-    long int guest;
-    long int guest_nice;
-
-    long int idle;
-    long int iowait;
-
-    // open file and retrieve each value to do the first measurement
-    FILE *info = fopen("/proc/stat", "r");
-
-    // error checking for system resources
-    if (info == NULL)
-    {
-        perror("fopen: Error opening /proc/stat for first cpu usage calculation");
-    }
-
-    if (fscanf(info, "cpu %ld %ld %ld %ld %ld %ld %ld %ld %ld %ld", &user, &nice, &system, &idle, &iowait, &irq, &softirq, &steal, &guest, &guest_nice) != 10)
-    {
-        perror("fscanf: Error reading from /proc/stat for first cpu usage calculation");
-        fclose(info);
-    }
-
-    if (fclose(info) != 0)
-    {
-        perror("fclose: Error closing /proc/stat for first cpu usage calculation");
-    }
+    // writes: 1.17 0.80 0.30 0.02 0.05 0.00 0.00 1520 830 2.0 1 0 48.3 480.7 9960 0:14.9 1:115.8
 
-    // calculate first measure
-    long int T1 = (user + nice + system + idle + iowait + irq + softirq);
-    long int U1 = T1 - idle;
+    // the library handle of this collector, which keeps the previous measurement (kept between calls)
+    static struct monitor *handle = NULL;
 
-    // calculate time to be waited and sleep
-    sleep(tdelay);
-
-    // open file and retrieve each value to do the second measurement
-    FILE *info2 = fopen("/proc/stat", "r");
-
-    // error checking for system resources
-    if (info2 == NULL)
-    {
-        perror("fopen: Error opening /proc/stat for second cpu usage calculation");
-    }
-
-    if (fscanf(info2, "cpu %ld %ld %ld %ld %ld %ld %ld %ld %ld %ld", &user, &nice, &system, &idle, &iowait, &irq, &softirq, &steal, &guest, &guest_nice) != 10)
+    if (handle == NULL && (handle = monitor_open(&(struct monitorConfig){.sections = MONITOR_CPU})) == NULL)
     {
-        perror("fscanf: Error reading from /proc/stat for second cpu usage calculation");
-        fclose(info2);
+        // error checking for system resources
+        perror("monitor_open: Error opening /proc/stat for cpu usage calculation");
+        sendMessage(write_pipe, "0", 1);
+        return;
     }
 
-    if (fclose(info2) != 0)
+    // read /proc/stat and compute the shares and rates
+    long long stage = overheadBegin();
+    struct monitorSnapshot snapshot;
+    if (monitor_sample(handle, &snapshot) == -1)
     {
-        perror("fclose: Error closing /proc/stat for second cpu usage calculation");
+        perror("monitor_sample: Error reading /proc/stat for cpu usage calculation");
+        overheadEnd(STAGE_READ, stage);
+        sendMessage(write_pipe, "0", 1);
+        return;
     }
+    overheadEnd(STAGE_READ, stage);
 
-    // NOTE: The program will exit given a failure to read or open the file since adding unassigned integers will cause a failure
-
-    // calculate second measure
-    long int T2 = (user + nice + system + idle + iowait + irq + softirq);
-    long int U2 = T2 - idle;
-
-    // measure and print percentage
-    float usage = ((float)(U2 - U1) / (float)(T2 - T1)) * 100;
+    // the run queues over the same interval (read and parsed together, see procFileRead())
+    stage = overheadBegin();
+    struct runQueue total;
+    int queueCount;
+    const struct runQueue *queues = runQueueSample(&queueCount, &total);
+    overheadEnd(STAGE_PARSE, stage);
 
     // build output string
-    char buf[1024];
+    stage = overheadBegin();
+    char buf[COLLECTOR_BUFFER];
 
-    // Convert the float to a string with a specific format
-    snprintf(buf, sizeof(buf), "%.2f", usage);
+    // Convert the floats to a string with a specific format
+    int offset = snprintf(buf, sizeof(buf), "%.2f %.2f %.2f %.2f %.2f %.2f %.2f %.0f %.0f %.1f %lld %lld", snapshot.cpuUsage, snapshot.user, snapshot.system, snapshot.iowait, snapshot.steal, snapshot.irq, snapshot.softirq, snapshot.contextSwitches, snapshot.interrupts, snapshot.forks, snapshot.running, snapshot.blocked);
+    if (queues != NULL)
+    {
+        offset += snprintf(buf + offset, sizeof(buf) - offset, " %.1f %.1f %.0f", total.waitPerSlice, total.waitRate, total.sliceRate);
+        for (int i = 0; i < queueCount && offset < (int)sizeof(buf) - 32; i++)
+        {
+            offset += snprintf(buf + offset, sizeof(buf) - offset, " %d:%.1f", queues[i].cpu, queues[i].waitPerSlice);
+        }
+    }
+    overheadEnd(STAGE_FORMAT, stage);
 
     // write output to pipe
-    write(write_pipe, buf, strlen(buf) + 1);
+    stage = overheadBegin();
+    sendMessage(write_pipe, buf, offset);
+    overheadEnd(STAGE_WRITE, stage);
 }
 
 char *getCpuUsageGraphic(float current_usage, float previous_usage, int previous_bars)
@@ -345,41 +333,46 @@ char *getCpuUsageGraphic(float current_usage, float previous_usage, int previous
 void getMemoryUsage(int write_pipe)
 {
     // This function writes the value of total and used Physical RAM as well as the total and used Virtual Ram to the write_pipe.
-    // This is being done by using the <sys/sysinfo.h> C library.
+    // This is being sampled by the monitor library (see libmonitor.c) through the <sys/sysinfo.h> C library.
     // Note that this function defines 1Gb = 1024Kb (i.e the function uses binary prefixes)
     // Example Output:
     // getMemoryUsage() writes
     //
     // 7.18 GB / 7.77 GB  --  7.30 GB / 9.63
 
-    // find the used and total physical RAM
-    struct sysinfo info;
+    // the library handle of this collector (kept between calls)
+    static struct monitor *handle = NULL;
 
-    // error checking for system resources
-    if (sysinfo(&info) == -1)
+    if (handle == NULL && (handle = monitor_open(&(struct monitorConfig){.sections = MONITOR_MEMORY})) == NULL)
     {
-        perror("sysinfo: Error getting sysinfo on RAM");
-
-        // NOTE: This program will exit given sysinfo fails since we are calling value from an unpopulated object
+        // error checking for system resources
+        perror("monitor_open: Error getting sysinfo on RAM");
+        sendMessage(write_pipe, "", 0);
+        return;
     }
 
-    // find the used and total physical RAM
-    double totalPhysicalRam = (double)info.totalram / (1073741824);
-    double usedPhysicalRam = (double)(info.totalram - info.freeram) / (1073741824);
-
-    // find the used and total virtual RAM (total virtual RAM = physical memory + swap memory)
-    double totalVirtualRam = (double)(info.totalram + info.totalswap) / (1073741824);
-    double usedVirtualRam = (double)(info.totalram + info.totalswap - info.freeram - info.freeswap) / (1073741824);
+    // find the used and total physical and virtual RAM (total virtual RAM = physical memory + swap memory)
+    long long stage = overheadBegin();
+    struct monitorSnapshot snapshot;
+    if (monitor_sample(handle, &snapshot) == -1)
+    {
+        perror("monitor_sample: Error getting sysinfo on RAM");
+        overheadEnd(STAGE_READ, stage);
+        sendMessage(write_pipe, "", 0);
+        return;
+    }
+    overheadEnd(STAGE_READ, stage);
 
     // build output string
-    char *buf = calloc(1, 50);
-    sprintf(buf, "%.2f GB / %.2f GB  --  %.2f GB / %.2f GB\n", usedPhysicalRam, totalPhysicalRam, usedVirtualRam, totalVirtualRam);
+    stage = overheadBegin();
+    char buf[100];
+    snprintf(buf, sizeof(buf), "%.2f GB / %.2f GB  --  %.2f GB / %.2f GB\n", snapshot.memoryUsed, snapshot.memoryTotal, snapshot.virtualUsed, snapshot.virtualTotal);
+    overheadEnd(STAGE_FORMAT, stage);
 
     // write output to pipe
-    write(write_pipe, buf, strlen(buf) + 1);
-
-    // free allocated memory
-    free(buf);
+    stage = overheadBegin();
+    sendMessage(write_pipe, buf, strlen(buf));
+    overheadEnd(STAGE_WRITE, stage);
 }
 
 char *getMemoryUsageGraphic(float current_usage, float previous_usage)
@@ -445,804 +438,822 @@ char *getMemoryUsageGraphic(float current_usage, float previous_usage)
     return buf;
 }
 
-int ctrl_c_signal = 0;
+// the latest values read from the collector pipes that the alert rules are evaluated against
+static struct alertSnapshot snapshot;
 
-void handle_ctrl_c(int signal_number)
+static void recordMemoryUsage(const char *memory)
 {
-    // This function will dicatate what will occur when the signal from CTRL C is activated. This will give the user to choice to either
-    // quit or continue the program through a (y/n) option.
-    // NOTE: IF IMPROPER INPUT FROM THE USER IS GIVEN THAN WE ASK THE USER THE QUESTION AGAIN
-    // Example Output: Given that CTRL C IS PRESSED it prints
-    //
-    // Ctrl-C signal received. Do you want to continue? (y/n):
-    // if n: program exits
-    // if y: program continues
-
-    ctrl_c_signal = 1;
+    // This function takes a line written by getMemoryUsage() and stores its values in the alert snapshot. The memory available is
+    // MemAvailable of /proc/meminfo (the free memory plus the page cache and slabs the kernel can reclaim), which the memory line
+    // does not show, so growing page cache does not look like memory running out.
+    // Example Output:
+    // recordMemoryUsage("7.18 GB / 7.77 GB  --  7.30 GB / 9.63 GB\n") stores memoryUsed = 7.18 and memoryAvailable = 3.41
 
-    char input;
-    int valid = 0;
+    static struct procFile meminfo;
+    static bool opened = false;
 
-    printf("\n");
+    long long stage = overheadBegin();
+    if (!opened)
+    {
+        procFileOpen(&meminfo, "/proc/meminfo");
+        opened = true;
+    }
 
-    while (valid == 0)
+    float virtualTotal;
+    if (sscanf(memory, "%f GB / %f GB  --  %f GB / %f GB", &snapshot.memoryUsed, &snapshot.memoryTotal, &snapshot.virtualUsed, &virtualTotal) == 4)
     {
-        printf("\033[2K");
+        // meminfo is in kB
+        const char *text = procFileRead(&meminfo);
+        const char *available = text != NULL ? strstr(text, "MemAvailable:") : NULL;
+        snapshot.memoryAvailable = available != NULL ? strtoll(available + strlen("MemAvailable:"), NULL, 10) / 1048576.0 : snapshot.memoryTotal - snapshot.memoryUsed;
+    }
+    overheadEnd(STAGE_PARSE, stage);
+}
 
-        // get user input
-        printf("Ctrl-C signal received. Do you want to continue? (y/n): ");
-        input = getchar();
+static void recordCpuUsage(const char *cpu)
+{
+    // This function takes a line written by getCpuUsage() and stores its total cpu usage in the alert snapshot
+    // Example Output:
+    // recordCpuUsage("34.50 20.10 ...") stores cpuUsage = 34.50
 
-        // Clear the input buffer
-        while (getchar() != '\n')
-            ;
+    sscanf(cpu, "%f", &snapshot.cpuUsage);
+}
 
-        // exit or continue depending on input
-        if (input == 'n' || input == 'N')
-        {
-            printf("Exiting...\n");
-            valid = 1;
-            exit(0);
-        }
-        else if (input == 'y' || input == 'Y')
-        {
+// the sections a mode can show (combined with |)
+#define SHOW_MEMORY 1
+#define SHOW_USERS 2
+#define SHOW_CPU 4
 
-            valid = 1;
+// the interval in milliseconds of each collector (0 means every tdelay seconds), see setCollectorIntervals()
+static int cpuInterval = 0;
+static int memoryInterval = 0;
+static int usersInterval = 0;
 
-            // clear the message displayed if continuing
-            printf("\033[2;A");
-            printf("\033[2K");
-            printf("\033[1;B");
-            printf("\033[2K");
-            printf("\033[1;B");
+// the longest memory line of a frame (including its graphic)
+#define MEMORY_LINE_LENGTH 160
 
-            ctrl_c_signal = 0;
-        }
-        else
-        {
-            // go one line above to reask the question
-            printf("\033[1;A");
-        }
+// everything the frames of one run need to remember between calls of renderFrame()
+struct display
+{
+    int samples;
+    int tdelay;
+    int sections;
+    bool sequential;
+    bool graphic;
+    int headerLines;
+    int memoryLineNumber;
+    struct collector *memory;
+    struct collector *cpu;
+    struct collector *users;
+    float *memoryHistory;   // virtual memory used per frame (for the memory graphic)
+    char (*memoryLines)[MEMORY_LINE_LENGTH]; // the memory line printed per frame (to redraw the lines of dropped frames)
+    float (*cpuHistory)[2]; // number of bars and cpu usage per frame (for the cpu graphic)
+};
+
+// an optional section shown below the cpu usage, each is sampled by its own collector and enabled with --name, or with --name=VALUE
+// for a panel that is configured (see enablePanel())
+struct panel
+{
+    const char *name;
+    const char *title;
+    void (*sample)(int write_pipe);
+    bool (*configure)(const char *value); // takes the VALUE of --name=VALUE, NULL for a panel turned on with --name alone
+    bool enabled;
+    struct collector collector;
+};
+
+static struct panel panels[] = {
+    {"perf", "### Performance Counters ### (per cpu)", getPerfCounters},
+    {"numa", "### NUMA Nodes ### (Used/Tot -- numastat per second)", getNumaUsage},
+    {"irq", "### Softirqs/Interrupts ### (per cpu per second)", getIrqDistribution},
+    {"procmem", "### Memory Consumers ### (top processes by PSS)", getMemoryConsumers},
+    {"procio", "### I/O Consumers ### (top processes by storage I/O per second)", getIoConsumers},
+    {"fs", "### Filesystems ### (space and inodes used -- time to full at the current rate)", getFilesystemUsage},
+    {"tcp", "### TCP ### (connections, retransmits, listen queues and sockets per second)", getTcpHealth},
+    {"load", "### Load ### (load average, runnable and blocked tasks and forks per second over the last samples)", getLoadSparklines},
+    {"vm", "### Virtual Memory ### (page faults, swap, reclaim and compaction per second)", getVirtualMemoryActivity},
+    {"huge", "### Huge Pages ### (hugetlb, THP per second and free blocks of every zone)", getHugePageUsage},
+    {"pid", "### Threads ### (hottest threads of the --pid process)", getThreadUsage, setThreadTarget},
+};
+
+#define PANEL_COUNT (int)(sizeof(panels) / sizeof(panels[0]))
+
+// whether the current run draws graphics, see graphicOutput()
+static bool graphicMode = false;
+
+// the socket of the daemon the collectors are read from instead of being forked (NULL to fork them), see setDaemonSocket()
+static const char *daemonSocket = NULL;
+
+static const char *panelValue(const struct panel *panel, const char *name)
+{
+    // This function returns what follows "name=" for a configured panel, name itself for any other panel, or NULL if name is not
+    // the flag of the panel
+    size_t length = strlen(panel->name);
+    if (panel->configure == NULL)
+    {
+        return strcmp(panel->name, name) == 0 ? name : NULL;
     }
+    return strncmp(panel->name, name, length) == 0 && name[length] == '=' ? name + length + 1 : NULL;
 }
 
-void allInfoUpdate(int samples, int tdelay)
+bool panelExists(const char *name)
 {
-    // This function will take in int samples and tdelay and prints out all the system information that will update
-    // in the specified time interval and the specified number of samples. The information given includes memory usage,
-    // user logs, cpu information, system information and are implemented through the above listed functions.
-    // NOTE: Cpu Usage, Memory Usage, and Users are individual processes that communicate through pipes
+    // This function returns true if there is an optional panel with the given name (name=VALUE for a configured panel)
     // Example Output:
-    // allInfoUpdate(10, 1) prints
-    //
-    // Nbr of samples: 10 -- every 1 secs
-    // Memory Usage: 3924 kilobytes
-    // ---------------------------------------
-    // 2.98 GB / 15.32 GB  --  2.98 GB / 16.28 GBsed/Tot)
-    // 2.99 GB / 15.32 GB  --  2.99 GB / 16.28 GB
-    // 2.99 GB / 15.32 GB  --  2.99 GB / 16.28 GB
-    // 2.99 GB / 15.32 GB  --  2.99 GB / 16.28 GB
-    // 2.99 GB / 15.32 GB  --  2.99 GB / 16.28 GB
-    // 2.99 GB / 15.32 GB  --  2.99 GB / 16.28 GB
-    // 2.99 GB / 15.32 GB  --  2.99 GB / 16.28 GB
-    // 2.99 GB / 15.32 GB  --  2.99 GB / 16.28 GB
-    // 2.99 GB / 15.32 GB  --  2.99 GB / 16.28 GB
-    // 2.99 GB / 15.32 GB  --  2.99 GB / 16.28 GB
-    // ---------------------------------------
-    // ### Sessions/users ###
-    // dodajkri      pts/1 (tmux(97972).%0)
-    // dodajkri      pts/0 (138.51.8.149)
-    // ---------------------------------------
-    // Number of CPU's: 12     Total Number of Cores: 72
-    //  total cpu use = 0.01 %
-    // ---------------------------------------
-    // ### System Information ###
-    // System Name = Linux
-    // Machine Name = iits-b473-27
-    // Version = #62-Ubuntu SMP Tue Nov 22 19:54:14 UTC 2022
-    // Release = 5.15.0-56-generic
-    // Architecture = x86_64
-    // ---------------------------------------
-
-    ctrl_c_signal = 0;
+    // panelExists("perf") returns true
+    // panelExists("pid=4242") returns true
 
-    // create pipes for communication
-    int mem_pipe[2], cpu_pipe[2], user_pipe[2], size_pipe[2];
-    if (pipe(mem_pipe) < 0 || pipe(cpu_pipe) < 0 || pipe(user_pipe) < 0 || pipe(size_pipe) < 0)
+    for (int i = 0; i < PANEL_COUNT; i++)
     {
-        perror("Error creating pipes");
-        exit(EXIT_FAILURE);
+        if (panelValue(&panels[i], name) != NULL)
+        {
+            return true;
+        }
     }
+    return false;
+}
 
-    /////////////////////////////////
-    //          CHILD
-    /////////////////////////////////
+bool enablePanel(const char *name)
+{
+    // This function turns on the optional panel with the given name for every output mode and returns false if there is no such
+    // panel, it was already turned on or the value of a configured panel is invalid
+    // Example Output:
+    // enablePanel("perf") returns true and the performance counters are shown below the cpu usage
+    // enablePanel("pid=4242") returns true and the threads of process 4242 are shown below the cpu usage
 
-    // child process for memory usage
-    pid_t mem_pid = fork();
-    if (mem_pid < 0)
-    {
-        perror("fork");
-        exit(1);
-    }
-    else if (mem_pid == 0)
+    for (int i = 0; i < PANEL_COUNT; i++)
     {
-        signal(SIGTSTP, SIG_IGN);
-
-        close(mem_pipe[0]); // close unused read end
-        for (int i = 0; i < samples; i++)
+        const char *value = panelValue(&panels[i], name);
+        if (value != NULL && !panels[i].enabled)
         {
-
-            while (ctrl_c_signal == 1)
+            if (panels[i].configure != NULL && !panels[i].configure(value))
             {
-                usleep(100000);
+                return false;
             }
-
-            getMemoryUsage(mem_pipe[1]); // write to pipe
-            sleep(tdelay);               // sleep for tdelay seconds
+            panels[i].enabled = true;
+            return true;
         }
-
-        exit(0); // exit child process
     }
+    return false;
+}
 
-    // child process for cpu usage
-    pid_t cpu_pid = fork();
-    if (cpu_pid < 0)
-    {
-        perror("fork");
-        exit(1);
-    }
-    else if (cpu_pid == 0)
-    {
-        signal(SIGTSTP, SIG_IGN);
+bool graphicOutput()
+{
+    // This function returns true if the current run was started with --graphics, so the panels can add their own graphics
+    return graphicMode;
+}
 
-        close(cpu_pipe[0]); // close unused read end
-        for (int i = 0; i < samples; i++)
-        {
-            while (ctrl_c_signal == 1)
-            {
-                usleep(100000);
-            }
+void setCollectorIntervals(int cpu, int memory, int users)
+{
+    // This function sets how often (in milliseconds) the cpu usage, memory usage and users are sampled, independently of tdelay
+    // which only sets how often the output is drawn. A value of 0 keeps sampling that collector every tdelay seconds.
+    // Example Output:
+    // setCollectorIntervals(100, 500, 30000) samples the cpu usage every 100 ms, the memory every 500 ms and the users every 30 s
 
-            getCpuUsage(cpu_pipe[1], tdelay); // write to pipe
-        }
+    cpuInterval = cpu;
+    memoryInterval = memory;
+    usersInterval = users;
+}
 
-        exit(0); // exit child process
-    }
+void setDaemonSocket(const char *path)
+{
+    // This function makes every output mode read its values from the daemon listening at path (see runDaemon()) instead of
+    // forking its own collectors
+    // Example Output:
+    // setDaemonSocket("/run/user/1000/system-monitor.sock") makes allInfoUpdate(10, 1) show the daemon's memory, cpu and users
+
+    daemonSocket = path;
+}
 
-    // child process for users
-    pid_t user_pid = fork();
-    if (user_pid < 0)
+static void startCollector(struct collector *collector, const char *name, void (*sample)(int write_pipe), int interval)
+{
+    // This function starts a collector, either as a forked process or as a connection to the daemon's collector of the same name
+    if (daemonSocket != NULL)
     {
-        perror("fork");
-        exit(1);
+        collectorConnect(collector, name, daemonSocket, interval);
     }
-    else if (user_pid == 0)
+    else
     {
-        signal(SIGTSTP, SIG_IGN);
+        collectorStart(collector, name, sample, interval);
+    }
+}
 
-        close(user_pipe[0]); // close unused read end
-        for (int i = 0; i < samples; i++)
-        {
-            while (ctrl_c_signal == 1)
-            {
-                usleep(100000);
-            }
+static const char *lateFlag(const struct collector *collector, int frame)
+{
+    // This function returns the note printed next to a value that was not updated within its collector's interval
+    return (frame > 0 && collectorIsLate(collector)) ? " (late)" : "";
+}
 
-            getUsers(user_pipe[1], size_pipe[1]); // write to pipe
-            sleep(tdelay);                        // sleep for tdelay seconds
-        }
+static void printMemoryLine(FILE *out, struct display *display, int frame)
+{
+    // This function prints the memory usage line of the given frame, followed by its graphic in graphics mode, and keeps it in
+    // display->memoryLines so the update modes can draw it again (see renderFrame())
+    // Example Output:
+    // printMemoryLine(out, display, 1) prints
+    //
+    // 9.76 GB / 15.37 GB  --  9.76 GB / 16.33 GB   |# 0.01 (9.76)
 
-        exit(0); // exit child process
+    char *text = display->memoryLines[frame];
+
+    if (!collectorHasData(display->memory))
+    {
+        snprintf(text, MEMORY_LINE_LENGTH, "(waiting for memory usage)");
+        fprintf(out, "%s\n", text);
+        return;
     }
 
-    /////////////////////////////////
-    //          PARENT
-    /////////////////////////////////
+    // drop the newline at the end of the collector's line
+    char line[100];
+    snprintf(line, sizeof(line), "%s", display->memory->latest);
+    line[strcspn(line, "\n")] = '\0';
+
+    if (display->graphic)
+    {
+        // the graphic follows the virtual memory used
+        float dummy, dummy2, usage, dummy3;
+        sscanf(line, "%f GB / %f GB  --  %f GB / %f GB", &dummy, &dummy2, &usage, &dummy3);
+        display->memoryHistory[frame] = usage;
+
+        long long stage = overheadBegin();
+        char *graphic = getMemoryUsageGraphic(usage, frame == 0 ? 0 : display->memoryHistory[frame - 1]);
+        overheadEnd(STAGE_FORMAT, stage);
 
-    // redirect incoming signals for CTRL C
-    if (signal(SIGINT, handle_ctrl_c) == SIG_ERR)
+        snprintf(text, MEMORY_LINE_LENGTH, "%s   %s%s", line, graphic, lateFlag(display->memory, frame));
+        free(graphic);
+    }
+    else
     {
-        perror("Error registering SIGINT handler");
-        exit(1);
+        snprintf(text, MEMORY_LINE_LENGTH, "%s%s", line, lateFlag(display->memory, frame));
     }
+    fprintf(out, "%s\n", text);
+}
 
-    // close unused write ends of pipes
-    close(mem_pipe[1]);
-    close(cpu_pipe[1]);
-    close(user_pipe[1]);
-    close(size_pipe[1]);
+static void printUsers(FILE *out, struct display *display, int frame)
+{
+    // This function prints the users section with the latest list the users process sent
 
-    // clear terminal before starting and take an intial measurement for the cpu usage calculation
-    printf("\033c");
+    fprintf(out, "### Sessions/users ###%s\n", lateFlag(display->users, frame));
 
-    // print headers
-    header(samples, tdelay);
-    printf("---------------------------------------\n");
-    printf("### Memory ### (Phys.Used/Tot -- Virtual Used/Tot) \n");
+    if (!collectorHasData(display->users))
+    {
+        fprintf(out, "(waiting for users)\n");
+        return;
+    }
 
-    // keep track of lines
-    int usersLineNumber = samples + 6;
-    int memoryLineNumber = 6;
+    fprintf(out, "%s", display->users->latest);
+}
 
-    float usage;
+static void printRunQueues(FILE *out, float waitPerSlice, float waitRate, float sliceRate, const char *perCpu)
+{
+    // This function prints the run queue wait of the whole system and the wait per timeslice of every cpu (perCpu is the cpu:us
+    // list at the end of the cpu collector's line, see getCpuUsage()), eight cpus per line
+    // Example Output:
+    // printRunQueues(out, 48.3, 480.7, 9960, " 0:14.9 1:115.8") prints
+    //
+    //   runq wait 48.3 us/timeslice  480.7 ms/s  9960 timeslices/s
+    //   per cpu (us/timeslice)  cpu0 14.9  cpu1 115.8
 
-    // wait for all child processes to finish
-    fd_set read_fds;
+    fprintf(out, "  runq wait %.1f us/timeslice  %.1f ms/s  %.0f timeslices/s\n", waitPerSlice, waitRate, sliceRate);
 
-    int max_fd = mem_pipe[0];
-    if (cpu_pipe[0] > max_fd)
+    int cpu, length, shown = 0;
+    float wait;
+    while (sscanf(perCpu, " %d:%f%n", &cpu, &wait, &length) == 2)
     {
-        max_fd = cpu_pipe[0];
+        if (shown % 8 == 0)
+        {
+            fprintf(out, shown == 0 ? "  per cpu (us/timeslice)" : "\n                        ");
+        }
+        fprintf(out, "  cpu%d %.1f", cpu, wait);
+        perCpu += length;
+        shown++;
     }
-    if (user_pipe[0] > max_fd)
+    if (shown > 0)
     {
-        max_fd = user_pipe[0];
+        fprintf(out, "\n");
     }
+}
+
+static void printCpu(FILE *out, struct display *display, int frame)
+{
+    // This function prints the cpu section of the given frame: the cpu and core numbers, the latest cpu usage and in graphics
+    // mode one graphic line per frame so far
+    // Example Output:
+    // printCpu(out, display, 1) prints (in graphics mode)
+    //
+    // Number of CPU's: 12     Total Number of Cores: 6
+    //  Sockets: 1     Threads per Core: 2     NUMA Nodes: 1     Offline CPU's: 0
+    //  total cpu use = 6.93 %
+    //   user 5.10 %  system 1.60 %  iowait 0.10 %  steal 0.13 %  irq 0.00 %  softirq 0.10 %
+    //   ctxt 1520/s  intr 830/s  forks 2.0/s  running 1  blocked 0
+    //   runq wait 48.3 us/timeslice  480.7 ms/s  9960 timeslices/s
+    //   per cpu (us/timeslice)  cpu0 14.9  cpu1 115.8  cpu2 3.0  ...
+    //         ||| 0.25
+    //         ||||||||| 6.93
+
+    getCpuNumber(out);
 
-    // print all information
-    for (int i = 0; i < samples; i++)
+    float usage = 0;
+    if (collectorHasData(display->cpu))
     {
-        // wait for all child processes to finish
-        FD_ZERO(&read_fds);
-        FD_SET(mem_pipe[0], &read_fds);
-        FD_SET(cpu_pipe[0], &read_fds);
-        FD_SET(user_pipe[0], &read_fds);
-        select(max_fd + 1, &read_fds, NULL, NULL, NULL);
-
-        // read and print output
-        if (FD_ISSET(mem_pipe[0], &read_fds))
+        // the usage, the cpu states and the /proc/stat rates (see getCpuUsage())
+        float user, system, iowait, steal, irq, softirq, contextSwitches, interrupts, forks;
+        int running, blocked;
+        float waitPerSlice, waitRate, sliceRate;
+        int length = 0;
+        int fields = sscanf(display->cpu->latest, "%f %f %f %f %f %f %f %f %f %f %d %d %f %f %f%n", &usage, &user, &system, &iowait, &steal, &irq, &softirq, &contextSwitches, &interrupts, &forks, &running, &blocked, &waitPerSlice, &waitRate, &sliceRate, &length);
+
+        fprintf(out, " total cpu use = %.2f %%%s\n", usage, lateFlag(display->cpu, frame));
+        if (fields >= 12)
+        {
+            fprintf(out, "  user %.2f %%  system %.2f %%  iowait %.2f %%  steal %.2f %%  irq %.2f %%  softirq %.2f %%\n", user, system, iowait, steal, irq, softirq);
+            fprintf(out, "  ctxt %.0f/s  intr %.0f/s  forks %.1f/s  running %d  blocked %d\n", contextSwitches, interrupts, forks, running, blocked);
+        }
+        if (fields == 15)
         {
-            printf("\033[%d;0H", (memoryLineNumber)); // move cursor to memory
-            char buf[100];
-            read(mem_pipe[0], buf, sizeof(buf)); // read memory usage from pipe
-            printf("%s", buf);
+            printRunQueues(out, waitPerSlice, waitRate, sliceRate, display->cpu->latest + length);
         }
+    }
+    else
+    {
+        fprintf(out, " total cpu use = (waiting for cpu usage)\n");
+    }
 
-        printf("\033[%d;0H", (usersLineNumber)); // move cursor to users
-        printf("---------------------------------------\n");
-        printf("### Sessions/users ###\n");
-        printf("\033[J"); // clears everything below the current line
+    if (display->graphic)
+    {
+        long long stage = overheadBegin();
 
-        // Read and print the user data from the user_pipe
-        char size[100];
-        read(size_pipe[0], size, sizeof(size));
-        int length = atoi(size);
-        char buf[length];
-        read(user_pipe[0], buf, sizeof(buf)); // read memory usage from pipe
-        printf("%s", buf);
+        // work out the number of bars of this frame from the previous one
+        char *graphic = frame == 0 ? getCpuUsageGraphic(usage, 0, 0) : getCpuUsageGraphic(usage, display->cpuHistory[frame - 1][1], display->cpuHistory[frame - 1][0]);
+        int bars;
+        sscanf(graphic, "%d", &bars);
+        free(graphic);
 
-        printf("---------------------------------------\n");
-        getCpuNumber();
+        display->cpuHistory[frame][0] = bars;
+        display->cpuHistory[frame][1] = usage;
 
-        if (i > 0)
+        for (int j = 0; j <= frame; j++)
         {
-            // print usage
-            printf(" total cpu use = %.2f %%\n", usage);
+            if (j != 0)
+            {
+                graphic = getCpuUsageGraphic(display->cpuHistory[j][1], display->cpuHistory[j - 1][1], display->cpuHistory[j - 1][0]);
+            }
+            else
+            {
+                graphic = getCpuUsageGraphic(display->cpuHistory[j][1], 0, 0);
+            }
+
+            // skip the number of bars at the start of the graphic
+            int chars_read;
+            sscanf(graphic, "%d%n", &bars, &chars_read);
+            fprintf(out, "%s\n", graphic + chars_read);
+            free(graphic);
         }
 
-        // Read and print the CPU usage data from the cpu_pipe
-        char buf2[1024];
-        read(cpu_pipe[0], buf2, sizeof(buf2)); // read memory usage from pipe
-        usage = atof(buf2);
+        overheadEnd(STAGE_FORMAT, stage);
+    }
+}
+
+static void printPanels(FILE *out, int frame)
+{
+    // This function prints every enabled panel with the latest text its collector sent
+    // Example Output:
+    // printPanels(out, 1) prints (with --perf)
+    //
+    // ---------------------------------------
+    // ### Performance Counters ### (per cpu)
+    // socket 0 / node 0
+    //   cpu0   util  34.50 %  IPC 1.42  cache miss  3.10 %  ctx    812/s
 
-        if (i == samples - 1)
+    for (int i = 0; i < PANEL_COUNT; i++)
+    {
+        if (!panels[i].enabled)
         {
-            printf("\033[1A"); // move the cursor up one line
-            printf("\033[2K"); // clear the entire line
+            continue;
         }
 
-        // update line numbers
-        memoryLineNumber = memoryLineNumber + 1;
+        fprintf(out, "---------------------------------------\n");
+        fprintf(out, "%s%s\n", panels[i].title, lateFlag(&panels[i].collector, frame));
 
-        // clear buffer
-        fflush(stdout);
+        if (collectorHasData(&panels[i].collector))
+        {
+            fprintf(out, "%s", panels[i].collector.latest);
+        }
+        else
+        {
+            fprintf(out, "(waiting for %s)\n", panels[i].name);
+        }
     }
+}
 
-    // wait for processes to finish so no orphan or zombie cases
-    int status;
-    waitpid(mem_pid, &status, 0);
-    waitpid(cpu_pid, &status, 0);
-    waitpid(user_pid, &status, 0);
+// whether the ctrl c question is up (see handleInterrupt())
+static bool prompting = false;
 
-    // print usage
-    printf(" total cpu use = %.2f %%\n", usage);
+static void answerPrompt(int fd, void *context)
+{
+    // This function reads the answer to the ctrl c prompt once the user pressed enter: n quits cleanly, y resumes the collectors
+    // and the display, anything else asks again
+    // NOTE: The answer is read from stdin by the event loop like any other event, nothing is read or printed in a signal handler
 
-    // print the ending system details
-    printf("---------------------------------------\n");
-    printf("### System Information ### \n");
-    getSystemInfo();
-    printf("---------------------------------------\n");
-}
-
-void allInfoUpdateGraphic(int samples, int tdelay)
-{
-    // This function will take in int samples and tdelay and prints out all the system information including graphics that will update
-    // in the specified time interval and the specified number of samples. The information given includes memory usage,
-    // user logs, cpu information, system information and are implemented through the above listed functions.
-    // NOTE: Cpu Usage, Memory Usage, and Users are individual processes that communicate through pipes
-    // Example Output:
-    // allInfoUpdateGraphic(10, 1) prints
-    //
-    // Nbr of samples: 10 -- every 1 secs
-    // Memory usage: 4052 kilobytes
-    //---------------------------------------
-    // ### Memory ### (Phys.Used/Tot -- Virtual Used/Tot)
-    // 9.75 GB / 15.37 GB  -- 9.75 GB / 16.33 GB   |o 0.00 (9.75)
-    // 9.75 GB / 15.37 GB  -- 9.75 GB / 16.33 GB   |o 0.00 (9.75)
-    // 9.75 GB / 15.37 GB  -- 9.75 GB / 16.33 GB   |o 0.00 (9.75)
-    // 9.76 GB / 15.37 GB  -- 9.76 GB / 16.33 GB   |o 0.00 (9.76)
-    // 9.85 GB / 15.37 GB  -- 9.85 GB / 16.33 GB   |######### 0.09 (9.85)
-    // 10.06 GB / 15.37 GB  -- 10.06 GB / 16.33 GB   |#################### 0.20 (10.06)
-    // 10.13 GB / 15.37 GB  -- 10.13 GB / 16.33 GB   |#######* 0.07 (10.13)
-    // 10.16 GB / 15.37 GB  -- 10.16 GB / 16.33 GB   |##* 0.03 (10.16)
-    // 10.28 GB / 15.37 GB  -- 10.28 GB / 16.33 GB   |########### 0.12 (10.28)
-    // 10.38 GB / 15.37 GB  -- 10.38 GB / 16.33 GB   |########## 0.11 (10.38)
-    //---------------------------------------
-    // ### Sessions/users ###
-    // marcelo       pts/0 (138.51.12.217)
-    // marcelo       pts/1 (tmux(277015).%0)
-    // alberto        tty7 (:0)
-    // marcelo       pts/2 (tmux(277015).%1)
-    // marcelo       pts/5 (138.51.12.217)
-    //---------------------------------------
-    // Number of CPU's: 12     Total Number of Cores: 72
-    // total cpu use = 15.57%
-    //         ||| 0.25
-    //         ||||||||| 6.93
-    //         ||||||||||||||| 12.08
-    //         |||||||||||||||| 13.83
-    //         ||||||||| 6.41
-    //         |||||||||||||||| 13.97
-    //         |||||||||||||||||| 15.37
-    //         ||||||||||||||||| 14.91
-    //         ||||||||||||||||||| 16.34
-    //         |||||||||||||||||| 15.57
-    //---------------------------------------
-    // ### System Information ###
-    // System Name = Linux
-    // Machine Name = iits-b473-01
-    // Version = #99-Ubuntu SMP Thu Sep 23 17:29:00 UTC 2021
-    // Release = 5.4.0-88-generic
-    // Architecture = x86_64
-    //---------------------------------------
+    struct display *display = context;
+    char input[256];
+    ssize_t count = read(fd, input, sizeof(input));
 
-    // create pipes for communication
-    int mem_pipe[2], cpu_pipe[2], user_pipe[2], size_pipe[2];
-    if (pipe(mem_pipe) < 0 || pipe(cpu_pipe) < 0 || pipe(user_pipe) < 0 || pipe(size_pipe) < 0)
+    if (count < 0)
     {
-        perror("Error creating pipes");
-        exit(EXIT_FAILURE);
+        return;
     }
 
-    /////////////////////////////////
-    //          CHILD
-    /////////////////////////////////
-
-    // child process for memory usage
-    pid_t mem_pid = fork();
-    if (mem_pid < 0)
+    if (count == 0 || input[0] == 'n' || input[0] == 'N')
     {
-        perror("fork");
-        exit(1);
+        // stdin was closed or the user wants to quit, stop the loop so runMonitor() finishes the output and the summary
+        printf("Exiting...\n");
+        fflush(stdout);
+        eventLoopUnwatch(fd);
+        eventLoopStop();
     }
-    else if (mem_pid == 0)
+    else if (input[0] == 'y' || input[0] == 'Y')
     {
-        signal(SIGINT, SIG_IGN); // Add this line to ignore SIGINT in the child process
-        close(mem_pipe[0]);      // close unused read end
-        for (int i = 0; i < samples; i++)
-        {
-            getMemoryUsage(mem_pipe[1]); // write to pipe
-            sleep(tdelay);               // sleep for tdelay seconds
-        }
+        // clear the message displayed if continuing
+        printf("\033[1A\033[2K\033[1A\033[2K");
+        fflush(stdout);
+        eventLoopUnwatch(fd);
+        prompting = false;
 
-        exit(0); // exit child process
+        outputBegin(display->sequential);
+        eventLoopResume();
     }
-
-    // child process for cpu usage
-    pid_t cpu_pid = fork();
-    if (cpu_pid < 0)
+    else
     {
-        perror("fork");
-        exit(1);
+        // go one line above to reask the question
+        printf("\033[1A\033[2K");
+        printf("Ctrl-C signal received. Do you want to continue? (y/n): ");
+        fflush(stdout);
     }
-    else if (cpu_pid == 0)
-    {
-        signal(SIGINT, SIG_IGN); // Add this line to ignore SIGINT in the child process
-        close(cpu_pipe[0]);      // close unused read end
-        for (int i = 0; i < samples; i++)
-        {
-            getCpuUsage(cpu_pipe[1], tdelay); // write to pipe
-        }
+}
 
-        exit(0); // exit child process
-    }
+static void handleInterrupt(int signal, void *context)
+{
+    // This function will dicatate what will occur when the monitor is interrupted. The event loop calls it with the signal it read
+    // from its signalfd (see eventLoopOnSignal() in event_loop.c). CTRL C pauses the loop, so no collector samples and no frame
+    // is drawn, and gives the user the choice to either quit or continue the program through a (y/n) option. SIGTERM and SIGHUP
+    // (or CTRL C when there is no terminal to answer from) stop the loop so the output and the summary are still finished.
+    // Example Output: Given that CTRL C IS PRESSED it prints
+    //
+    // Ctrl-C signal received. Do you want to continue? (y/n):
+    // if n: program exits
+    // if y: program continues
 
-    // child process for users
-    pid_t user_pid = fork();
-    if (user_pid < 0)
+    if (signal != SIGINT || !isatty(STDIN_FILENO))
     {
-        perror("fork");
-        exit(1);
+        eventLoopStop();
+        return;
     }
-    else if (user_pid == 0)
-    {
-        signal(SIGINT, SIG_IGN); // Add this line to ignore SIGINT in the child process
-        close(user_pipe[0]);     // close unused read end
-        for (int i = 0; i < samples; i++)
-        {
-            getUsers(user_pipe[1], size_pipe[1]); // write to pipe
-            sleep(tdelay);                        // sleep for tdelay seconds
-        }
-
-        exit(0); // exit child process
-    }
-
-    /////////////////////////////////
-    //          PARENT
-    /////////////////////////////////
 
-    // redirect incoming signals for CTRL C
-    if (signal(SIGINT, handle_ctrl_c) == SIG_ERR)
+    // ignore a second ctrl c while the question is already up
+    if (prompting)
     {
-        perror("Error registering SIGINT handler");
-        exit(1);
+        return;
     }
+    prompting = true;
 
-    // close unused write ends of pipes
-    close(mem_pipe[1]);
-    close(cpu_pipe[1]);
-    close(user_pipe[1]);
-    close(size_pipe[1]);
-
-    // clear terminal before starting and take an intial measurement for the cpu usage calculation
-    printf("\033c");
+    eventLoopPause();
+    outputFinish(); // the frames that are still queued come before the question
 
-    // print headers
-    header(samples, tdelay);
-    printf("---------------------------------------\n");
-    printf("### Memory ### (Phys.Used/Tot -- Virtual Used/Tot) \n");
+    printf("\n");
+    printf("\033[2K");
+    printf("Ctrl-C signal received. Do you want to continue? (y/n): ");
+    fflush(stdout);
 
-    // keep track of lines
-    int usersLineNumber = samples + 6;
-    int memoryLineNumber = 6;
+    eventLoopWatch(STDIN_FILENO, answerPrompt, context);
+}
 
-    float usage;
+static void handleUpdate(struct collector *collector, void *context)
+{
+    // This function is called by the event loop every time a collector sent a new sample (see eventLoopOnUpdate() in event_loop.c).
+    // A memory or cpu sample is stored in the alert snapshot and the rules on that collector's metrics are evaluated, so the rules
+    // see every sample of their collector whatever the frame rate.
 
-    // wait for all child processes to finish
-    fd_set read_fds;
+    struct display *display = context;
+    int source = 0;
 
-    int max_fd = mem_pipe[0];
-    if (cpu_pipe[0] > max_fd)
+    if (collector == display->memory)
     {
-        max_fd = cpu_pipe[0];
+        recordMemoryUsage(collector->latest);
+        source = ALERT_MEMORY;
     }
-    if (user_pipe[0] > max_fd)
+    else if (collector == display->cpu)
     {
-        max_fd = user_pipe[0];
+        recordCpuUsage(collector->latest);
+        source = ALERT_CPU;
     }
 
-    // store previous cpu and memory results
-    float cpu_usage[samples][2];
-    float memory_usage[samples];
-
-    // print all information
-    for (int i = 0; i < samples; i++)
+    if (source == 0 || alertsCount() == 0)
     {
-        // wait for all child processes to finish
-        FD_ZERO(&read_fds);
-        FD_SET(mem_pipe[0], &read_fds);
-        FD_SET(cpu_pipe[0], &read_fds);
-        FD_SET(user_pipe[0], &read_fds);
-        select(max_fd + 1, &read_fds, NULL, NULL, NULL);
-
-        // read and print output
-        if (FD_ISSET(mem_pipe[0], &read_fds))
-        {
-            printf("\033[%d;0H", (memoryLineNumber)); // move cursor to memory
-            char buf[100];
-            read(mem_pipe[0], buf, sizeof(buf)); // read memory usage from pipe
-
-            // get total usage
-            float dummy;
-            float dummy2;
-            float usage;
-            float dummy3;
-            sscanf(buf, "%f GB / %f GB  --  %f GB / %f GB\n", &dummy, &dummy2, &usage, &dummy3);
-
-            // add to array
-            memory_usage[i] = usage;
-
-            char print[500];
+        return;
+    }
 
-            if (i == 0)
-            {
-                strcpy(print, getMemoryUsageGraphic(usage, 0));
-            }
-            else
-            {
-                strcpy(print, getMemoryUsageGraphic(usage, memory_usage[i - 1]));
-            }
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
 
-            int len = strlen(buf);
-            if (len > 0)
-            {
-                buf[len - 1] = '\0'; // set the null terminator one character earlier
-            }
+    snapshot.timestamp = now.tv_sec + now.tv_nsec / 1e9;
+    alertsEvaluate(&snapshot, source);
+}
 
-            printf("%s   %s", buf, print);
-        }
+static void renderFrame(int frame, void *context)
+{
+    // This function draws one frame of the output with the latest values of every collector. It is called by the event loop
+    // every tdelay seconds (see eventLoopRun() in event_loop.c).
 
-        printf("\033[%d;0H", (usersLineNumber)); // move cursor to users
-        printf("---------------------------------------\n");
-        printf("### Sessions/users ###\n");
-        printf("\033[J"); // clears everything below the current line
+    struct display *display = context;
 
-        // Read and print the user data from the user_pipe
-        char size[100];
-        read(size_pipe[0], size, sizeof(size));
-        int length = atoi(size);
-        char buf[length];
-        read(user_pipe[0], buf, sizeof(buf)); // read memory usage from pipe
-        printf("%s", buf);
+    // the frame is printed into the output queue, which drops the update frames the terminal is too slow for (see output.c)
+    bool replacing;
+    FILE *out = outputFrameStart(&replacing);
 
-        printf("---------------------------------------\n");
-        getCpuNumber();
+    if (display->sequential)
+    {
+        // every frame is printed below the previous one
+        fprintf(out, "\r"); // clear current line in case CTRL Z has been called
+        fprintf(out, ">>> Iteration: %d\n", frame + 1);
+        header(out, display->samples, display->tdelay);
 
-        if (i > 0)
+        if (display->sections & SHOW_MEMORY)
         {
-            // print usage
-            printf(" total cpu use = %.2f %%\n", usage);
+            fprintf(out, "---------------------------------------\n");
+            fprintf(out, "### Memory ### (Phys.Used/Tot -- Virtual Used/Tot) \n");
 
-            for (int j = 0; j < i; j++)
+            // create the needed spaces
+            for (int j = 0; j < display->samples; j++)
             {
-                char print[1024];
-
-                if (j != 0)
+                if (j == frame)
                 {
-                    strcpy(print, getCpuUsageGraphic(cpu_usage[j][1], cpu_usage[j - 1][1], cpu_usage[j - 1][0]));
+                    printMemoryLine(out, display, frame);
                 }
                 else
                 {
-                    strcpy(print, getCpuUsageGraphic(cpu_usage[j][1], 0, 0));
+                    fprintf(out, "\n");
                 }
-                // Scan the first number and the number of characters read
-                int chars_read;
-                int num1;
-                sscanf(print, "%d%n", &num1, &chars_read);
-
-                // Move the remaining part of the string to the left, starting after the first number
-                memmove(print, print + chars_read, strlen(print + chars_read) + 1);
-
-                printf("%s\n", print);
             }
         }
-
-        // Read and print the CPU usage data from the cpu_pipe
-        char buf2[1024];
-        read(cpu_pipe[0], buf2, sizeof(buf2)); // read memory usage from pipe
-        usage = atof(buf2);
-        char str[150];
-
-        if (i == 0)
-        {
-            stpcpy(str, getCpuUsageGraphic(usage, 0, 0));
-        }
-        else
+        if (display->sections & SHOW_USERS)
         {
-            stpcpy(str, getCpuUsageGraphic(usage, cpu_usage[i - 1][1], cpu_usage[i - 1][0]));
+            fprintf(out, "---------------------------------------\n");
+            printUsers(out, display, frame);
         }
-
-        int bars;
-        float dummy;
-
-        sscanf(str, "%d |%*[^|]|%*[^|]|%*[^|] %f", &bars, &dummy);
-
-        // update cpu_usage array
-        cpu_usage[i][0] = bars;
-        cpu_usage[i][1] = usage;
-
-        if (i == samples - 1)
+        if (display->sections & SHOW_CPU)
         {
-            printf("\033[1A"); // move the cursor up one line
-            printf("\033[2K"); // clear the entire line
+            fprintf(out, "---------------------------------------\n");
+            printCpu(out, display, frame);
         }
+        printPanels(out, frame);
 
-        // update line numbers
-        memoryLineNumber = memoryLineNumber + 1;
-
-        // clear buffer
-        fflush(stdout);
+        fprintf(out, "\n");
     }
+    else if (display->sections == SHOW_USERS)
+    {
+        // the users list is redrawn on a clear screen
+        fprintf(out, "\033c");
+        header(out, display->samples, display->tdelay);
+        fprintf(out, "---------------------------------------\n");
+        printUsers(out, display, frame);
+        printPanels(out, frame);
+        fprintf(out, "---------------------------------------\n");
+    }
+    else
+    {
+        // the memory lines are filled in one per frame and the sections below them are redrawn in place
+        refreshHeader(out, display->samples, display->tdelay, display->headerLines);
 
-    // wait for processes to finish so no orphan or zombie cases
-    int status;
-    waitpid(mem_pid, &status, 0);
-    waitpid(cpu_pid, &status, 0);
-    waitpid(user_pid, &status, 0);
-
-    printf("\033[%dA", (samples - 1)); // move cursor up 9 lines
+        if (display->sections & SHOW_MEMORY)
+        {
+            // a frame that replaces one the terminal never got also draws the memory lines that frame would have left behind
+            for (int j = replacing ? 0 : frame; j < frame; j++)
+            {
+                fprintf(out, "\033[%d;0H\033[2K%s\n", display->memoryLineNumber + j, display->memoryLines[j]);
+            }
 
-    // print usage
-    printf(" total cpu use = %.2f %%\n", usage);
-    printf("\033[J"); // clears everything below the current line
+            fprintf(out, "\033[%d;0H", display->memoryLineNumber + frame); // move cursor to memory
+            fprintf(out, "\033[2K");
+            printMemoryLine(out, display, frame);
+        }
 
-    for (int j = 0; j < samples; j++)
-    {
-        char print[1024];
+        fprintf(out, "\033[%d;0H", display->memoryLineNumber + display->samples); // move cursor below the memory lines
+        fprintf(out, "\033[J");                                                    // clears everything below the current line
 
-        if (j != 0)
+        if (display->sections & SHOW_USERS)
         {
-            strcpy(print, getCpuUsageGraphic(cpu_usage[j][1], cpu_usage[j - 1][1], cpu_usage[j - 1][0]));
+            fprintf(out, "---------------------------------------\n");
+            printUsers(out, display, frame);
+            fprintf(out, "---------------------------------------\n");
         }
-        else
+        if (display->sections & SHOW_CPU)
         {
-            strcpy(print, getCpuUsageGraphic(cpu_usage[j][1], 0, 0));
+            printCpu(out, display, frame);
         }
-        // Scan the first number and the number of characters read
-        int chars_read;
-        int num1;
-        sscanf(print, "%d%n", &num1, &chars_read);
-
-        // Move the remaining part of the string to the left, starting after the first number
-        memmove(print, print + chars_read, strlen(print + chars_read) + 1);
-
-        printf("%s\n", print);
+        printPanels(out, frame);
     }
 
-    // print the ending system details
-    printf("---------------------------------------\n");
-    printf("### System Information ### \n");
-    getSystemInfo();
-    printf("---------------------------------------\n");
+    // close the sample for the overhead measurements
+    overheadSample();
+
+    // queue the frame and write what the terminal takes (timed as the write stage in output.c)
+    outputFrameEnd();
 }
 
-void usersUpdate(int samples, int tdelay)
+static void runMonitor(int samples, int tdelay, int sections, bool sequential, bool graphic)
 {
-    // This function will take in int samples and tdelay and prints out all the user information that will update
-    // in the specified time interval and the specified number of samples. The information given includes users logged in,
-    // their individual sessions, and system information.
-    // NOTE: Getting users is an individual processes that communicates through pipes
+    // This function runs every output mode: it forks one collector process per shown section (memory usage, cpu usage, users, and
+    // the memory or cpu usage an alert rule watches even when it is not shown), lets the event loop sample each of them on its own
+    // interval (see setCollectorIntervals()) and draw a frame every tdelay seconds for the given number of samples, then stops the
+    // collectors and prints the system information (which is only read once).
+    // NOTE: A collector that has not sent anything new since the previous frame is flagged (late) instead of holding the frame back
     // Example Output:
-    // usersUpdate(10, 1) prints
-    //
-    // Nbr of samples: 10 -- every 1 secs
-    // Memory Usage: 3924 kilobytes
-    // ---------------------------------------
-    // ### Sessions/users ###
-    // dodajkri      pts/1 (tmux(97972).%0)
-    // dodajkri      pts/0 (138.51.8.149)
-    // ---------------------------------------
-    // ### System Information ###
-    // System Name = Linux
-    // Machine Name = iits-b473-27
-    // Version = #62-Ubuntu SMP Tue Nov 22 19:54:14 UTC 2022
-    // Release = 5.15.0-56-generic
-    // Architecture = x86_64
-    // ---------------------------------------
+    // runMonitor(10, 1, SHOW_MEMORY | SHOW_CPU, false, false) prints the output of systemUpdate(10, 1)
 
-    int user_pipe[2], size_pipe[2];
-    if (pipe(user_pipe) < 0 || pipe(size_pipe) < 0)
-    {
-        perror("Error creating pipes");
-        exit(EXIT_FAILURE);
-    }
+    struct display display = {.samples = samples, .tdelay = tdelay, .sections = sections, .sequential = sequential, .graphic = graphic};
+
+    struct collector memory, cpu, users;
+    struct collector *collectors[3 + PANEL_COUNT];
+    int count = 0;
+    graphicMode = graphic;
 
     /////////////////////////////////
     //          CHILD
     /////////////////////////////////
 
-    // child process for memory usage
-    pid_t user_pid = fork();
-    if (user_pid < 0)
+    // the memory and cpu collectors also run when a section is not shown but an alert rule watches it (ex. --user with --alert)
+    if ((sections & SHOW_MEMORY) || (alertsSources() & ALERT_MEMORY))
+    {
+        startCollector(&memory, "memory", getMemoryUsage, memoryInterval > 0 ? memoryInterval : tdelay * 1000);
+        display.memory = collectors[count++] = &memory;
+    }
+    if ((sections & SHOW_CPU) || (alertsSources() & ALERT_CPU))
+    {
+        startCollector(&cpu, "cpu", getCpuUsage, cpuInterval > 0 ? cpuInterval : tdelay * 1000);
+        display.cpu = collectors[count++] = &cpu;
+    }
+    if (sections & SHOW_USERS)
     {
-        perror("fork");
-        exit(1);
+        startCollector(&users, "users", getUsers, usersInterval > 0 ? usersInterval : tdelay * 1000);
+        display.users = collectors[count++] = &users;
     }
-    else if (user_pid == 0)
+    for (int i = 0; i < PANEL_COUNT; i++)
     {
-        signal(SIGINT, SIG_IGN); // Add this line to ignore SIGINT in the child process
-        close(user_pipe[0]);     // close unused read end
-        for (int i = 0; i < samples; i++)
+        if (panels[i].enabled)
         {
-            getUsers(user_pipe[1], size_pipe[1]); // write to pipe
-            sleep(tdelay);                        // sleep for tdelay seconds
+            startCollector(&panels[i].collector, panels[i].name, panels[i].sample, tdelay * 1000);
+            collectors[count++] = &panels[i].collector;
         }
-
-        exit(0); // exit child process
     }
 
     /////////////////////////////////
-    //         PARENT
+    //          PARENT
     /////////////////////////////////
 
-    // redirect incoming signals for CTRL C
-    if (signal(SIGINT, handle_ctrl_c) == SIG_ERR)
+    // CTRL C pauses the run and asks whether to continue (read by the event loop, see handleInterrupt())
+    eventLoopOnSignal(handleInterrupt, &display);
+
+    // the alert rules are evaluated on every memory and cpu sample as it arrives (see handleUpdate())
+    eventLoopOnUpdate(handleUpdate, &display);
+
+    // store previous cpu and memory results for the graphics
+    display.memoryHistory = calloc(samples, sizeof(float));
+    display.cpuHistory = calloc(samples, sizeof(float[2]));
+    display.memoryLines = calloc(samples, MEMORY_LINE_LENGTH);
+    if (!display.memoryHistory || !display.cpuHistory || !display.memoryLines)
     {
-        perror("Error registering SIGINT handler");
-        exit(1);
+        perror("Error allocating memory");
+        exit(EXIT_FAILURE);
     }
 
-    // close unused write ends of pipes
-    close(user_pipe[1]);
-    close(size_pipe[1]);
-
     // clear terminal before starting
     printf("\033c");
 
-    fd_set read_fds;
+    if (!sequential && sections != SHOW_USERS)
+    {
+        // print headers, the frames then fill in the lines below them
+        display.headerLines = header(stdout, samples, tdelay);
+        display.memoryLineNumber = display.headerLines + 3;
+
+        printf("---------------------------------------\n");
+        printf("### Memory ### (Phys.Used/Tot -- Virtual Used/Tot) \n");
+        fflush(stdout);
+    }
 
-    // print all user information
-    for (int i = 0; i < samples; i++)
+    // the sequential modes keep every frame, the others only the newest when the terminal falls behind
+    outputBegin(sequential);
+    eventLoopRun(collectors, count, samples, tdelay, renderFrame, &display);
+    eventLoopOnUpdate(NULL, NULL);
+    outputFinish();
+
+    // stop the processes so no orphan or zombie cases
+    for (int i = 0; i < count; i++)
     {
+        collectorStop(collectors[i]);
+    }
 
-        // wait for all child processes to finish
-        FD_ZERO(&read_fds);
-        FD_SET(user_pipe[0], &read_fds);
-        select(user_pipe[0] + 1, &read_fds, NULL, NULL, NULL);
+    free(display.memoryHistory);
+    free(display.cpuHistory);
+    free(display.memoryLines);
+    overheadLogClose();
 
-        header(samples, tdelay);
+    // print the ending system details
+    if (sequential)
+    {
+        printf("\033[1A");
+    }
+    if (sequential || sections != SHOW_USERS)
+    {
         printf("---------------------------------------\n");
-        printf("### Sessions/users ###\n");
+    }
+    printf("### System Information ### \n");
+    getSystemInfo();
+    printf("---------------------------------------\n");
+}
 
-        // read and print output
-        if (FD_ISSET(user_pipe[0], &read_fds))
-        {
+static void daemonTick(int frame, void *context)
+{
+    // This function is called by the daemon's event loop every tdelay seconds in place of drawing a frame, it only closes the
+    // sample of the overhead measurements (see overheadSample() in overhead.c)
+    overheadSample();
+}
 
-            // Read and print the user data from the user_pipe
-            char size[100];
-            read(size_pipe[0], size, sizeof(size));
-            int length = atoi(size);
-            char buf[length];
-            read(user_pipe[0], buf, sizeof(buf)); // read memory usage from pipe
-            printf("%s", buf);
-        }
+void runDaemon(const char *path, int tdelay, bool graphic)
+{
+    // This function runs the --daemon mode: it forks the memory, cpu and users collectors and every enabled panel once, each sampled
+    // on its own interval, and serves their latest values to the viewers started with --connect on the Unix domain socket at path
+    // (see daemonServe() in daemon.c). It does not draw anything and runs until it receives SIGTERM, SIGHUP or CTRL C, then
+    // stops its collectors and removes the socket.
+    // NOTE: Panels are generated by the daemon, so graphics inside them follow the daemon's --graphics flag
+    // Example Output:
+    // runDaemon("/run/user/1000/system-monitor.sock", 1, false) prints
+    //
+    // Serving memory, cpu, users, perf on /run/user/1000/system-monitor.sock
 
-        printf("---------------------------------------\n");
+    struct collector memory, cpu, users;
+    struct collector *collectors[3 + PANEL_COUNT];
+    int count = 0;
+    graphicMode = graphic;
 
-        if (i != samples - 1)
+    collectorStart(&memory, "memory", getMemoryUsage, memoryInterval > 0 ? memoryInterval : tdelay * 1000);
+    collectors[count++] = &memory;
+    collectorStart(&cpu, "cpu", getCpuUsage, cpuInterval > 0 ? cpuInterval : tdelay * 1000);
+    collectors[count++] = &cpu;
+    collectorStart(&users, "users", getUsers, usersInterval > 0 ? usersInterval : tdelay * 1000);
+    collectors[count++] = &users;
+    for (int i = 0; i < PANEL_COUNT; i++)
+    {
+        if (panels[i].enabled)
         {
-            // clear buffer
-            fflush(stdout);
-            // clear screen
-            printf("\033c");
+            collectorStart(&panels[i].collector, panels[i].name, panels[i].sample, tdelay * 1000);
+            collectors[count++] = &panels[i].collector;
         }
     }
 
-    // wait for processes to finish so no orphan or zombie cases
-    int status;
-    waitpid(user_pid, &status, 0);
+    daemonServe(path, collectors, count);
 
-    // print the ending system details
-    printf("### System Information ### \n");
-    getSystemInfo();
-    printf("---------------------------------------\n");
+    // without a signal handler the loop returns on the first SIGTERM, SIGHUP or CTRL C
+    eventLoopOnSignal(NULL, NULL);
+    eventLoopRun(collectors, count, -1, tdelay, daemonTick, NULL);
+
+    daemonStop();
+    for (int i = 0; i < count; i++)
+    {
+        collectorStop(collectors[i]);
+    }
+    overheadLogClose();
+    printf("Daemon stopped\n");
 }
 
-void systemUpdate(int samples, int tdelay)
+void allInfoUpdate(int samples, int tdelay)
 {
-    // This function will take in int samples and tdelay and prints out the system information that will update
+    // This function will take in int samples and tdelay and prints out all the system information that will update
     // in the specified time interval and the specified number of samples. The information given includes memory usage,
-    // cpu information, system information and are implemented through the above listed functions.
-    // NOTE: Cpu Usage and Memory Usage are individual processes that communicate through pipes
+    // user logs, cpu information, system information and are implemented through the above listed functions.
+    // NOTE: Cpu Usage, Memory Usage, and Users are individual processes that communicate through pipes (see runMonitor())
     // Example Output:
-    // systemUpdate(10, 1) prints
+    // allInfoUpdate(10, 1) prints
     //
     // Nbr of samples: 10 -- every 1 secs
     // Memory Usage: 3924 kilobytes
     // ---------------------------------------
     // 2.98 GB / 15.32 GB  --  2.98 GB / 16.28 GBsed/Tot)
-    // 2.98 GB / 15.32 GB  --  2.98 GB / 16.28 GB
-    // 2.98 GB / 15.32 GB  --  2.98 GB / 16.28 GB
-    // 2.98 GB / 15.32 GB  --  2.98 GB / 16.28 GB
-    // 2.98 GB / 15.32 GB  --  2.98 GB / 16.28 GB
-    // 2.98 GB / 15.32 GB  --  2.98 GB / 16.28 GB
-    // 2.98 GB / 15.32 GB  --  2.98 GB / 16.28 GB
-    // 2.98 GB / 15.32 GB  --  2.98 GB / 16.28 GB
-    // 2.98 GB / 15.32 GB  --  2.98 GB / 16.28 GB
-    // 2.97 GB / 15.32 GB  --  2.97 GB / 16.28 GB
+    // 2.99 GB / 15.32 GB  --  2.99 GB / 16.28 GB
+    // 2.99 GB / 15.32 GB  --  2.99 GB / 16.28 GB
+    // 2.99 GB / 15.32 GB  --  2.99 GB / 16.28 GB
+    // 2.99 GB / 15.32 GB  --  2.99 GB / 16.28 GB
+    // 2.99 GB / 15.32 GB  --  2.99 GB / 16.28 GB
+    // 2.99 GB / 15.32 GB  --  2.99 GB / 16.28 GB
+    // 2.99 GB / 15.32 GB  --  2.99 GB / 16.28 GB
+    // 2.99 GB / 15.32 GB  --  2.99 GB / 16.28 GB
+    // 2.99 GB / 15.32 GB  --  2.99 GB / 16.28 GB
+    // ---------------------------------------
+    // ### Sessions/users ###
+    // dodajkri      pts/1 (tmux(97972).%0)
+    // dodajkri      pts/0 (138.51.8.149)
+    // ---------------------------------------
     // Number of CPU's: 12     Total Number of Cores: 72
-    //  total cpu use = 0.00 %
+    //  total cpu use = 0.01 %
     // ---------------------------------------
     // ### System Information ###
     // System Name = Linux
@@ -1252,146 +1263,125 @@ void systemUpdate(int samples, int tdelay)
     // Architecture = x86_64
     // ---------------------------------------
 
-    int mem_pipe[2], cpu_pipe[2];
-    if (pipe(mem_pipe) < 0 || pipe(cpu_pipe) < 0)
-    {
-        perror("Error creating pipes");
-        exit(EXIT_FAILURE);
-    }
+    runMonitor(samples, tdelay, SHOW_MEMORY | SHOW_USERS | SHOW_CPU, false, false);
+}
 
-    /////////////////////////////////
-    //          CHILD
-    /////////////////////////////////
-
-    // child process for memory usage
-    pid_t mem_pid = fork();
-    if (mem_pid < 0)
-    {
-        perror("fork");
-        exit(1);
-    }
-    else if (mem_pid == 0)
-    {
-        signal(SIGINT, SIG_IGN); // Add this line to ignore SIGINT in the child process
-        close(mem_pipe[0]);      // close unused read end
-        for (int i = 0; i < samples; i++)
-        {
-            getMemoryUsage(mem_pipe[1]); // write to pipe
-            sleep(tdelay);               // sleep for tdelay seconds
-        }
-
-        exit(0); // exit child process
-    }
-
-    // child process for cpu usage
-    pid_t cpu_pid = fork();
-    if (cpu_pid < 0)
-    {
-        perror("fork");
-        exit(1);
-    }
-    else if (cpu_pid == 0)
-    {
-        signal(SIGINT, SIG_IGN); // Add this line to ignore SIGINT in the child process
-        close(cpu_pipe[0]);      // close unused read end
-        for (int i = 0; i < samples; i++)
-        {
-            getCpuUsage(cpu_pipe[1], tdelay); // write to pipe
-        }
-
-        exit(0); // exit child process
-    }
-
-    /////////////////////////////////
-    //          PARENT
-    /////////////////////////////////
-
-    // redirect incoming signals for CTRL C
-    if (signal(SIGINT, handle_ctrl_c) == SIG_ERR)
-    {
-        perror("Error registering SIGINT handler");
-        exit(1);
-    }
-
-    // close unused write ends of pipes
-    close(mem_pipe[1]);
-    close(cpu_pipe[1]);
-
-    // clear terminal before starting
-    printf("\033c");
-
-    // print headers
-    header(samples, tdelay);
-    printf("---------------------------------------\n");
-    printf("### Memory ### (Phys.Used/Tot -- Virtual Used/Tot) \n");
-
-    // keep track of lines
-    int cpuLineNumber = samples + 6;
-    int memoryLineNumber = 6;
-    float usage;
-
-    fd_set read_fds;
-    int max_fd = (mem_pipe[0] > cpu_pipe[0]) ? mem_pipe[0] : cpu_pipe[0];
-
-    // print all system info
-    for (int i = 0; i < samples; i++)
-    {
-
-        // wait for all child processes to finish
-        FD_ZERO(&read_fds);
-        FD_SET(mem_pipe[0], &read_fds);
-        FD_SET(cpu_pipe[0], &read_fds);
-        select(max_fd + 1, &read_fds, NULL, NULL, NULL);
-
-        // read and print output
-        if (FD_ISSET(mem_pipe[0], &read_fds))
-        {
-            printf("\033[%d;0H", (memoryLineNumber)); // move cursor to memory
-            char buf[100];
-            read(mem_pipe[0], buf, sizeof(buf)); // read memory usage from pipe
-            printf("%s", buf);
-        }
-
-        printf("\033[%d;0H", (cpuLineNumber)); // move cursor to cpu usage
-        getCpuNumber();
-
-        if (i > 0)
-        {
-            // print usage
-            printf(" total cpu use = %.2f %%\n", usage);
-        }
-
-        // Read and print the CPU usage data from the cpu_pipe
-        char buf2[1024];
-        read(cpu_pipe[0], buf2, sizeof(buf2)); // read memory usage from pipe
-        usage = atof(buf2);
-
-        if (i == samples - 1)
-        {
-            printf("\033[1A"); // move the cursor up one line
-            printf("\033[2K"); // clear the entire line
-        }
+void allInfoUpdateGraphic(int samples, int tdelay)
+{
+    // This function will take in int samples and tdelay and prints out all the system information including graphics that will update
+    // in the specified time interval and the specified number of samples. The information given includes memory usage,
+    // user logs, cpu information, system information and are implemented through the above listed functions.
+    // NOTE: Cpu Usage, Memory Usage, and Users are individual processes that communicate through pipes (see runMonitor())
+    // Example Output:
+    // allInfoUpdateGraphic(10, 1) prints
+    //
+    // Nbr of samples: 10 -- every 1 secs
+    // Memory usage: 4052 kilobytes
+    //---------------------------------------
+    // ### Memory ### (Phys.Used/Tot -- Virtual Used/Tot)
+    // 9.75 GB / 15.37 GB  -- 9.75 GB / 16.33 GB   |o 0.00 (9.75)
+    // 9.75 GB / 15.37 GB  -- 9.75 GB / 16.33 GB   |o 0.00 (9.75)
+    // 9.75 GB / 15.37 GB  -- 9.75 GB / 16.33 GB   |o 0.00 (9.75)
+    // 9.76 GB / 15.37 GB  -- 9.76 GB / 16.33 GB   |o 0.00 (9.76)
+    // 9.85 GB / 15.37 GB  -- 9.85 GB / 16.33 GB   |######### 0.09 (9.85)
+    // 10.06 GB / 15.37 GB  -- 10.06 GB / 16.33 GB   |#################### 0.20 (10.06)
+    // 10.13 GB / 15.37 GB  -- 10.13 GB / 16.33 GB   |#######* 0.07 (10.13)
+    // 10.16 GB / 15.37 GB  -- 10.16 GB / 16.33 GB   |##* 0.03 (10.16)
+    // 10.28 GB / 15.37 GB  -- 10.28 GB / 16.33 GB   |########### 0.12 (10.28)
+    // 10.38 GB / 15.37 GB  -- 10.38 GB / 16.33 GB   |########## 0.11 (10.38)
+    //---------------------------------------
+    // ### Sessions/users ###
+    // marcelo       pts/0 (138.51.12.217)
+    // marcelo       pts/1 (tmux(277015).%0)
+    // alberto        tty7 (:0)
+    // marcelo       pts/2 (tmux(277015).%1)
+    // marcelo       pts/5 (138.51.12.217)
+    //---------------------------------------
+    // Number of CPU's: 12     Total Number of Cores: 72
+    // total cpu use = 15.57%
+    //         ||| 0.25
+    //         ||||||||| 6.93
+    //         ||||||||||||||| 12.08
+    //         |||||||||||||||| 13.83
+    //         ||||||||| 6.41
+    //         |||||||||||||||| 13.97
+    //         |||||||||||||||||| 15.37
+    //         ||||||||||||||||| 14.91
+    //         ||||||||||||||||||| 16.34
+    //         |||||||||||||||||| 15.57
+    //---------------------------------------
+    // ### System Information ###
+    // System Name = Linux
+    // Machine Name = iits-b473-01
+    // Version = #99-Ubuntu SMP Thu Sep 23 17:29:00 UTC 2021
+    // Release = 5.4.0-88-generic
+    // Architecture = x86_64
+    //---------------------------------------
 
-        // update line numbers
-        memoryLineNumber = memoryLineNumber + 1;
+    runMonitor(samples, tdelay, SHOW_MEMORY | SHOW_USERS | SHOW_CPU, false, true);
+}
 
-        // clear buffer
-        fflush(stdout);
-    }
+void usersUpdate(int samples, int tdelay)
+{
+    // This function will take in int samples and tdelay and prints out all the user information that will update
+    // in the specified time interval and the specified number of samples. The information given includes users logged in,
+    // their individual sessions, and system information.
+    // NOTE: Getting users is an individual processes that communicates through pipes (see runMonitor())
+    // Example Output:
+    // usersUpdate(10, 1) prints
+    //
+    // Nbr of samples: 10 -- every 1 secs
+    // Memory Usage: 3924 kilobytes
+    // ---------------------------------------
+    // ### Sessions/users ###
+    // dodajkri      pts/1 (tmux(97972).%0)
+    // dodajkri      pts/0 (138.51.8.149)
+    // ---------------------------------------
+    // ### System Information ###
+    // System Name = Linux
+    // Machine Name = iits-b473-27
+    // Version = #62-Ubuntu SMP Tue Nov 22 19:54:14 UTC 2022
+    // Release = 5.15.0-56-generic
+    // Architecture = x86_64
+    // ---------------------------------------
 
-    // wait for processes to finish so no orphan or zombie cases
-    int status;
-    waitpid(mem_pid, &status, 0);
-    waitpid(cpu_pid, &status, 0);
+    runMonitor(samples, tdelay, SHOW_USERS, false, false);
+}
 
-    // print usage
-    printf(" total cpu use = %.2f %%\n", usage);
+void systemUpdate(int samples, int tdelay)
+{
+    // This function will take in int samples and tdelay and prints out the system information that will update
+    // in the specified time interval and the specified number of samples. The information given includes memory usage,
+    // cpu information, system information and are implemented through the above listed functions.
+    // NOTE: Cpu Usage and Memory Usage are individual processes that communicate through pipes (see runMonitor())
+    // Example Output:
+    // systemUpdate(10, 1) prints
+    //
+    // Nbr of samples: 10 -- every 1 secs
+    // Memory Usage: 3924 kilobytes
+    // ---------------------------------------
+    // 2.98 GB / 15.32 GB  --  2.98 GB / 16.28 GBsed/Tot)
+    // 2.98 GB / 15.32 GB  --  2.98 GB / 16.28 GB
+    // 2.98 GB / 15.32 GB  --  2.98 GB / 16.28 GB
+    // 2.98 GB / 15.32 GB  --  2.98 GB / 16.28 GB
+    // 2.98 GB / 15.32 GB  --  2.98 GB / 16.28 GB
+    // 2.98 GB / 15.32 GB  --  2.98 GB / 16.28 GB
+    // 2.98 GB / 15.32 GB  --  2.98 GB / 16.28 GB
+    // 2.98 GB / 15.32 GB  --  2.98 GB / 16.28 GB
+    // 2.98 GB / 15.32 GB  --  2.98 GB / 16.28 GB
+    // 2.97 GB / 15.32 GB  --  2.97 GB / 16.28 GB
+    // Number of CPU's: 12     Total Number of Cores: 72
+    //  total cpu use = 0.00 %
+    // ---------------------------------------
+    // ### System Information ###
+    // System Name = Linux
+    // Machine Name = iits-b473-27
+    // Version = #62-Ubuntu SMP Tue Nov 22 19:54:14 UTC 2022
+    // Release = 5.15.0-56-generic
+    // Architecture = x86_64
+    // ---------------------------------------
 
-    // print the ending system details
-    printf("---------------------------------------\n");
-    printf("### System Information ### \n");
-    getSystemInfo();
-    printf("---------------------------------------\n");
+    runMonitor(samples, tdelay, SHOW_MEMORY | SHOW_CPU, false, false);
 }
 
 void systemUpdateGraphic(int samples, int tdelay)
@@ -1399,7 +1389,7 @@ void systemUpdateGraphic(int samples, int tdelay)
     // This function will take in int samples and tdelay and prints out the system information graphically and will update
     // in the specified time interval and the specified number of samples. The information given includes memory usage,
     // cpu information, system information and are implemented through the above listed functions.
-    // NOTE: Cpu Usage and Memory Usage are individual processes that communicate through pipes
+    // NOTE: Cpu Usage and Memory Usage are individual processes that communicate through pipes (see runMonitor())
     // Example Output:
     // systemUpdate(10, 1) prints
     //
@@ -1438,246 +1428,7 @@ void systemUpdateGraphic(int samples, int tdelay)
     // Architecture = x86_64
     //---------------------------------------
 
-    int mem_pipe[2], cpu_pipe[2];
-    if (pipe(mem_pipe) < 0 || pipe(cpu_pipe) < 0)
-    {
-        perror("Error creating pipes");
-        exit(EXIT_FAILURE);
-    }
-
-    /////////////////////////////////
-    //          CHILD
-    /////////////////////////////////
-
-    // child process for memory usage
-    pid_t mem_pid = fork();
-    if (mem_pid < 0)
-    {
-        perror("fork");
-        exit(1);
-    }
-    else if (mem_pid == 0)
-    {
-        signal(SIGINT, SIG_IGN); // Add this line to ignore SIGINT in the child process
-        close(mem_pipe[0]);      // close unused read end
-        for (int i = 0; i < samples; i++)
-        {
-            getMemoryUsage(mem_pipe[1]); // write to pipe
-            sleep(tdelay);               // sleep for tdelay seconds
-        }
-
-        exit(0); // exit child process
-    }
-
-    // child process for cpu usage
-    pid_t cpu_pid = fork();
-    if (cpu_pid < 0)
-    {
-        perror("fork");
-        exit(1);
-    }
-    else if (cpu_pid == 0)
-    {
-        signal(SIGINT, SIG_IGN); // Add this line to ignore SIGINT in the child process
-        close(cpu_pipe[0]);      // close unused read end
-        for (int i = 0; i < samples; i++)
-        {
-            getCpuUsage(cpu_pipe[1], tdelay); // write to pipe
-        }
-
-        exit(0); // exit child process
-    }
-
-    /////////////////////////////////
-    //          PARENT
-    /////////////////////////////////
-
-    // redirect incoming signals for CTRL C
-    if (signal(SIGINT, handle_ctrl_c) == SIG_ERR)
-    {
-        perror("Error registering SIGINT handler");
-        exit(1);
-    }
-
-    // close unused write ends of pipes
-    close(mem_pipe[1]);
-    close(cpu_pipe[1]);
-
-    // clear terminal before starting
-    printf("\033c");
-
-    // print headers
-    header(samples, tdelay);
-    printf("---------------------------------------\n");
-    printf("### Memory ### (Phys.Used/Tot -- Virtual Used/Tot) \n");
-
-    // keep track of lines
-    int cpuLineNumber = samples + 6;
-    int memoryLineNumber = 6;
-    float usage;
-
-    fd_set read_fds;
-    int max_fd = (mem_pipe[0] > cpu_pipe[0]) ? mem_pipe[0] : cpu_pipe[0];
-
-    // store previous cpu and memory results
-    float cpu_usage[samples][2];
-    float memory_usage[samples];
-
-    // print all system info
-    for (int i = 0; i < samples; i++)
-    {
-
-        // wait for all child processes to finish
-        FD_ZERO(&read_fds);
-        FD_SET(mem_pipe[0], &read_fds);
-        FD_SET(cpu_pipe[0], &read_fds);
-        select(max_fd + 1, &read_fds, NULL, NULL, NULL);
-
-        // read and print output
-        if (FD_ISSET(mem_pipe[0], &read_fds))
-        {
-            printf("\033[%d;0H", (memoryLineNumber)); // move cursor to memory
-            char buf[100];
-            read(mem_pipe[0], buf, sizeof(buf)); // read memory usage from pipe
-
-            // get total usage
-            float dummy;
-            float dummy2;
-            float usage;
-            float dummy3;
-            sscanf(buf, "%f GB / %f GB  --  %f GB / %f GB\n", &dummy, &dummy2, &usage, &dummy3);
-
-            // add to array
-            memory_usage[i] = usage;
-
-            char print[500];
-
-            if (i == 0)
-            {
-                strcpy(print, getMemoryUsageGraphic(usage, 0));
-            }
-            else
-            {
-                strcpy(print, getMemoryUsageGraphic(usage, memory_usage[i - 1]));
-            }
-
-            int len = strlen(buf);
-            if (len > 0)
-            {
-                buf[len - 1] = '\0'; // set the null terminator one character earlier
-            }
-
-            printf("%s   %s", buf, print);
-        }
-
-        printf("\033[%d;0H", (cpuLineNumber)); // move cursor to cpu usage
-        getCpuNumber();
-
-        if (i > 0)
-        {
-            // print usage
-            printf(" total cpu use = %.2f %%\n", usage);
-
-            for (int j = 0; j < i; j++)
-            {
-                char print[1024];
-
-                if (j != 0)
-                {
-                    strcpy(print, getCpuUsageGraphic(cpu_usage[j][1], cpu_usage[j - 1][1], cpu_usage[j - 1][0]));
-                }
-                else
-                {
-                    strcpy(print, getCpuUsageGraphic(cpu_usage[j][1], 0, 0));
-                }
-                // Scan the first number and the number of characters read
-                int chars_read;
-                int num1;
-                sscanf(print, "%d%n", &num1, &chars_read);
-
-                // Move the remaining part of the string to the left, starting after the first number
-                memmove(print, print + chars_read, strlen(print + chars_read) + 1);
-
-                printf("%s\n", print);
-            }
-        }
-
-        // Read and print the CPU usage data from the cpu_pipe
-        char buf2[1024];
-        read(cpu_pipe[0], buf2, sizeof(buf2)); // read memory usage from pipe
-        usage = atof(buf2);
-        char str[150];
-
-        if (i == 0)
-        {
-            stpcpy(str, getCpuUsageGraphic(usage, 0, 0));
-        }
-        else
-        {
-            stpcpy(str, getCpuUsageGraphic(usage, cpu_usage[i - 1][1], cpu_usage[i - 1][0]));
-        }
-
-        int bars;
-        float dummy;
-
-        sscanf(str, "%d |%*[^|]|%*[^|]|%*[^|] %f", &bars, &dummy);
-
-        // update cpu_usage array
-        cpu_usage[i][0] = bars;
-        cpu_usage[i][1] = usage;
-
-        if (i == samples - 1)
-        {
-            printf("\033[1A"); // move the cursor up one line
-            printf("\033[2K"); // clear the entire line
-        }
-
-        // update line numbers
-        memoryLineNumber = memoryLineNumber + 1;
-
-        // clear buffer
-        fflush(stdout);
-    }
-
-    // wait for processes to finish so no orphan or zombie cases
-    int status;
-    waitpid(mem_pid, &status, 0);
-    waitpid(cpu_pid, &status, 0);
-
-    printf("\033[%dA", (samples - 1)); // move cursor up 9 lines
-
-    // print usage
-    printf(" total cpu use = %.2f %%\n", usage);
-    printf("\033[J"); // clears everything below the current line
-
-    for (int j = 0; j < samples; j++)
-    {
-        char print[1024];
-
-        if (j != 0)
-        {
-            strcpy(print, getCpuUsageGraphic(cpu_usage[j][1], cpu_usage[j - 1][1], cpu_usage[j - 1][0]));
-        }
-        else
-        {
-            strcpy(print, getCpuUsageGraphic(cpu_usage[j][1], 0, 0));
-        }
-        // Scan the first number and the number of characters read
-        int chars_read;
-        int num1;
-        sscanf(print, "%d%n", &num1, &chars_read);
-
-        // Move the remaining part of the string to the left, starting after the first number
-        memmove(print, print + chars_read, strlen(print + chars_read) + 1);
-
-        printf("%s\n", print);
-    }
-
-    // print the ending system details
-    printf("---------------------------------------\n");
-    printf("### System Information ### \n");
-    getSystemInfo();
-    printf("---------------------------------------\n");
+    runMonitor(samples, tdelay, SHOW_MEMORY | SHOW_CPU, false, true);
 }
 
 void allInfoSequential(int samples, int tdelay)
@@ -1685,7 +1436,7 @@ void allInfoSequential(int samples, int tdelay)
     // This function will take in int samples and tdelay and prints out all the system information that will print sequentially
     // in the specified time interval and the specified number of samples. The information given includes memory usage,
     // user logs, cpu information, system information and are implemented through the above listed functions.
-    // NOTE: Cpu Usage, Memory Usage, and Users are individual processes that communicate through pipes
+    // NOTE: Cpu Usage, Memory Usage, and Users are individual processes that communicate through pipes (see runMonitor())
     // Example Output:
     // allInfoSequential(2, 2) prints
     //
@@ -1729,182 +1480,7 @@ void allInfoSequential(int samples, int tdelay)
     // Architecture = x86_64
     // ---------------------------------------
 
-    // create pipes for communication
-    int mem_pipe[2], cpu_pipe[2], user_pipe[2], size_pipe[2];
-    if (pipe(mem_pipe) < 0 || pipe(cpu_pipe) < 0 || pipe(user_pipe) < 0 || pipe(size_pipe) < 0)
-    {
-        perror("Error creating pipes");
-        exit(EXIT_FAILURE);
-    }
-
-    /////////////////////////////////
-    //          CHILD
-    /////////////////////////////////
-
-    // child process for memory usage
-    pid_t mem_pid = fork();
-    if (mem_pid < 0)
-    {
-        perror("fork");
-        exit(1);
-    }
-    else if (mem_pid == 0)
-    {
-        signal(SIGINT, SIG_IGN); // Add this line to ignore SIGINT in the child process
-        close(mem_pipe[0]);      // close unused read end
-        for (int i = 0; i < samples; i++)
-        {
-            getMemoryUsage(mem_pipe[1]); // write to pipe
-            sleep(tdelay);               // sleep for tdelay seconds
-        }
-
-        exit(0); // exit child process
-    }
-
-    // child process for cpu usage
-    pid_t cpu_pid = fork();
-    if (cpu_pid < 0)
-    {
-        perror("fork");
-        exit(1);
-    }
-    else if (cpu_pid == 0)
-    {
-        signal(SIGINT, SIG_IGN); // Add this line to ignore SIGINT in the child process
-        close(cpu_pipe[0]);      // close unused read end
-        for (int i = 0; i < samples; i++)
-        {
-            getCpuUsage(cpu_pipe[1], tdelay); // write to pipe
-        }
-
-        exit(0); // exit child process
-    }
-
-    // child process for users
-    pid_t user_pid = fork();
-    if (user_pid < 0)
-    {
-        perror("fork");
-        exit(1);
-    }
-    else if (user_pid == 0)
-    {
-        signal(SIGINT, SIG_IGN); // Add this line to ignore SIGINT in the child process
-        close(user_pipe[0]);     // close unused read end
-        for (int i = 0; i < samples; i++)
-        {
-            getUsers(user_pipe[1], size_pipe[1]); // write to pipe
-            sleep(tdelay);                        // sleep for tdelay seconds
-        }
-
-        exit(0); // exit child process
-    }
-
-    /////////////////////////////////
-    //          PARENT
-    /////////////////////////////////
-
-    // redirect incoming signals for CTRL C
-    if (signal(SIGINT, handle_ctrl_c) == SIG_ERR)
-    {
-        perror("Error registering SIGINT handler");
-        exit(1);
-    }
-
-    // close unused write ends of pipes
-    close(mem_pipe[1]);
-    close(cpu_pipe[1]);
-    close(user_pipe[1]);
-    close(size_pipe[1]);
-
-    // clear terminal before starting
-    printf("\033c");
-
-    float usage;
-
-    // wait for all child processes to finish
-    fd_set read_fds;
-
-    int max_fd = mem_pipe[0];
-    if (cpu_pipe[0] > max_fd)
-    {
-        max_fd = cpu_pipe[0];
-    }
-    if (user_pipe[0] > max_fd)
-    {
-        max_fd = user_pipe[0];
-    }
-
-    // print all info sequentially
-    for (int i = 0; i < samples; i++)
-    {
-
-        // wait for all child processes to finish
-        FD_ZERO(&read_fds);
-        FD_SET(mem_pipe[0], &read_fds);
-        FD_SET(cpu_pipe[0], &read_fds);
-        FD_SET(user_pipe[0], &read_fds);
-        select(max_fd + 1, &read_fds, NULL, NULL, NULL);
-
-        printf("\r"); // clear current line in case CTRL Z has been called
-        printf(">>> Iteration: %d\n", i + 1);
-        header(samples, tdelay);
-        printf("---------------------------------------\n");
-        printf("### Memory ### (Phys.Used/Tot -- Virtual Used/Tot) \n");
-
-        // create the needed spaces
-        for (int j = 0; j < samples; j++)
-        {
-            if (j == i)
-            {
-                // read and print output
-                if (FD_ISSET(mem_pipe[0], &read_fds))
-                {
-                    char buf[100];
-                    read(mem_pipe[0], buf, sizeof(buf)); // read memory usage from pipe
-                    printf("%s", buf);
-                }
-            }
-            else
-            {
-                printf("\n");
-            }
-        }
-        printf("---------------------------------------\n");
-        printf("### Sessions/users ###\n");
-        // Read and print the user data from the user_pipe
-        char size[100];
-        read(size_pipe[0], size, sizeof(size));
-        int length = atoi(size);
-        char buf[length];
-        read(user_pipe[0], buf, sizeof(buf)); // read memory usage from pipe
-        printf("%s", buf);
-        printf("---------------------------------------\n");
-        getCpuNumber();
-
-        // Read and print the CPU usage data from the cpu_pipe
-        char buf2[1024];
-        read(cpu_pipe[0], buf2, sizeof(buf2)); // read memory usage from pipe
-        usage = atof(buf2);
-        printf(" total cpu use = %.2f %%\n", usage);
-
-        printf("\n");
-
-        fflush(stdout);
-    }
-
-    // wait for processes to finish so no orphan or zombie cases
-    int status;
-    waitpid(mem_pid, &status, 0);
-    waitpid(cpu_pid, &status, 0);
-    waitpid(user_pid, &status, 0);
-
-    // print the ending system details
-    printf("\033[1A");
-    printf("---------------------------------------\n");
-    printf("### System Information ### \n");
-    getSystemInfo();
-    printf("---------------------------------------\n");
+    runMonitor(samples, tdelay, SHOW_MEMORY | SHOW_USERS | SHOW_CPU, true, false);
 }
 
 void allInfoSequentialGraphic(int samples, int tdelay)
@@ -1912,7 +1488,7 @@ void allInfoSequentialGraphic(int samples, int tdelay)
     // This function will take in int samples and tdelay and prints out all the system information graphicallly that will print sequentially
     // in the specified time interval and the specified number of samples. The information given includes memory usage,
     // user logs, cpu information, system information and are implemented through the above listed functions.
-    // NOTE: Cpu Usage, Memory Usage, and Users are individual processes that communicate through pipes
+    // NOTE: Cpu Usage, Memory Usage, and Users are individual processes that communicate through pipes (see runMonitor())
     // Example Output:
     // allInfoSequential(2, 2) prints
     //
@@ -1927,293 +1503,42 @@ void allInfoSequentialGraphic(int samples, int tdelay)
     //---------------------------------------
     // ### Sessions/users ###
     // dodajkri      pts/12 (138.51.13.118)
-    // rouhanie      pts/7 (138.51.9.175)
-    // dodajkri      pts/57 (138.51.13.118)
-    //---------------------------------------
-    // Number of CPU's: 12     Total Number of Cores: 72
-    //  total cpu use = 0.16 %
-    //  |||||||| 0.16
-    //
-    //
-    //>>> Iteration: 2
-    //
-    // Nbr of samples: 2 -- every 2 secs
-    // Memory Usage: 3924 kilobytes
-    //---------------------------------------
-    // ### Memory ### (Phys.Used/Tot -- Virtual Used/Tot)
-    //
-    // 7.47 GB / 15.32 GB  --  7.47 GB / 16.28 GB   |o 0.00 (7.47)
-    //---------------------------------------
-    // ### Sessions/users ###
-    // dodajkri      pts/12 (138.51.13.118)
-    // rouhanie      pts/7 (138.51.9.175)
-    // dodajkri      pts/57 (138.51.13.118)
-    //---------------------------------------
-    // Number of CPU's: 12     Total Number of Cores: 72
-    // total cpu use = 0.33 %
-    // |||||||| 0.16
-    // |||||||| 0.33
-    //---------------------------------------
-    // ### System Information ###
-    // System Name = Linux
-    // Machine Name = iits-b473-13
-    // Version = #39~22.04.1-Ubuntu SMP PREEMPT_DYNAMIC Fri Mar 17 21:16:15 UTC 2
-    // Release = 5.19.0-38-generic
-    // Architecture = x86_64
-    //---------------------------------------
-
-    // create pipes for communication
-    int mem_pipe[2], cpu_pipe[2], user_pipe[2], size_pipe[2];
-    if (pipe(mem_pipe) < 0 || pipe(cpu_pipe) < 0 || pipe(user_pipe) < 0 || pipe(size_pipe) < 0)
-    {
-        perror("Error creating pipes");
-        exit(EXIT_FAILURE);
-    }
-
-    /////////////////////////////////
-    //          CHILD
-    /////////////////////////////////
-
-    // child process for memory usage
-    pid_t mem_pid = fork();
-    if (mem_pid < 0)
-    {
-        perror("fork");
-        exit(1);
-    }
-    else if (mem_pid == 0)
-    {
-        signal(SIGINT, SIG_IGN); // Add this line to ignore SIGINT in the child process
-        close(mem_pipe[0]);      // close unused read end
-        for (int i = 0; i < samples; i++)
-        {
-            getMemoryUsage(mem_pipe[1]); // write to pipe
-            sleep(tdelay);               // sleep for tdelay seconds
-        }
-
-        exit(0); // exit child process
-    }
-
-    // child process for cpu usage
-    pid_t cpu_pid = fork();
-    if (cpu_pid < 0)
-    {
-        perror("fork");
-        exit(1);
-    }
-    else if (cpu_pid == 0)
-    {
-        signal(SIGINT, SIG_IGN); // Add this line to ignore SIGINT in the child process
-        close(cpu_pipe[0]);      // close unused read end
-        for (int i = 0; i < samples; i++)
-        {
-            getCpuUsage(cpu_pipe[1], tdelay); // write to pipe
-        }
-
-        exit(0); // exit child process
-    }
-
-    // child process for users
-    pid_t user_pid = fork();
-    if (user_pid < 0)
-    {
-        perror("fork");
-        exit(1);
-    }
-    else if (user_pid == 0)
-    {
-        signal(SIGINT, SIG_IGN); // Add this line to ignore SIGINT in the child process
-        close(user_pipe[0]);     // close unused read end
-        for (int i = 0; i < samples; i++)
-        {
-            getUsers(user_pipe[1], size_pipe[1]); // write to pipe
-            sleep(tdelay);                        // sleep for tdelay seconds
-        }
-
-        exit(0); // exit child process
-    }
-
-    /////////////////////////////////
-    //          PARENT
-    /////////////////////////////////
-
-    // redirect incoming signals for CTRL C
-    if (signal(SIGINT, handle_ctrl_c) == SIG_ERR)
-    {
-        perror("Error registering SIGINT handler");
-        exit(1);
-    }
-
-    // close unused write ends of pipes
-    close(mem_pipe[1]);
-    close(cpu_pipe[1]);
-    close(user_pipe[1]);
-    close(size_pipe[1]);
-
-    // clear terminal before starting
-    printf("\033c");
-
-    float usage;
-
-    // wait for all child processes to finish
-    fd_set read_fds;
-
-    int max_fd = mem_pipe[0];
-    if (cpu_pipe[0] > max_fd)
-    {
-        max_fd = cpu_pipe[0];
-    }
-    if (user_pipe[0] > max_fd)
-    {
-        max_fd = user_pipe[0];
-    }
-
-    // store previous cpu and memory results
-    float cpu_usage[samples][2];
-    float memory_usage[samples];
-
-    // print all info sequentially
-    for (int i = 0; i < samples; i++)
-    {
-
-        // wait for all child processes to finish
-        FD_ZERO(&read_fds);
-        FD_SET(mem_pipe[0], &read_fds);
-        FD_SET(cpu_pipe[0], &read_fds);
-        FD_SET(user_pipe[0], &read_fds);
-        select(max_fd + 1, &read_fds, NULL, NULL, NULL);
-
-        printf("\r"); // clear current line in case CTRL Z has been called
-        printf(">>> Iteration: %d\n", i + 1);
-        header(samples, tdelay);
-        printf("---------------------------------------\n");
-        printf("### Memory ### (Phys.Used/Tot -- Virtual Used/Tot) \n");
-
-        // create the needed spaces
-        for (int j = 0; j < samples; j++)
-        {
-            if (j == i)
-            {
-                // read and print output
-                if (FD_ISSET(mem_pipe[0], &read_fds))
-                {
-                    char buf[100];
-                    read(mem_pipe[0], buf, sizeof(buf)); // read memory usage from pipe
-
-                    // get total usage
-                    float dummy;
-                    float dummy2;
-                    float usage;
-                    float dummy3;
-                    sscanf(buf, "%f GB / %f GB  --  %f GB / %f GB\n", &dummy, &dummy2, &usage, &dummy3);
-
-                    // add to array
-                    memory_usage[i] = usage;
-
-                    char print[500];
-
-                    if (i == 0)
-                    {
-                        strcpy(print, getMemoryUsageGraphic(usage, 0));
-                    }
-                    else
-                    {
-                        strcpy(print, getMemoryUsageGraphic(usage, memory_usage[i - 1]));
-                    }
-
-                    int len = strlen(buf);
-                    if (len > 0)
-                    {
-                        buf[len - 1] = '\0'; // set the null terminator one character earlier
-                    }
-
-                    printf("%s   %s", buf, print);
-                }
-            }
-            else
-            {
-                printf("\n");
-            }
-        }
-        printf("\n");
-        printf("---------------------------------------\n");
-        printf("### Sessions/users ###\n");
-        // Read and print the user data from the user_pipe
-        char size[100];
-        read(size_pipe[0], size, sizeof(size));
-        int length = atoi(size);
-        char buf[length];
-        read(user_pipe[0], buf, sizeof(buf)); // read memory usage from pipe
-        printf("%s", buf);
-        printf("---------------------------------------\n");
-        getCpuNumber();
-
-        // Read and print the CPU usage data from the cpu_pipe
-        char buf2[1024];
-        read(cpu_pipe[0], buf2, sizeof(buf2)); // read memory usage from pipe
-        usage = atof(buf2);
-        char str[150];
-
-        if (i == 0)
-        {
-            stpcpy(str, getCpuUsageGraphic(usage, 0, 0));
-        }
-        else
-        {
-            stpcpy(str, getCpuUsageGraphic(usage, cpu_usage[i - 1][1], cpu_usage[i - 1][0]));
-        }
-
-        int bars;
-        float dummy;
-
-        sscanf(str, "%d |%*[^|]|%*[^|]|%*[^|] %f", &bars, &dummy);
-
-        // update cpu_usage array
-        cpu_usage[i][0] = bars;
-        cpu_usage[i][1] = usage;
-
-        printf(" total cpu use = %.2f %%\n", usage);
-
-        for (int j = 0; j <= i; j++)
-        {
-            char print[1024];
-
-            if (j != 0)
-            {
-                strcpy(print, getCpuUsageGraphic(cpu_usage[j][1], cpu_usage[j - 1][1], cpu_usage[j - 1][0]));
-            }
-            else
-            {
-                strcpy(print, getCpuUsageGraphic(cpu_usage[j][1], 0, 0));
-            }
-            // Scan the first number and the number of characters read
-            int chars_read;
-            int num1;
-            sscanf(print, "%d%n", &num1, &chars_read);
-
-            // Move the remaining part of the string to the left, starting after the first number
-            memmove(print, print + chars_read, strlen(print + chars_read) + 1);
-
-            printf("%s\n", print);
-        }
-
-        printf("\n");
-
-        fflush(stdout);
-    }
-
-    // wait for processes to finish so no orphan or zombie cases
-    int status;
-    waitpid(mem_pid, &status, 0);
-    waitpid(cpu_pid, &status, 0);
-    waitpid(user_pid, &status, 0);
+    // rouhanie      pts/7 (138.51.9.175)
+    // dodajkri      pts/57 (138.51.13.118)
+    //---------------------------------------
+    // Number of CPU's: 12     Total Number of Cores: 72
+    //  total cpu use = 0.16 %
+    //  |||||||| 0.16
+    //
+    //
+    //>>> Iteration: 2
+    //
+    // Nbr of samples: 2 -- every 2 secs
+    // Memory Usage: 3924 kilobytes
+    //---------------------------------------
+    // ### Memory ### (Phys.Used/Tot -- Virtual Used/Tot)
+    //
+    // 7.47 GB / 15.32 GB  --  7.47 GB / 16.28 GB   |o 0.00 (7.47)
+    //---------------------------------------
+    // ### Sessions/users ###
+    // dodajkri      pts/12 (138.51.13.118)
+    // rouhanie      pts/7 (138.51.9.175)
+    // dodajkri      pts/57 (138.51.13.118)
+    //---------------------------------------
+    // Number of CPU's: 12     Total Number of Cores: 72
+    // total cpu use = 0.33 %
+    // |||||||| 0.16
+    // |||||||| 0.33
+    //---------------------------------------
+    // ### System Information ###
+    // System Name = Linux
+    // Machine Name = iits-b473-13
+    // Version = #39~22.04.1-Ubuntu SMP PREEMPT_DYNAMIC Fri Mar 17 21:16:15 UTC 2
+    // Release = 5.19.0-38-generic
+    // Architecture = x86_64
+    //---------------------------------------
 
-    // print the ending system details
-    printf("\033[1A");
-    printf("---------------------------------------\n");
-    printf("### System Information ### \n");
-    getSystemInfo();
-    printf("---------------------------------------\n");
+    runMonitor(samples, tdelay, SHOW_MEMORY | SHOW_USERS | SHOW_CPU, true, true);
 }
 
 void usersSequential(int samples, int tdelay)
@@ -2221,7 +1546,7 @@ void usersSequential(int samples, int tdelay)
     // This function will take in int samples and tdelay and prints out all the user information that will print sequentially
     // in the specified time interval and the specified number of samples. The information given includes users logged in,
     // their individual sessions, and system information.
-    // NOTE: Getting users is an individual process that communicates through pipes
+    // NOTE: Getting users is an individual process that communicates through pipes (see runMonitor())
     // Example Output:
     // usersSequential(2, 2) prints
     //
@@ -2251,103 +1576,7 @@ void usersSequential(int samples, int tdelay)
     // Architecture = x86_64
     // ---------------------------------------
 
-    int user_pipe[2], size_pipe[2];
-    if (pipe(user_pipe) < 0 || pipe(size_pipe) < 0)
-    {
-        perror("Error creating pipes");
-        exit(EXIT_FAILURE);
-    }
-
-    /////////////////////////////////
-    //          CHILD
-    /////////////////////////////////
-
-    // child process for memory usage
-    pid_t user_pid = fork();
-    if (user_pid < 0)
-    {
-        perror("fork");
-        exit(1);
-    }
-    else if (user_pid == 0)
-    {
-        signal(SIGINT, SIG_IGN); // Add this line to ignore SIGINT in the child process
-        close(user_pipe[0]);     // close unused read end
-        for (int i = 0; i < samples; i++)
-        {
-            getUsers(user_pipe[1], size_pipe[1]); // write to pipe
-            sleep(tdelay);                        // sleep for tdelay seconds
-        }
-
-        exit(0); // exit child process
-    }
-
-    /////////////////////////////////
-    //          PARENT
-    /////////////////////////////////
-
-    // redirect incoming signals for CTRL C
-    if (signal(SIGINT, handle_ctrl_c) == SIG_ERR)
-    {
-        perror("Error registering SIGINT handler");
-        exit(1);
-    }
-
-    // close unused write ends of pipes
-    close(user_pipe[1]);
-    close(size_pipe[1]);
-
-    // clear terminal before starting
-    printf("\033c");
-
-    fd_set read_fds;
-
-    // print user info sequentially
-    for (int i = 0; i < samples; i++)
-    {
-        // wait for all child processes to finish
-        FD_ZERO(&read_fds);
-        FD_SET(user_pipe[0], &read_fds);
-        select(user_pipe[0] + 1, &read_fds, NULL, NULL, NULL);
-
-        printf("\r"); // clear current line in case CTRL Z has been called
-        printf(">>>Iteration: %d\n", i + 1);
-        header(samples, tdelay);
-        printf("---------------------------------------\n");
-        printf("### Sessions/users ### \n");
-        // read and print output
-        if (FD_ISSET(user_pipe[0], &read_fds))
-        {
-
-            // Read and print the user data from the user_pipe
-            char size[100];
-            read(size_pipe[0], size, sizeof(size));
-            int length = atoi(size);
-            char buf[length];
-            read(user_pipe[0], buf, sizeof(buf)); // read memory usage from pipe
-            printf("%s", buf);
-        }
-        printf("\n");
-
-        if (i != samples - 1)
-        {
-            // wait tdelay
-            sleep(tdelay);
-            // clear buffer
-            fflush(stdout);
-        }
-    }
-
-    // wait for processes to finish so no orphan or zombie cases
-    int status;
-    waitpid(user_pid, &status, 0);
-
-    // print the ending system details
-    printf("\033[1A");
-    printf("---------------------------------------\n");
-    printf("### System Information ### \n");
-    getSystemInfo();
-    printf("---------------------------------------\n");
+    runMonitor(samples, tdelay, SHOW_USERS, true, false);
 }
 
 void systemSequential(int samples, int tdelay)
@@ -2355,7 +1584,7 @@ void systemSequential(int samples, int tdelay)
     // This function will take in int samples and tdelay and prints out the system information that will print sequentially
     // in the specified time interval and the specified number of samples. The information given includes memory usage,
     // cpu information, system information and are implemented through the above listed functions.
-    // NOTE: Cpu Usage and Memory Usage are individual processes that communicate through pipes
+    // NOTE: Cpu Usage and Memory Usage are individual processes that communicate through pipes (see runMonitor())
     // Example Output:
     // systemSequential(2, 2) prints
     //
@@ -2391,139 +1620,7 @@ void systemSequential(int samples, int tdelay)
     // Architecture = x86_64
     //---------------------------------------
 
-    int mem_pipe[2], cpu_pipe[2];
-    if (pipe(mem_pipe) < 0 || pipe(cpu_pipe) < 0)
-    {
-        perror("Error creating pipes");
-        exit(EXIT_FAILURE);
-    }
-
-    /////////////////////////////////
-    //          CHILD
-    /////////////////////////////////
-
-    // child process for memory usage
-    pid_t mem_pid = fork();
-    if (mem_pid < 0)
-    {
-        perror("fork");
-        exit(1);
-    }
-    else if (mem_pid == 0)
-    {
-        signal(SIGINT, SIG_IGN); // Add this line to ignore SIGINT in the child process
-        close(mem_pipe[0]);      // close unused read end
-        for (int i = 0; i < samples; i++)
-        {
-            getMemoryUsage(mem_pipe[1]); // write to pipe
-            sleep(tdelay);               // sleep for tdelay seconds
-        }
-
-        exit(0); // exit child process
-    }
-
-    // child process for cpu usage
-    pid_t cpu_pid = fork();
-    if (cpu_pid < 0)
-    {
-        perror("fork");
-        exit(1);
-    }
-    else if (cpu_pid == 0)
-    {
-        signal(SIGINT, SIG_IGN); // Add this line to ignore SIGINT in the child process
-        close(cpu_pipe[0]);      // close unused read end
-        for (int i = 0; i < samples; i++)
-        {
-            getCpuUsage(cpu_pipe[1], tdelay); // write to pipe
-        }
-
-        exit(0); // exit child process
-    }
-
-    /////////////////////////////////
-    //          PARENT
-    /////////////////////////////////
-
-    // redirect incoming signals for CTRL C
-    if (signal(SIGINT, handle_ctrl_c) == SIG_ERR)
-    {
-        perror("Error registering SIGINT handler");
-        exit(1);
-    }
-
-    // close unused write ends of pipes
-    close(mem_pipe[1]);
-    close(cpu_pipe[1]);
-
-    // clear terminal before starting
-    printf("\033c");
-
-    float usage;
-
-    fd_set read_fds;
-    int max_fd = (mem_pipe[0] > cpu_pipe[0]) ? mem_pipe[0] : cpu_pipe[0];
-
-    // print system info sequentially
-    for (int i = 0; i < samples; i++)
-    {
-
-        // wait for all child processes to finish
-        FD_ZERO(&read_fds);
-        FD_SET(mem_pipe[0], &read_fds);
-        FD_SET(cpu_pipe[0], &read_fds);
-        select(max_fd + 1, &read_fds, NULL, NULL, NULL);
-
-        printf("\r"); // clear current line in case CTRL Z has been called
-        printf(">>> Iteration: %d\n", i + 1);
-        header(samples, tdelay);
-        printf("---------------------------------------\n");
-        printf("### Memory ### (Phys.Used/Tot -- Virtual Used/Tot) \n");
-
-        // create the needed spaces
-        for (int j = 0; j < samples; j++)
-        {
-            if (j == i)
-            {
-                // read and print output
-                if (FD_ISSET(mem_pipe[0], &read_fds))
-                {
-                    char buf[100];
-                    read(mem_pipe[0], buf, sizeof(buf)); // read memory usage from pipe
-                    printf("%s", buf);
-                }
-            }
-            else
-            {
-                printf("\n");
-            }
-        }
-        printf("---------------------------------------\n");
-        getCpuNumber();
-
-        // Read and print the CPU usage data from the cpu_pipe
-        char buf2[1024];
-        read(cpu_pipe[0], buf2, sizeof(buf2)); // read memory usage from pipe
-        usage = atof(buf2);
-        printf(" total cpu use = %.2f %%\n", usage);
-
-        printf("\n");
-
-        // clear buffer
-        fflush(stdout);
-    }
-
-    // wait for processes to finish so no orphan or zombie cases
-    int status;
-    waitpid(mem_pid, &status, 0);
-    waitpid(cpu_pid, &status, 0);
-
-    // print the ending system details
-    printf("\033[1A");
-    printf("---------------------------------------\n");
-    printf("### System Information ### \n");
-    getSystemInfo();
-    printf("---------------------------------------\n");
+    runMonitor(samples, tdelay, SHOW_MEMORY | SHOW_CPU, true, false);
 }
 
 void systemSequentialGraphic(int samples, int tdelay)
@@ -2531,250 +1628,44 @@ void systemSequentialGraphic(int samples, int tdelay)
     // This function will take in int samples and tdelay and prints out the system information graphically that will print sequentially
     // in the specified time interval and the specified number of samples. The information given includes memory usage,
     // cpu information, system information and are implemented through the above listed functions.
-    // NOTE: Cpu Usage and Memory Usage are individual processes that communicate through pipes
+    // NOTE: Cpu Usage and Memory Usage are individual processes that communicate through pipes (see runMonitor())
     // Example Output:
-    // systemSequential(2, 2) prints
+    // systemSequentialGraphic(2, 2) prints
+    //
+    // >>> Iteration: 1
     //
-    //>>> Iteration: 1
-
     // Nbr of samples: 2 -- every 2 secs
     // Memory Usage: 3984 kilobytes
-    //---------------------------------------
+    // ---------------------------------------
     // ### Memory ### (Phys.Used/Tot -- Virtual Used/Tot)
     // 7.65 GB / 15.32 GB  --  7.65 GB / 16.28 GB   |o 0.00 (7.65)
     //
+    // ---------------------------------------
     // Number of CPU's: 12     Total Number of Cores: 72
     //  total cpu use = 1.34 %
     //  |||||||| 1.34
     //
-    //>>> Iteration: 2
+    // >>> Iteration: 2
     //
     // Nbr of samples: 2 -- every 2 secs
     // Memory Usage: 3984 kilobytes
-    //---------------------------------------
-    // ### Memory ### (Phys.Used/Tot -- Virtual Used/Tot) /
+    // ---------------------------------------
+    // ### Memory ### (Phys.Used/Tot -- Virtual Used/Tot)
     //
     // 7.66 GB / 15.32 GB  --  7.66 GB / 16.28 GB   |# 0.01 (7.66)
+    // ---------------------------------------
     // Number of CPU's: 12     Total Number of Cores: 72
     //  total cpu use = 0.58 %
     //  |||||||| 1.34
     //  |||||||| 0.58
-    //---------------------------------------
+    // ---------------------------------------
     // ### System Information ###
     // System Name = Linux
     // Machine Name = iits-b473-13
     // Version = #39~22.04.1-Ubuntu SMP PREEMPT_DYNAMIC Fri Mar 17 21:16:15 UTC 2
     // Release = 5.19.0-38-generic
     // Architecture = x86_64
-    //---------------------------------------
-
-    int mem_pipe[2], cpu_pipe[2];
-    if (pipe(mem_pipe) < 0 || pipe(cpu_pipe) < 0)
-    {
-        perror("Error creating pipes");
-        exit(EXIT_FAILURE);
-    }
-
-    /////////////////////////////////
-    //          CHILD
-    /////////////////////////////////
-
-    // child process for memory usage
-    pid_t mem_pid = fork();
-    if (mem_pid < 0)
-    {
-        perror("fork");
-        exit(1);
-    }
-    else if (mem_pid == 0)
-    {
-        signal(SIGINT, SIG_IGN); // Add this line to ignore SIGINT in the child process
-        close(mem_pipe[0]);      // close unused read end
-        for (int i = 0; i < samples; i++)
-        {
-            getMemoryUsage(mem_pipe[1]); // write to pipe
-            sleep(tdelay);               // sleep for tdelay seconds
-        }
-
-        exit(0); // exit child process
-    }
-
-    // child process for cpu usage
-    pid_t cpu_pid = fork();
-    if (cpu_pid < 0)
-    {
-        perror("fork");
-        exit(1);
-    }
-    else if (cpu_pid == 0)
-    {
-        signal(SIGINT, SIG_IGN); // Add this line to ignore SIGINT in the child process
-        close(cpu_pipe[0]);      // close unused read end
-        for (int i = 0; i < samples; i++)
-        {
-            getCpuUsage(cpu_pipe[1], tdelay); // write to pipe
-        }
-
-        exit(0); // exit child process
-    }
-
-    /////////////////////////////////
-    //          PARENT
-    /////////////////////////////////
-
-    // redirect incoming signals for CTRL C
-    if (signal(SIGINT, handle_ctrl_c) == SIG_ERR)
-    {
-        perror("Error registering SIGINT handler");
-        exit(1);
-    }
-
-    // close unused write ends of pipes
-    close(mem_pipe[1]);
-    close(cpu_pipe[1]);
-
-    // clear terminal before starting
-    printf("\033c");
-
-    float usage;
-
-    fd_set read_fds;
-    int max_fd = (mem_pipe[0] > cpu_pipe[0]) ? mem_pipe[0] : cpu_pipe[0];
-
-    // store previous cpu and memory results
-    float cpu_usage[samples][2];
-    float memory_usage[samples];
-
-    // print system info sequentially
-    for (int i = 0; i < samples; i++)
-    {
-
-        // wait for all child processes to finish
-        FD_ZERO(&read_fds);
-        FD_SET(mem_pipe[0], &read_fds);
-        FD_SET(cpu_pipe[0], &read_fds);
-        select(max_fd + 1, &read_fds, NULL, NULL, NULL);
-
-        printf("\r"); // clear current line in case CTRL Z has been called
-        printf(">>> Iteration: %d\n", i + 1);
-        header(samples, tdelay);
-        printf("---------------------------------------\n");
-        printf("### Memory ### (Phys.Used/Tot -- Virtual Used/Tot) \n");
-
-        // create the needed spaces
-        for (int j = 0; j < samples; j++)
-        {
-            if (j == i)
-            {
-                // read and print output
-                if (FD_ISSET(mem_pipe[0], &read_fds))
-                {
-                    char buf[100];
-                    read(mem_pipe[0], buf, sizeof(buf)); // read memory usage from pipe
-
-                    // get total usage
-                    float dummy;
-                    float dummy2;
-                    float usage;
-                    float dummy3;
-                    sscanf(buf, "%f GB / %f GB  --  %f GB / %f GB\n", &dummy, &dummy2, &usage, &dummy3);
-
-                    // add to array
-                    memory_usage[i] = usage;
-
-                    char print[500];
-
-                    if (i == 0)
-                    {
-                        strcpy(print, getMemoryUsageGraphic(usage, 0));
-                    }
-                    else
-                    {
-                        strcpy(print, getMemoryUsageGraphic(usage, memory_usage[i - 1]));
-                    }
-
-                    int len = strlen(buf);
-                    if (len > 0)
-                    {
-                        buf[len - 1] = '\0'; // set the null terminator one character earlier
-                    }
-
-                    printf("%s   %s", buf, print);
-                }
-            }
-            else
-            {
-                printf("\n");
-            }
-        }
-
-        printf("\n");
-        getCpuNumber();
-
-        // Read and print the CPU usage data from the cpu_pipe
-        char buf2[1024];
-        read(cpu_pipe[0], buf2, sizeof(buf2)); // read memory usage from pipe
-        usage = atof(buf2);
-        char str[150];
-
-        if (i == 0)
-        {
-            stpcpy(str, getCpuUsageGraphic(usage, 0, 0));
-        }
-        else
-        {
-            stpcpy(str, getCpuUsageGraphic(usage, cpu_usage[i - 1][1], cpu_usage[i - 1][0]));
-        }
-
-        int bars;
-        float dummy;
-
-        sscanf(str, "%d |%*[^|]|%*[^|]|%*[^|] %f", &bars, &dummy);
-
-        // update cpu_usage array
-        cpu_usage[i][0] = bars;
-        cpu_usage[i][1] = usage;
-
-        printf(" total cpu use = %.2f %%\n", usage);
-
-        for (int j = 0; j <= i; j++)
-        {
-            char print[1024];
-
-            if (j != 0)
-            {
-                strcpy(print, getCpuUsageGraphic(cpu_usage[j][1], cpu_usage[j - 1][1], cpu_usage[j - 1][0]));
-            }
-            else
-            {
-                strcpy(print, getCpuUsageGraphic(cpu_usage[j][1], 0, 0));
-            }
-            // Scan the first number and the number of characters read
-            int chars_read;
-            int num1;
-            sscanf(print, "%d%n", &num1, &chars_read);
-
-            // Move the remaining part of the string to the left, starting after the first number
-            memmove(print, print + chars_read, strlen(print + chars_read) + 1);
-
-            printf("%s\n", print);
-        }
-
-        printf("\n");
-
-        // clear buffer
-        fflush(stdout);
-    }
-
-    // wait for processes to finish so no orphan or zombie cases
-    int status;
-    waitpid(mem_pid, &status, 0);
-    waitpid(cpu_pid, &status, 0);
+    // ---------------------------------------
 
-    // print the ending system details
-    printf("\033[1A");
-    printf("---------------------------------------\n");
-    printf("### System Information ### \n");
-    getSystemInfo();
-    printf("---------------------------------------\n");
-}
\ No newline at end of file
+    runMonitor(samples, tdelay, SHOW_MEMORY | SHOW_CPU, true, true);
+}
@@ -1,21 +1,29 @@
 // Author: Kristi Dodaj
 // stats_functions.h: Responsible for defining the function definitions that are within the stats_functions.c file
+#include <stdio.h>
 #include <signal.h>
+#include <stdbool.h>
 
 #ifndef STATS
 #define STATS
 
 // define the function signatures
 
-void header(int samples, int tdelay);
+int header(FILE *out, int samples, int tdelay);
+void refreshHeader(FILE *out, int samples, int tdelay, int lines);
 void getSystemInfo();
-void getUsers(int write_pipe, int size_pipe);
-void getCpuNumber();
-void getCpuUsage(int write_pipe, int tdelay);
+void getUsers(int write_pipe);
+void getCpuNumber(FILE *out);
+void getCpuUsage(int write_pipe);
 void *getCpuUsageGraphic(float current_usage, float previous_usage, int previous_bars);
 void getMemoryUsage(int write_pipe);
 char *getMemoryUsageGraphic(float current_usage, float previous_usage);
-void handle_ctrl_c(int signal_number);
+void setCollectorIntervals(int cpu, int memory, int users);
+bool panelExists(const char *name);
+bool enablePanel(const char *name);
+bool graphicOutput();
+void setDaemonSocket(const char *path);
+void runDaemon(const char *path, int tdelay, bool graphic);
 void allInfoUpdate(int samples, int tdelay);
 void allInfoUpdateGraphic(int samples, int tdelay);
 void usersUpdate(int samples, int tdelay);
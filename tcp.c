@@ -0,0 +1,346 @@
+// Author: Kristi Dodaj
+// tcp.c: Responsible for the optional collector of the TCP and socket counters that explain most latency regressions: retransmits,
+// listen queue overflows, connection opens and resets, TIME_WAIT sockets and socket memory. /proc/net/snmp and /proc/net/netstat
+// are pairs of a header line of names and a line of values, /proc/net/sockstat is name value pairs on one line. Where each counter
+// is (its line and column) is looked up once, so a sample reads the values by position without comparing any names.
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <time.h>
+#include "tcp.h"
+#include "procfile.h"
+#include "event_loop.h"
+#include "overhead.h"
+#include "stats_functions.h"
+
+enum netFile
+{
+    SNMP,
+    NETSTAT,
+    SOCKSTAT,
+    NET_FILE_COUNT
+};
+
+static const char *netPaths[NET_FILE_COUNT] = {"/proc/net/snmp", "/proc/net/netstat", "/proc/net/sockstat"};
+
+// a counter of the schema below
+struct netCounter
+{
+    enum netFile file;
+    const char *section;  // the first token of its lines, ex. "Tcp:"
+    const char *name;
+    int line;             // the line of its value (from 0), -1 if this kernel does not have it
+    int column;           // the token of its value on that line (the section is token 0)
+    long long value;
+    long long previous;
+};
+
+enum counterId
+{
+    ACTIVE_OPENS,
+    PASSIVE_OPENS,
+    ATTEMPT_FAILS,
+    ESTAB_RESETS,
+    CURR_ESTAB,
+    IN_SEGS,
+    OUT_SEGS,
+    RETRANS_SEGS,
+    IN_ERRS,
+    OUT_RSTS,
+    LISTEN_OVERFLOWS,
+    LISTEN_DROPS,
+    TCP_TIMEOUTS,
+    ABORT_ON_MEMORY,
+    SOCKETS_USED,
+    TCP_INUSE,
+    TCP_ORPHAN,
+    TCP_TIME_WAIT,
+    TCP_ALLOC,
+    TCP_MEMORY,
+    COUNTER_COUNT
+};
+
+static struct netCounter counters[COUNTER_COUNT] = {
+    [ACTIVE_OPENS] = {SNMP, "Tcp:", "ActiveOpens"},
+    [PASSIVE_OPENS] = {SNMP, "Tcp:", "PassiveOpens"},
+    [ATTEMPT_FAILS] = {SNMP, "Tcp:", "AttemptFails"},
+    [ESTAB_RESETS] = {SNMP, "Tcp:", "EstabResets"},
+    [CURR_ESTAB] = {SNMP, "Tcp:", "CurrEstab"},
+    [IN_SEGS] = {SNMP, "Tcp:", "InSegs"},
+    [OUT_SEGS] = {SNMP, "Tcp:", "OutSegs"},
+    [RETRANS_SEGS] = {SNMP, "Tcp:", "RetransSegs"},
+    [IN_ERRS] = {SNMP, "Tcp:", "InErrs"},
+    [OUT_RSTS] = {SNMP, "Tcp:", "OutRsts"},
+    [LISTEN_OVERFLOWS] = {NETSTAT, "TcpExt:", "ListenOverflows"},
+    [LISTEN_DROPS] = {NETSTAT, "TcpExt:", "ListenDrops"},
+    [TCP_TIMEOUTS] = {NETSTAT, "TcpExt:", "TCPTimeouts"},
+    [ABORT_ON_MEMORY] = {NETSTAT, "TcpExt:", "TCPAbortOnMemory"},
+    [SOCKETS_USED] = {SOCKSTAT, "sockets:", "used"},
+    [TCP_INUSE] = {SOCKSTAT, "TCP:", "inuse"},
+    [TCP_ORPHAN] = {SOCKSTAT, "TCP:", "orphan"},
+    [TCP_TIME_WAIT] = {SOCKSTAT, "TCP:", "tw"},
+    [TCP_ALLOC] = {SOCKSTAT, "TCP:", "alloc"},
+    [TCP_MEMORY] = {SOCKSTAT, "TCP:", "mem"},
+};
+
+static struct procFile files[NET_FILE_COUNT];
+static int order[COUNTER_COUNT]; // the counters by file, line and column, so a sample reads every file front to back once
+static bool resolved = false;
+static long long previousTime = 0;
+
+static const char *nextToken(const char *text)
+{
+    // This function returns the start of the token after the one text points into, or the end of the line
+    while (*text != ' ' && *text != '\n' && *text != '\0')
+    {
+        text++;
+    }
+    while (*text == ' ')
+    {
+        text++;
+    }
+    return text;
+}
+
+static bool tokenIs(const char *token, const char *name)
+{
+    // This function returns true if the token at token is name
+    size_t length = strlen(name);
+    return strncmp(token, name, length) == 0 && (token[length] == ' ' || token[length] == '\n' || token[length] == '\0');
+}
+
+static void locate(struct netCounter *counter, const char *text)
+{
+    // This function finds the line and column of a counter: in snmp and netstat the value is in the same column of the line after
+    // the first line of its section (the names), in sockstat it is the token after its name
+
+    counter->line = -1;
+    int line = 0;
+    for (const char *start = text; start != NULL && *start != '\0'; line++)
+    {
+        if (tokenIs(start, counter->section))
+        {
+            int column = 0;
+            for (const char *token = start; *token != '\n' && *token != '\0'; token = nextToken(token), column++)
+            {
+                if (column > 0 && tokenIs(token, counter->name))
+                {
+                    counter->line = counter->file == SOCKSTAT ? line : line + 1;
+                    counter->column = counter->file == SOCKSTAT ? column + 1 : column;
+                    return;
+                }
+            }
+            if (counter->file != SOCKSTAT)
+            {
+                // the names of a section are only on its first line
+                return;
+            }
+        }
+
+        start = strchr(start, '\n');
+        if (start != NULL)
+        {
+            start++;
+        }
+    }
+}
+
+static int byPosition(const void *first, const void *second)
+{
+    const struct netCounter *a = &counters[*(const int *)first];
+    const struct netCounter *b = &counters[*(const int *)second];
+    if (a->file != b->file)
+    {
+        return a->file - b->file;
+    }
+    if (a->line != b->line)
+    {
+        return a->line - b->line;
+    }
+    return a->column - b->column;
+}
+
+static void resolveCounters()
+{
+    // This function looks up the line and column of every counter in the files this kernel has, reading each file once
+
+    for (int file = 0; file < NET_FILE_COUNT; file++)
+    {
+        const char *text = procFileRead(&files[file]);
+        for (int i = 0; i < COUNTER_COUNT; i++)
+        {
+            if ((int)counters[i].file != file)
+            {
+                continue;
+            }
+            counters[i].line = -1;
+            if (text != NULL)
+            {
+                locate(&counters[i], text);
+            }
+        }
+    }
+
+    for (int i = 0; i < COUNTER_COUNT; i++)
+    {
+        order[i] = i;
+    }
+    qsort(order, COUNTER_COUNT, sizeof(int), byPosition);
+    resolved = true;
+}
+
+static bool readCounters()
+{
+    // This function reads every file once and takes each counter from its line and column, walking the text front to back. It
+    // returns false if a line no longer starts with the section it had (the layout changed), so the counters are looked up again.
+
+    const char *text = NULL;
+    const char *position = NULL;
+    int file = -1, line = 0, column = 0;
+
+    for (int k = 0; k < COUNTER_COUNT; k++)
+    {
+        struct netCounter *counter = &counters[order[k]];
+        if (counter->line == -1)
+        {
+            continue;
+        }
+
+        if ((int)counter->file != file)
+        {
+            file = counter->file;
+            text = procFileRead(&files[file]);
+            position = text;
+            line = 0;
+            column = 0;
+        }
+        if (text == NULL)
+        {
+            continue;
+        }
+
+        // move to the line of the counter, then to its column
+        while (line < counter->line && position != NULL)
+        {
+            position = strchr(position, '\n');
+            position = position != NULL ? position + 1 : NULL;
+            line++;
+            column = 0;
+        }
+        if (position == NULL || (column == 0 && !tokenIs(position, counter->section)))
+        {
+            return false;
+        }
+        const char *token = position;
+        while (column < counter->column && *token != '\n' && *token != '\0')
+        {
+            token = nextToken(token);
+            column++;
+        }
+        position = token;
+        counter->value = strtoll(token, NULL, 10);
+    }
+    return true;
+}
+
+static double rate(enum counterId id, double seconds)
+{
+    // the change of a counter per second since the previous sample
+    return (counters[id].value - counters[id].previous) / seconds;
+}
+
+void getTcpHealth(int write_pipe)
+{
+    // This function writes the TCP connections, segments and listen queues with their rates per second since the previous call, and
+    // the sockets in use, in TIME_WAIT and their memory, to the write_pipe. The retransmitted segments are also shown as a share of
+    // the segments sent, and in graphics mode followed by a bar of that share, one # per 0.5 %.
+    // NOTE: A listen overflow is a connection dropped because the accept queue of a listening socket was full (the application does
+    // not accept fast enough); the client retries after a second, which is what shows up as tail latency
+    // Example Output:
+    // getTcpHealth(write_pipe) writes
+    //
+    // connections  established 124  active opens 12.0/s  passive opens 340.5/s  failed 0.0/s  resets 1.0/s
+    // segments     in 12000/s  out 11800/s  retransmitted 14.2/s (0.12 %)  timeouts 0.5/s  bad 0.0/s  resets sent 2.0/s
+    // listen       overflows 0.0/s  drops 0.0/s
+    // sockets      used 412  tcp 130  orphaned 0  time wait 1840  allocated 140  memory 1.2 MB  memory aborts 0.0/s
+
+    long long stage = overheadBegin();
+    if (!resolved)
+    {
+        for (int i = 0; i < NET_FILE_COUNT; i++)
+        {
+            procFileOpen(&files[i], netPaths[i]);
+        }
+        resolveCounters();
+    }
+
+    for (int i = 0; i < COUNTER_COUNT; i++)
+    {
+        counters[i].previous = counters[i].value;
+    }
+    if (!readCounters())
+    {
+        resolveCounters();
+        readCounters();
+    }
+
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    long long time = now.tv_sec * 1000000000LL + now.tv_nsec;
+    double seconds = previousTime > 0 ? (time - previousTime) / 1e9 : 0;
+    previousTime = time;
+    overheadEnd(STAGE_PARSE, stage);
+
+    char buf[COLLECTOR_BUFFER];
+    int offset = 0;
+
+    if (counters[CURR_ESTAB].line == -1 && counters[TCP_INUSE].line == -1)
+    {
+        offset = snprintf(buf, sizeof(buf), "(/proc/net/snmp and /proc/net/sockstat cannot be read)\n");
+        sendMessage(write_pipe, buf, offset);
+        return;
+    }
+
+    stage = overheadBegin();
+    if (seconds > 0)
+    {
+        long long sent = counters[OUT_SEGS].value - counters[OUT_SEGS].previous;
+        float retransmitted = sent > 0 ? (float)(counters[RETRANS_SEGS].value - counters[RETRANS_SEGS].previous) / sent * 100 : 0;
+
+        offset += snprintf(buf + offset, sizeof(buf) - offset, "connections  established %lld  active opens %.1f/s  passive opens %.1f/s  failed %.1f/s  resets %.1f/s\n", counters[CURR_ESTAB].value, rate(ACTIVE_OPENS, seconds), rate(PASSIVE_OPENS, seconds), rate(ATTEMPT_FAILS, seconds), rate(ESTAB_RESETS, seconds));
+        offset += snprintf(buf + offset, sizeof(buf) - offset, "segments     in %.0f/s  out %.0f/s  retransmitted %.1f/s (%.2f %%)  timeouts %.1f/s  bad %.1f/s  resets sent %.1f/s", rate(IN_SEGS, seconds), rate(OUT_SEGS, seconds), rate(RETRANS_SEGS, seconds), retransmitted, rate(TCP_TIMEOUTS, seconds), rate(IN_ERRS, seconds), rate(OUT_RSTS, seconds));
+        if (graphicOutput())
+        {
+            int bars = (int)(retransmitted * 2 + 0.5);
+            offset += snprintf(buf + offset, sizeof(buf) - offset, "  [");
+            for (int bar = 0; bar < 20; bar++)
+            {
+                buf[offset++] = bar < bars ? '#' : '.';
+            }
+            buf[offset++] = ']';
+        }
+        buf[offset++] = '\n';
+        offset += snprintf(buf + offset, sizeof(buf) - offset, "listen       overflows %.1f/s  drops %.1f/s\n", rate(LISTEN_OVERFLOWS, seconds), rate(LISTEN_DROPS, seconds));
+    }
+    else
+    {
+        offset += snprintf(buf + offset, sizeof(buf) - offset, "connections  established %lld  (measuring)\n", counters[CURR_ESTAB].value);
+    }
+
+    // sockstat counts the memory in pages
+    double memory = counters[TCP_MEMORY].value * (double)sysconf(_SC_PAGESIZE) / 1048576;
+    offset += snprintf(buf + offset, sizeof(buf) - offset, "sockets      used %lld  tcp %lld  orphaned %lld  time wait %lld  allocated %lld  memory %.1f MB", counters[SOCKETS_USED].value, counters[TCP_INUSE].value, counters[TCP_ORPHAN].value, counters[TCP_TIME_WAIT].value, counters[TCP_ALLOC].value, memory);
+    if (seconds > 0)
+    {
+        offset += snprintf(buf + offset, sizeof(buf) - offset, "  memory aborts %.1f/s", rate(ABORT_ON_MEMORY, seconds));
+    }
+    buf[offset++] = '\n';
+    overheadEnd(STAGE_FORMAT, stage);
+
+    stage = overheadBegin();
+    sendMessage(write_pipe, buf, offset);
+    overheadEnd(STAGE_WRITE, stage);
+}
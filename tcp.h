@@ -0,0 +1,11 @@
+// Author: Kristi Dodaj
+// tcp.h: Responsible for defining the collector of the TCP and socket counters (see tcp.c)
+
+#ifndef TCP
+#define TCP
+
+// define the function signatures
+
+void getTcpHealth(int write_pipe);
+
+#endif /* TCP */
@@ -0,0 +1,92 @@
+// Author: Kristi Dodaj
+// procfile_test.c: Responsible for checking that procFileRead() returns the whole of files larger than one page, both a regular
+// file and the seq_files of /proc that only return about a page per read (run with make test)
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include "../procfile.h"
+
+static int failures = 0;
+
+static char *readAll(const char *path, int *length)
+{
+    // This function reads the file at path with read() until the end, the reference procFileRead() is compared with
+
+    int fd = open(path, O_RDONLY);
+    if (fd == -1)
+    {
+        return NULL;
+    }
+
+    int size = 4096;
+    char *text = malloc(size);
+    *length = 0;
+    ssize_t got;
+    while (text && (got = read(fd, text + *length, size - *length)) > 0)
+    {
+        *length += got;
+        if (*length == size)
+        {
+            size *= 2;
+            text = realloc(text, size);
+        }
+    }
+    close(fd);
+    return text;
+}
+
+static void checkFile(const char *path)
+{
+    // This function reads path with procFileRead() twice (the second read reuses the grown buffer) and compares it with readAll()
+
+    int expectedLength;
+    char *expected = readAll(path, &expectedLength);
+    if (expected == NULL || expectedLength <= 4096)
+    {
+        printf("SKIP %s (cannot be read or not larger than one page)\n", path);
+        free(expected);
+        return;
+    }
+
+    struct procFile file;
+    procFileOpen(&file, path);
+    for (int i = 0; i < 2; i++)
+    {
+        const char *text = procFileRead(&file);
+        if (text == NULL || file.length != expectedLength || memcmp(text, expected, expectedLength) != 0)
+        {
+            printf("FAIL %s (read %d of %d bytes)\n", path, text != NULL ? file.length : -1, expectedLength);
+            failures++;
+            break;
+        }
+        if (i == 1)
+        {
+            printf("PASS %s (%d bytes)\n", path, file.length);
+        }
+    }
+    procFileClose(&file);
+    free(expected);
+}
+
+int main()
+{
+    // a regular file of 5 pages
+    char path[] = "/tmp/procfile_testXXXXXX";
+    int fd = mkstemp(path);
+    for (int i = 0; fd != -1 && i < 5 * 4096 / 16; i++)
+    {
+        dprintf(fd, "line %10d\n", i);
+    }
+    close(fd);
+    checkFile(path);
+    unlink(path);
+
+    // seq_files, which return one page per read
+    checkFile("/proc/kallsyms");
+    checkFile("/proc/self/mountinfo");
+
+    return failures > 0 ? EXIT_FAILURE : EXIT_SUCCESS;
+}
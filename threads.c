@@ -0,0 +1,419 @@
+// Author: Kristi Dodaj
+// threads.c: Responsible for the optional collector of the threads of one process (--pid=N). Every sample reads /proc/N/task/[tid]/stat
+// and schedstat of each thread, works out its cpu usage and run queue wait since the previous sample and shows the hottest ones.
+// The threads are followed in two fixed tables (the previous sample and the current one) that are swapped every sample, so a
+// process that starts and ends thousands of short lived threads never makes the collector grow.
+
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <time.h>
+#include "threads.h"
+#include "event_loop.h"
+#include "overhead.h"
+#include "stats_functions.h"
+
+// one thread of the target process
+struct thread
+{
+    int tid;                  // 0 for a free slot
+    char name[16];            // from the stat line (the comm of the thread)
+    unsigned long long ticks; // utime + stime in clock ticks
+    unsigned long long startTime; // clock ticks after boot the thread started, so a tid that was reused is told apart
+    long long runNs;          // time on a cpu, from schedstat (-1 without CONFIG_SCHED_INFO)
+    long long waitNs;         // time waiting on a run queue
+    long long slices;         // timeslices run
+    float usage;              // cpu usage since the previous sample in % of one cpu (-1 when there is nothing to compare with)
+    float waitRate;           // run queue wait since the previous sample in ms per second
+    float waitPerSlice;       // average run queue wait per timeslice in us
+    float drawnUsage;         // the usage and bars of the graphic the last time the thread was shown (see getCpuUsageGraphic())
+    int bars;
+};
+
+static int targetPid = 0;
+static DIR *task = NULL;
+
+// the previous sample is tables[current], the one being read goes to the other table
+static struct thread *tables[2];
+static int *used[2]; // the slots taken in each table, so clearing one does not touch all of it
+static int usedCount[2];
+static int current = 0;
+static long sample = 0;
+static bool previousTruncated = false; // the previous sample hit THREADS_TRACKED, so a thread missing from it may not be new
+static struct timespec lastTime;
+
+bool setThreadTarget(const char *pid)
+{
+    // This function sets the process whose threads --pid shows and returns false if pid is not a number or there is no such process
+    // Example Output:
+    // setThreadTarget("4242") returns true when /proc/4242/task exists
+
+    char *end;
+    long value = strtol(pid, &end, 10);
+    if (*pid == '\0' || *end != '\0' || value <= 0 || value > 0x3fffffff)
+    {
+        return false;
+    }
+
+    char path[64];
+    snprintf(path, sizeof(path), "/proc/%ld/task", value);
+    if (access(path, R_OK) != 0)
+    {
+        return false;
+    }
+
+    targetPid = value;
+    return true;
+}
+
+static struct thread *findThread(struct thread *table, int tid, bool insert, int *list, int *count)
+{
+    // This function returns the slot of tid in table (open addressing with linear probing), a free slot for it when insert is true
+    // (recorded in list), or NULL if it is not there
+
+    unsigned int slot = ((unsigned int)tid * 2654435761u) & (THREADS_TABLE - 1);
+    while (table[slot].tid != 0)
+    {
+        if (table[slot].tid == tid)
+        {
+            return &table[slot];
+        }
+        slot = (slot + 1) & (THREADS_TABLE - 1);
+    }
+
+    if (!insert)
+    {
+        return NULL;
+    }
+    list[(*count)++] = slot;
+    table[slot].tid = tid;
+    return &table[slot];
+}
+
+static int readAt(int directory, const char *path, char *buf, int size)
+{
+    // This function reads a small file under directory whole into buf (null terminated) and returns its length, or -1 if it cannot
+    // be read (ex. the thread ended in between)
+
+    int fd = openat(directory, path, O_RDONLY | O_CLOEXEC);
+    if (fd == -1)
+    {
+        return -1;
+    }
+    ssize_t length = read(fd, buf, size - 1);
+    close(fd);
+    if (length < 0)
+    {
+        return -1;
+    }
+    buf[length] = '\0';
+    return length;
+}
+
+static bool readThread(int directory, struct thread *thread)
+{
+    // This function fills in the name, cpu time and scheduler times of a thread and returns false if it ended before its stat
+    // could be read
+
+    char path[32], text[1024];
+    snprintf(path, sizeof(path), "%d/stat", thread->tid);
+    if (readAt(directory, path, text, sizeof(text)) <= 0)
+    {
+        return false;
+    }
+
+    // stat: tid (comm) state ppid ... utime stime ... starttime (the 14th, 15th and 22nd fields), comm may contain spaces and
+    // parentheses
+    char *open = strchr(text, '(');
+    char *close = strrchr(text, ')');
+    if (open == NULL || close == NULL || close < open)
+    {
+        return false;
+    }
+    int length = close - open - 1 < (int)sizeof(thread->name) - 1 ? close - open - 1 : (int)sizeof(thread->name) - 1;
+    memcpy(thread->name, open + 1, length);
+    thread->name[length] = '\0';
+
+    unsigned long long utime, stime;
+    if (sscanf(close + 2, "%*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %llu %llu %*d %*d %*d %*d %*d %*d %llu", &utime, &stime, &thread->startTime) != 3)
+    {
+        return false;
+    }
+    thread->ticks = utime + stime;
+
+    // schedstat: time on cpu (ns), time waiting on a run queue (ns), timeslices
+    snprintf(path, sizeof(path), "%d/schedstat", thread->tid);
+    if (readAt(directory, path, text, sizeof(text)) <= 0 || sscanf(text, "%lld %lld %lld", &thread->runNs, &thread->waitNs, &thread->slices) != 3)
+    {
+        thread->runNs = -1;
+    }
+    return true;
+}
+
+static void heapInsert(struct thread **heap, int *size, struct thread *entry)
+{
+    // This function keeps the THREADS_SHOWN threads with the highest usage in a min-heap (lowest usage at heap[0])
+
+    int i;
+    if (*size < THREADS_SHOWN)
+    {
+        i = (*size)++;
+        while (i > 0 && heap[(i - 1) / 2]->usage > entry->usage)
+        {
+            heap[i] = heap[(i - 1) / 2];
+            i = (i - 1) / 2;
+        }
+        heap[i] = entry;
+        return;
+    }
+
+    if (entry->usage <= heap[0]->usage)
+    {
+        return;
+    }
+
+    // replace the lowest and sift it down
+    i = 0;
+    while (2 * i + 1 < *size)
+    {
+        int child = 2 * i + 1;
+        if (child + 1 < *size && heap[child + 1]->usage < heap[child]->usage)
+        {
+            child++;
+        }
+        if (heap[child]->usage >= entry->usage)
+        {
+            break;
+        }
+        heap[i] = heap[child];
+        i = child;
+    }
+    heap[i] = entry;
+}
+
+static int byHighestUsage(const void *first, const void *second)
+{
+    float a = (*(struct thread *const *)first)->usage;
+    float b = (*(struct thread *const *)second)->usage;
+    return (a < b) - (a > b);
+}
+
+void getThreadUsage(int write_pipe)
+{
+    // This function writes the THREADS_SHOWN threads of the --pid process that used the most cpu since the previous sample to the
+    // write_pipe, with the time they spent waiting on a run queue for a cpu (from schedstat) as ms per second and per timeslice. A
+    // thread that started since the previous sample is measured from its start. In graphics mode each line ends with the same
+    // graphic as the cpu usage (see getCpuUsageGraphic()), compared with the last time that thread was shown.
+    // NOTE: At most THREADS_TRACKED threads are followed, the rest of a larger process is only counted. While a process is over that
+    // limit a thread the previous sample left out is measured from the next sample, and is not counted as started.
+    // Example Output:
+    // getThreadUsage(write_pipe) writes
+    //
+    // pid 4242 (java) -- 212 threads, 5 started and 3 ended since the last sample
+    //     TID  THREAD             CPU %   RUNQ WAIT   WAIT/SLICE
+    //    4250  C2 CompilerThre    87.20   12.4 ms/s      35.2 us
+    //    4301  GC Thread#0        41.05    0.8 ms/s       4.1 us
+
+    char buf[COLLECTOR_BUFFER];
+    int offset = 0;
+
+    sample++;
+    if (tables[0] == NULL)
+    {
+        for (int i = 0; i < 2; i++)
+        {
+            tables[i] = calloc(THREADS_TABLE, sizeof(struct thread));
+            used[i] = malloc(THREADS_TRACKED * sizeof(int));
+            if (tables[i] == NULL || used[i] == NULL)
+            {
+                perror("Error allocating memory");
+                exit(EXIT_FAILURE);
+            }
+        }
+    }
+
+    if (task == NULL)
+    {
+        char path[64];
+        snprintf(path, sizeof(path), "/proc/%d/task", targetPid);
+        task = opendir(path);
+    }
+
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    double elapsed = (now.tv_sec - lastTime.tv_sec) + (now.tv_nsec - lastTime.tv_nsec) / 1e9;
+    lastTime = now;
+    long ticksPerSecond = sysconf(_SC_CLK_TCK);
+
+    // the table of two samples ago becomes the one this sample is read into
+    struct thread *previous = tables[current];
+    struct thread *next = tables[!current];
+    for (int i = 0; i < usedCount[!current]; i++)
+    {
+        next[used[!current][i]].tid = 0;
+    }
+    usedCount[!current] = 0;
+
+    long long stage = overheadBegin();
+    int threads = 0, untracked = 0, started = 0, kept = 0;
+    struct thread *hottest[THREADS_SHOWN];
+    int hottestCount = 0;
+
+    if (task != NULL)
+    {
+        rewinddir(task);
+        struct dirent *entry;
+        while ((entry = readdir(task)) != NULL)
+        {
+            int tid = atoi(entry->d_name);
+            if (tid <= 0)
+            {
+                continue;
+            }
+            threads++;
+
+            if (usedCount[!current] == THREADS_TRACKED)
+            {
+                untracked++;
+                continue;
+            }
+
+            struct thread *thread = findThread(next, tid, true, used[!current], &usedCount[!current]);
+            if (!readThread(dirfd(task), thread))
+            {
+                // the thread ended since the directory was read, give its slot back
+                thread->tid = 0;
+                usedCount[!current]--;
+                threads--;
+                continue;
+            }
+
+            // a thread that started since the previous sample is measured from zero, so all of its time falls in this interval. When
+            // the previous sample was over THREADS_TRACKED, a thread missing from it may only have been left out, and measuring it from
+            // zero would put its whole lifetime in this interval, so it waits for the next sample. A tid with another start time
+            // than in the previous sample was reused by a new thread, which is counted as started (and the old one as ended).
+            struct thread *before = findThread(previous, tid, false, NULL, NULL);
+            bool reused = before != NULL && before->startTime != thread->startTime;
+            struct thread none = {0};
+            bool unknown = false;
+            if (before != NULL && !reused)
+            {
+                kept++;
+            }
+            else if (previousTruncated && !reused)
+            {
+                unknown = true;
+                before = &none;
+            }
+            else
+            {
+                started++;
+                before = &none;
+            }
+
+            thread->drawnUsage = before->drawnUsage;
+            thread->bars = before->bars;
+            thread->usage = -1;
+            thread->waitRate = -1;
+            thread->waitPerSlice = -1;
+            if (sample == 1 || elapsed <= 0 || unknown)
+            {
+                // nothing to compare with yet
+                continue;
+            }
+            thread->usage = (thread->ticks - before->ticks) / (float)ticksPerSecond / elapsed * 100;
+            if (before->runNs >= 0 && thread->runNs >= 0)
+            {
+                thread->waitRate = (thread->waitNs - before->waitNs) / 1e6 / elapsed;
+                long long slices = thread->slices - before->slices;
+                thread->waitPerSlice = slices > 0 ? (thread->waitNs - before->waitNs) / 1e3 / slices : 0;
+            }
+            heapInsert(hottest, &hottestCount, thread);
+        }
+    }
+    int ended = usedCount[current] - kept;
+    current = !current;
+    previousTruncated = untracked > 0;
+    overheadEnd(STAGE_READ, stage);
+
+    if (threads == 0)
+    {
+        offset = snprintf(buf, sizeof(buf), "(process %d ended)\n", targetPid);
+        sendMessage(write_pipe, buf, offset);
+        return;
+    }
+
+    stage = overheadBegin();
+    qsort(hottest, hottestCount, sizeof(struct thread *), byHighestUsage);
+    overheadEnd(STAGE_COMPUTE, stage);
+
+    stage = overheadBegin();
+    char name[16] = "?";
+    char path[32];
+    snprintf(path, sizeof(path), "/proc/%d/comm", targetPid);
+    FILE *comm = fopen(path, "r");
+    if (comm != NULL)
+    {
+        if (fgets(name, sizeof(name), comm) != NULL)
+        {
+            name[strcspn(name, "\n")] = '\0';
+        }
+        fclose(comm);
+    }
+
+    offset += snprintf(buf + offset, sizeof(buf) - offset, "pid %d (%s) -- %d threads", targetPid, name, threads);
+    if (sample > 1)
+    {
+        offset += snprintf(buf + offset, sizeof(buf) - offset, ", %d started and %d ended since the last sample", started, ended);
+    }
+    if (untracked > 0)
+    {
+        offset += snprintf(buf + offset, sizeof(buf) - offset, " (%d not followed)", untracked);
+    }
+    buf[offset++] = '\n';
+
+    if (hottestCount == 0)
+    {
+        offset += snprintf(buf + offset, sizeof(buf) - offset, "(the cpu usage of the threads is shown from the next sample)\n");
+    }
+    else
+    {
+        offset += snprintf(buf + offset, sizeof(buf) - offset, "    TID  THREAD             CPU %%   RUNQ WAIT   WAIT/SLICE\n");
+    }
+
+    for (int i = 0; i < hottestCount; i++)
+    {
+        struct thread *thread = hottest[i];
+
+        offset += snprintf(buf + offset, sizeof(buf) - offset, "%7d  %-15s %8.2f", thread->tid, thread->name, thread->usage);
+        if (thread->waitRate >= 0)
+        {
+            offset += snprintf(buf + offset, sizeof(buf) - offset, "  %6.1f ms/s  %8.1f us", thread->waitRate, thread->waitPerSlice);
+        }
+        else
+        {
+            offset += snprintf(buf + offset, sizeof(buf) - offset, "       -              -   ");
+        }
+
+        if (graphicOutput())
+        {
+            // the bars are worked out from the last time this thread was shown, like the cpu usage from the previous frame
+            char *graphic = getCpuUsageGraphic(thread->usage, thread->drawnUsage, thread->bars);
+            int chars_read;
+            sscanf(graphic, "%d%n", &thread->bars, &chars_read);
+            offset += snprintf(buf + offset, sizeof(buf) - offset, " %s", graphic + chars_read);
+            free(graphic);
+            thread->drawnUsage = thread->usage;
+        }
+        buf[offset++] = '\n';
+    }
+    overheadEnd(STAGE_FORMAT, stage);
+
+    stage = overheadBegin();
+    sendMessage(write_pipe, buf, offset);
+    overheadEnd(STAGE_WRITE, stage);
+}
@@ -0,0 +1,22 @@
+// Author: Kristi Dodaj
+// threads.h: Responsible for defining the collector of the threads of one process (see threads.c)
+#include <stdbool.h>
+
+#ifndef THREADS
+#define THREADS
+
+// the threads shown by the panel
+#define THREADS_SHOWN 10
+
+// the most threads followed between samples, the others of a larger process are counted but not measured
+#define THREADS_TRACKED 4096
+
+// the slots of the table of followed threads (a power of two, twice THREADS_TRACKED so the probes stay short)
+#define THREADS_TABLE 8192
+
+// define the function signatures
+
+bool setThreadTarget(const char *pid);
+void getThreadUsage(int write_pipe);
+
+#endif /* THREADS */
@@ -0,0 +1,305 @@
+// Author: Kristi Dodaj
+// topology.c: Responsible for discovering the cpu topology (sockets, cores, SMT siblings, NUMA nodes, online/offline cpus) once
+// from /sys/devices/system/cpu and rebuilding it only when the kernel reports a cpu hotplug event
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/socket.h>
+#include <linux/netlink.h>
+#include "topology.h"
+
+static struct topology machine = {0};
+
+// the kernel uevent socket the hotplug events arrive on (-1 when it could not be opened, then the online mask is compared instead)
+static int hotplugSocket = -1;
+static pid_t hotplugOwner = 0;
+static char onlineList[4096];
+
+static bool readLine(const char *path, char *line, int size)
+{
+    // This function reads the first line of a small sysfs file into line (without the newline) and returns false if it cannot be read
+
+    FILE *file = fopen(path, "r");
+    if (file == NULL)
+    {
+        return false;
+    }
+
+    bool read = fgets(line, size, file) != NULL;
+    fclose(file);
+
+    if (read)
+    {
+        line[strcspn(line, "\n")] = '\0';
+    }
+    return read;
+}
+
+static int readNumber(const char *path, int fallback)
+{
+    // This function returns the number in a sysfs file, or fallback if the file does not exist (ex. no topology directory in some VMs)
+
+    char line[32];
+    return readLine(path, line, sizeof(line)) ? atoi(line) : fallback;
+}
+
+int parseCpuList(const char *list, void (*mark)(int cpu, int value), int value)
+{
+    // This function walks a sysfs cpu list (ex. "0-3,8-11") and calls mark(cpu, value) for every cpu in it. It returns the highest
+    // cpu id found plus one.
+    // Example Output:
+    // parseCpuList("0-2,5", mark, 1) calls mark for cpus 0, 1, 2 and 5 and returns 6
+
+    int highest = 0;
+    const char *position = list;
+
+    while (*position != '\0')
+    {
+        char *end;
+        int first = strtol(position, &end, 10);
+        if (end == position)
+        {
+            break;
+        }
+
+        int last = first;
+        if (*end == '-')
+        {
+            position = end + 1;
+            last = strtol(position, &end, 10);
+        }
+
+        for (int cpu = first; cpu <= last; cpu++)
+        {
+            if (mark != NULL)
+            {
+                mark(cpu, value);
+            }
+        }
+        if (last + 1 > highest)
+        {
+            highest = last + 1;
+        }
+
+        position = *end == ',' ? end + 1 : end;
+    }
+
+    return highest;
+}
+
+static void markOnline(int cpu, int value)
+{
+    if (cpu < machine.possible)
+    {
+        machine.cpus[cpu].online = value;
+    }
+}
+
+static void markNode(int cpu, int value)
+{
+    if (cpu < machine.possible)
+    {
+        machine.cpus[cpu].node = value;
+    }
+}
+
+static void discover()
+{
+    // This function (re)builds the cached topology from sysfs
+
+    char list[4096];
+
+    // every cpu id the kernel could bring online
+    int possible = readLine("/sys/devices/system/cpu/possible", list, sizeof(list)) ? parseCpuList(list, NULL, 0) : 0;
+    if (possible <= 0)
+    {
+        possible = sysconf(_SC_NPROCESSORS_CONF);
+    }
+
+    if (possible != machine.possible)
+    {
+        free(machine.cpus);
+        machine.cpus = calloc(possible, sizeof(struct cpuTopology));
+        if (!machine.cpus)
+        {
+            perror("Error allocating memory");
+            exit(EXIT_FAILURE);
+        }
+        machine.possible = possible;
+    }
+    memset(machine.cpus, 0, possible * sizeof(struct cpuTopology));
+
+    // which of them are online
+    if (readLine("/sys/devices/system/cpu/online", list, sizeof(list)))
+    {
+        snprintf(onlineList, sizeof(onlineList), "%s", list);
+        parseCpuList(list, markOnline, true);
+    }
+    else
+    {
+        // error checking for system resources
+        perror("fopen: Failed to open /sys/devices/system/cpu/online, assuming every cpu is online");
+        for (int cpu = 0; cpu < possible; cpu++)
+        {
+            machine.cpus[cpu].online = true;
+        }
+    }
+
+    // the NUMA node of each cpu from the cpulist of every node (no node directory means a single node)
+    DIR *nodes = opendir("/sys/devices/system/node");
+    if (nodes != NULL)
+    {
+        struct dirent *entry;
+        while ((entry = readdir(nodes)) != NULL)
+        {
+            int node;
+            char path[300];
+            if (sscanf(entry->d_name, "node%d", &node) == 1)
+            {
+                snprintf(path, sizeof(path), "/sys/devices/system/node/%s/cpulist", entry->d_name);
+                if (readLine(path, list, sizeof(list)))
+                {
+                    parseCpuList(list, markNode, node);
+                }
+            }
+        }
+        closedir(nodes);
+    }
+
+    // socket and core of every online cpu, counting the distinct ones
+    machine.online = machine.sockets = machine.cores = machine.nodes = 0;
+    for (int cpu = 0; cpu < possible; cpu++)
+    {
+        struct cpuTopology *current = &machine.cpus[cpu];
+        if (!current->online)
+        {
+            continue;
+        }
+
+        char path[128];
+        snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/topology/physical_package_id", cpu);
+        current->socket = readNumber(path, 0);
+        snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/topology/core_id", cpu);
+        current->core = readNumber(path, cpu);
+
+        bool newSocket = true, newCore = true, newNode = true;
+        for (int other = 0; other < cpu; other++)
+        {
+            if (!machine.cpus[other].online)
+            {
+                continue;
+            }
+            if (machine.cpus[other].socket == current->socket)
+            {
+                newSocket = false;
+                if (machine.cpus[other].core == current->core)
+                {
+                    newCore = false; // an SMT sibling of a cpu already counted
+                }
+            }
+            if (machine.cpus[other].node == current->node)
+            {
+                newNode = false;
+            }
+        }
+
+        machine.online++;
+        machine.sockets += newSocket;
+        machine.cores += newCore;
+        machine.nodes += newNode;
+    }
+}
+
+static void openHotplugSocket()
+{
+    // This function subscribes to the kernel uevents, which include "online@/devices/system/cpu/cpuN" when a cpu is hotplugged
+
+    hotplugOwner = getpid();
+    hotplugSocket = socket(AF_NETLINK, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, NETLINK_KOBJECT_UEVENT);
+    if (hotplugSocket == -1)
+    {
+        return;
+    }
+
+    struct sockaddr_nl address = {.nl_family = AF_NETLINK, .nl_groups = 1};
+    if (bind(hotplugSocket, (struct sockaddr *)&address, sizeof(address)) == -1)
+    {
+        // not allowed (ex. in a container), the online mask is compared instead
+        close(hotplugSocket);
+        hotplugSocket = -1;
+    }
+}
+
+void topologyInit()
+{
+    // This function discovers the topology once at startup and starts listening for cpu hotplug events
+    // Example Output:
+    // topologyInit() reads /sys/devices/system/cpu, after which topologyGet() returns the machine below without reading anything
+    //
+    // possible = 1, online = 1, sockets = 1, cores = 1, nodes = 1
+
+    discover();
+    openHotplugSocket();
+}
+
+bool topologyRefresh()
+{
+    // This function rebuilds the topology if a cpu went online or offline since the previous call and returns true if it did.
+    // Without hotplug events pending this costs a single non-blocking recv() (or one small read of the online mask when the
+    // uevent socket is not available).
+    // NOTE: A forked process opens its own socket so it does not take the events meant for its parent
+    // Example Output:
+    // topologyRefresh() returns false
+
+    if (hotplugOwner != getpid())
+    {
+        if (hotplugSocket != -1)
+        {
+            close(hotplugSocket);
+        }
+        openHotplugSocket();
+    }
+
+    bool changed = false;
+
+    if (hotplugSocket != -1)
+    {
+        char event[4096];
+        ssize_t length;
+        while ((length = recv(hotplugSocket, event, sizeof(event) - 1, 0)) > 0)
+        {
+            event[length] = '\0';
+            if (strstr(event, "@/devices/system/cpu/cpu") != NULL)
+            {
+                changed = true;
+            }
+        }
+    }
+    else
+    {
+        char list[4096];
+        changed = readLine("/sys/devices/system/cpu/online", list, sizeof(list)) && strcmp(list, onlineList) != 0;
+    }
+
+    if (changed)
+    {
+        discover();
+    }
+    return changed;
+}
+
+const struct topology *topologyGet()
+{
+    // This function returns the cached topology, discovering it first if topologyInit() was not called
+    // Example Output:
+    // topologyGet()->cores returns 1
+
+    if (machine.cpus == NULL)
+    {
+        topologyInit();
+    }
+    return &machine;
+}
@@ -0,0 +1,36 @@
+// Author: Kristi Dodaj
+// topology.h: Responsible for defining the cached cpu topology read from sysfs (see topology.c)
+
+#include <stdbool.h>
+
+#ifndef TOPOLOGY
+#define TOPOLOGY
+
+// where one logical cpu sits in the machine
+struct cpuTopology
+{
+    bool online;
+    int socket; // physical_package_id
+    int core;   // core_id (only unique within its socket)
+    int node;   // NUMA node (0 on machines without NUMA)
+};
+
+// the whole machine, rebuilt only when a cpu is hotplugged
+struct topology
+{
+    int possible;            // number of cpu ids the kernel can use (size of cpus)
+    int online;              // logical cpus currently online
+    int sockets;             // distinct sockets with an online cpu
+    int cores;               // distinct physical cores with an online cpu
+    int nodes;               // NUMA nodes with an online cpu
+    struct cpuTopology *cpus;
+};
+
+// define the function signatures
+
+void topologyInit();
+bool topologyRefresh();
+const struct topology *topologyGet();
+int parseCpuList(const char *list, void (*mark)(int cpu, int value), int value);
+
+#endif /* TOPOLOGY */
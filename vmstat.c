@@ -0,0 +1,244 @@
+// Author: Kristi Dodaj
+// vmstat.c: Responsible for reading /proc/vmstat counters by slot and for the optional collector of the virtual memory activity:
+// page faults, swap in and out, page reclaim by kswapd and by the allocating processes themselves (direct reclaim) and compaction
+// stalls, per second. /proc/vmstat has one counter per line and the same lines for the whole uptime, so the slot of every line is
+// looked up once and a sample is one pass over the file that parses only the lines a slot wants, without comparing any names.
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <time.h>
+#include "vmstat.h"
+#include "event_loop.h"
+#include "overhead.h"
+#include "stats_functions.h"
+
+static int countLines(const char *text)
+{
+    int lines = 0;
+    for (const char *line = text; line != NULL && *line != '\0'; lines++)
+    {
+        line = strchr(line, '\n');
+        if (line != NULL)
+        {
+            line++;
+        }
+    }
+    return lines;
+}
+
+static void mapLines(struct vmstatMap *map, const char *text)
+{
+    // This function finds the slot of every line of text: the slot whose name is the counter of the line, or whose name ending
+    // with '_' starts it (ex. "allocstall_" takes allocstall_dma, allocstall_normal, ...)
+
+    map->lines = countLines(text);
+    free(map->slots);
+    map->slots = malloc((map->lines > 0 ? map->lines : 1) * sizeof(int));
+    if (!map->slots)
+    {
+        perror("Error allocating memory");
+        exit(EXIT_FAILURE);
+    }
+
+    const char *line = text;
+    for (int i = 0; i < map->lines; i++)
+    {
+        size_t length = strcspn(line, " \n");
+        map->slots[i] = -1;
+        for (int slot = 0; slot < map->slotCount && map->slots[i] == -1; slot++)
+        {
+            size_t nameLength = strlen(map->names[slot]);
+            bool prefix = nameLength > 0 && map->names[slot][nameLength - 1] == '_';
+            if ((prefix ? length > nameLength : length == nameLength) && strncmp(line, map->names[slot], nameLength) == 0)
+            {
+                map->slots[i] = slot;
+            }
+        }
+
+        line = strchr(line, '\n');
+        if (line != NULL)
+        {
+            line++;
+        }
+    }
+}
+
+bool vmstatMapOpen(struct vmstatMap *map, const char **names, int slotCount)
+{
+    // This function opens /proc/vmstat and maps its lines to the slots of names, and returns false if it cannot be read. A counter
+    // this kernel does not have keeps its slot at 0.
+    // Example Output:
+    // vmstatMapOpen(&map, (const char *[]){"pgfault", "pgmajfault"}, 2) returns true
+
+    map->names = names;
+    map->slotCount = slotCount;
+    map->slots = NULL;
+    map->lines = 0;
+
+    procFileOpen(&map->file, "/proc/vmstat");
+    const char *text = procFileRead(&map->file);
+    if (text == NULL)
+    {
+        return false;
+    }
+    mapLines(map, text);
+    return true;
+}
+
+bool vmstatMapRead(struct vmstatMap *map, long long *values)
+{
+    // This function reads /proc/vmstat once and sets values[slot] of every slot to its counter (the sum of them for a prefix), and
+    // returns false if the file cannot be read. The lines are only mapped again if their number changed.
+    // NOTE: values needs slotCount entries
+    // Example Output:
+    // vmstatMapRead(&map, values) returns true, with values = {4171014, 337}
+
+    const char *text = procFileRead(&map->file);
+    if (text == NULL)
+    {
+        return false;
+    }
+    if (countLines(text) != map->lines)
+    {
+        mapLines(map, text);
+    }
+
+    memset(values, 0, map->slotCount * sizeof(long long));
+    const char *line = text;
+    for (int i = 0; i < map->lines && line != NULL; i++)
+    {
+        if (map->slots[i] != -1)
+        {
+            const char *value = strchr(line, ' ');
+            if (value != NULL)
+            {
+                values[map->slots[i]] += strtoll(value, NULL, 10);
+            }
+        }
+
+        line = strchr(line, '\n');
+        if (line != NULL)
+        {
+            line++;
+        }
+    }
+    return true;
+}
+
+enum vmCounter
+{
+    PGFAULT,
+    PGMAJFAULT,
+    PSWPIN,
+    PSWPOUT,
+    PGSCAN_KSWAPD,
+    PGSTEAL_KSWAPD,
+    PGSCAN_DIRECT,
+    PGSTEAL_DIRECT,
+    ALLOCSTALL,
+    COMPACT_STALL,
+    COMPACT_FAIL,
+    COMPACT_SUCCESS,
+    VM_COUNTER_COUNT
+};
+
+static const char *vmNames[VM_COUNTER_COUNT] = {
+    [PGFAULT] = "pgfault",
+    [PGMAJFAULT] = "pgmajfault",
+    [PSWPIN] = "pswpin",
+    [PSWPOUT] = "pswpout",
+    [PGSCAN_KSWAPD] = "pgscan_kswapd",
+    [PGSTEAL_KSWAPD] = "pgsteal_kswapd",
+    [PGSCAN_DIRECT] = "pgscan_direct",
+    [PGSTEAL_DIRECT] = "pgsteal_direct",
+    [ALLOCSTALL] = "allocstall_",
+    [COMPACT_STALL] = "compact_stall",
+    [COMPACT_FAIL] = "compact_fail",
+    [COMPACT_SUCCESS] = "compact_success",
+};
+
+void getVirtualMemoryActivity(int write_pipe)
+{
+    // This function writes the page faults, the pages swapped in and out, the pages scanned and reclaimed by kswapd and by direct
+    // reclaim and the compaction stalls per second to the write_pipe. The first call shows the averages since boot. Direct reclaim
+    // and compaction stalls are time a process spent freeing memory itself before its allocation could go on, so they are latency
+    // the process paid; kswapd reclaims in the background. In graphics mode the reclaim line ends with a bar of the share of the
+    // pages reclaimed directly, one # per 5 %.
+    // NOTE: A box that thrashes shows major faults and swap in together with direct reclaim, while the used memory alone can look fine
+    // Example Output:
+    // getVirtualMemoryActivity(write_pipe) writes
+    //
+    // faults      minor 12040.5/s  major 0.5/s
+    // swap        in 0.0/s  out 0.0/s (pages)
+    // reclaim     kswapd 0.0/s of 0.0/s scanned  direct 0.0/s of 0.0/s scanned  direct stalls 0.0/s
+    // compaction  stalls 0.0/s  failed 0.0/s  succeeded 0.0/s
+
+    static struct vmstatMap map;
+    static bool opened = false;
+    static bool readable = false;
+    static long long values[VM_COUNTER_COUNT];
+    static long long previous[VM_COUNTER_COUNT];
+    static long long previousTime = 0;
+
+    long long stage = overheadBegin();
+    if (!opened)
+    {
+        readable = vmstatMapOpen(&map, vmNames, VM_COUNTER_COUNT);
+        opened = true;
+    }
+    memcpy(previous, values, sizeof(values));
+    readable = readable && vmstatMapRead(&map, values);
+
+    // the counters start at boot, so the first sample is the average since boot
+    struct timespec now;
+    clock_gettime(CLOCK_BOOTTIME, &now);
+    long long time = now.tv_sec * 1000000000LL + now.tv_nsec;
+    double seconds = (time - previousTime) / 1e9;
+    bool sinceBoot = previousTime == 0;
+    previousTime = time;
+    overheadEnd(STAGE_PARSE, stage);
+
+    char buf[COLLECTOR_BUFFER];
+    int offset = 0;
+
+    if (!readable)
+    {
+        offset = snprintf(buf, sizeof(buf), "(/proc/vmstat cannot be read)\n");
+        sendMessage(write_pipe, buf, offset);
+        return;
+    }
+
+    stage = overheadBegin();
+    double rates[VM_COUNTER_COUNT];
+    for (int i = 0; i < VM_COUNTER_COUNT; i++)
+    {
+        rates[i] = seconds > 0 ? (values[i] - previous[i]) / seconds : 0;
+    }
+    double stolen = rates[PGSTEAL_KSWAPD] + rates[PGSTEAL_DIRECT];
+    float directShare = stolen > 0 ? rates[PGSTEAL_DIRECT] / stolen * 100 : 0;
+    overheadEnd(STAGE_COMPUTE, stage);
+
+    stage = overheadBegin();
+    offset += snprintf(buf + offset, sizeof(buf) - offset, "faults      minor %.1f/s  major %.1f/s%s\n", rates[PGFAULT] - rates[PGMAJFAULT], rates[PGMAJFAULT], sinceBoot ? "  (since boot)" : "");
+    offset += snprintf(buf + offset, sizeof(buf) - offset, "swap        in %.1f/s  out %.1f/s (pages)\n", rates[PSWPIN], rates[PSWPOUT]);
+    offset += snprintf(buf + offset, sizeof(buf) - offset, "reclaim     kswapd %.1f/s of %.1f/s scanned  direct %.1f/s of %.1f/s scanned  direct stalls %.1f/s", rates[PGSTEAL_KSWAPD], rates[PGSCAN_KSWAPD], rates[PGSTEAL_DIRECT], rates[PGSCAN_DIRECT], rates[ALLOCSTALL]);
+    if (graphicOutput())
+    {
+        int bars = (int)(directShare / 5 + 0.5);
+        offset += snprintf(buf + offset, sizeof(buf) - offset, "  [");
+        for (int bar = 0; bar < 20; bar++)
+        {
+            buf[offset++] = bar < bars ? '#' : '.';
+        }
+        buf[offset++] = ']';
+    }
+    buf[offset++] = '\n';
+    offset += snprintf(buf + offset, sizeof(buf) - offset, "compaction  stalls %.1f/s  failed %.1f/s  succeeded %.1f/s\n", rates[COMPACT_STALL], rates[COMPACT_FAIL], rates[COMPACT_SUCCESS]);
+    overheadEnd(STAGE_FORMAT, stage);
+
+    stage = overheadBegin();
+    sendMessage(write_pipe, buf, offset);
+    overheadEnd(STAGE_WRITE, stage);
+}
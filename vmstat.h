@@ -0,0 +1,26 @@
+// Author: Kristi Dodaj
+// vmstat.h: Responsible for defining the reader of /proc/vmstat counters by slot and the collector of the virtual memory activity (see vmstat.c)
+
+#include <stdbool.h>
+#include "procfile.h"
+
+#ifndef VMSTAT
+#define VMSTAT
+
+// the counters of /proc/vmstat a collector reads, each line of the file mapped to the slot of its counter once
+struct vmstatMap
+{
+    struct procFile file;
+    const char **names; // the counter of every slot, a name ending with '_' adds up every counter that starts with it
+    int slotCount;
+    int *slots;         // the slot of every line of the file, -1 for the lines no slot wants
+    int lines;
+};
+
+// define the function signatures
+
+bool vmstatMapOpen(struct vmstatMap *map, const char **names, int slotCount);
+bool vmstatMapRead(struct vmstatMap *map, long long *values);
+void getVirtualMemoryActivity(int write_pipe);
+
+#endif /* VMSTAT */